@@ -0,0 +1,89 @@
+/***  File Header  ************************************************************/
+/**
+* @file bounded_queue.h
+*
+* Bounded blocking queue to connect the pipeline stages.
+* @author   Shozo Fukuda
+* @date     create Tue Jul 04 10:12:40 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+#ifndef _BOUNDED_QUEUE_H
+#define _BOUNDED_QUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Bounded blocking queue
+* @par DESCRIPTION
+*   multi-producer/multi-consumer FIFO with a fixed capacity.
+*   push() blocks while the queue is full (backpressure), pop() blocks
+*   while it is empty. after close(), push() fails and pop() drains the
+*   remaining items, then fails.
+**/
+/**************************************************************************{{{*/
+template <typename T>
+class BoundedQueue {
+//LIFECYCLE:
+public:
+    explicit BoundedQueue(size_t capacity)
+        : mCapacity(capacity > 0 ? capacity : 1), mClosed(false) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+//ACTION:
+public:
+    bool push(T&& item) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mNotFull.wait(lock, [this]{ return mClosed || mQueue.size() < mCapacity; });
+        if (mClosed) {
+            return false;
+        }
+        mQueue.push_back(std::move(item));
+        mNotEmpty.notify_one();
+        return true;
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mNotEmpty.wait(lock, [this]{ return mClosed || !mQueue.empty(); });
+        if (mQueue.empty()) {
+            return false;
+        }
+        item = std::move(mQueue.front());
+        mQueue.pop_front();
+        mNotFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mClosed = true;
+        mNotFull.notify_all();
+        mNotEmpty.notify_all();
+    }
+
+//INQUIRY:
+public:
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mQueue.size();
+    }
+
+//ATTRIBUTE:
+private:
+    size_t                  mCapacity;
+    bool                    mClosed;
+    std::deque<T>           mQueue;
+    std::mutex              mMutex;
+    std::condition_variable mNotFull;
+    std::condition_variable mNotEmpty;
+};
+
+#endif /* _BOUNDED_QUEUE_H */
+/*** bounded_queue.h ******************************************************}}}*/
@@ -0,0 +1,201 @@
+/***  File Header  ************************************************************/
+/**
+* @file image_conv.cpp
+*
+* Conversion of the generator output tensor to 8bit images.
+* @author   Shozo Fukuda
+* @date     create Mon Jul 10 09:41:17 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+* The planar float image [C,H,W] is scaled, offset, clamped, truncated and
+* interleaved to [H,W,C] uint8 in one pass. x86 uses AVX2 or SSE2 for the
+* conversion and SSSE3 (pshufb) for the RGB interleave if they are enabled
+* at compile time (/arch:AVX2, -mavx2, -mssse3); the others fall back to
+* the scalar loop, which gives the same results.
+**/
+/**************************************************************************{{{*/
+
+#include <algorithm>
+#include "image_conv.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define IMAGE_CONV_AVX2
+#define IMAGE_CONV_SSSE3
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMAGE_CONV_SSE2
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define IMAGE_CONV_SSSE3
+#endif
+#endif
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* convert one element
+* @par DESCRIPTION
+*   scalar version of the conversion.
+**/
+/**************************************************************************{{{*/
+static inline uint8_t
+conv_u8(float x, float scale, float offset)
+{
+    float y = x*scale + offset;
+    y = std::min(std::max(y, 0.0f), 255.0f);
+    return static_cast<uint8_t>(y);
+}
+
+#if defined(IMAGE_CONV_AVX2) || defined(IMAGE_CONV_SSE2)
+/***  Module Header  ******************************************************}}}*/
+/**
+* convert 16 elements
+* @par DESCRIPTION
+*   SIMD version of conv_u8(): 16 floats -> 16 uint8 in a __m128i.
+**/
+/**************************************************************************{{{*/
+static inline __m128i
+conv16_u8(const float* src, float scale, float offset)
+{
+#if defined(IMAGE_CONV_AVX2)
+    const __m256 vscale  = _mm256_set1_ps(scale);
+    const __m256 voffset = _mm256_set1_ps(offset);
+    const __m256 vmin    = _mm256_setzero_ps();
+    const __m256 vmax    = _mm256_set1_ps(255.0f);
+
+    __m256 a = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(src),     vscale), voffset);
+    __m256 b = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(src + 8), vscale), voffset);
+    __m256i ia = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(a, vmin), vmax));
+    __m256i ib = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(b, vmin), vmax));
+
+    __m128i lo = _mm_packs_epi32(_mm256_castsi256_si128(ia), _mm256_extracti128_si256(ia, 1));
+    __m128i hi = _mm_packs_epi32(_mm256_castsi256_si128(ib), _mm256_extracti128_si256(ib, 1));
+#else
+    const __m128 vscale  = _mm_set1_ps(scale);
+    const __m128 voffset = _mm_set1_ps(offset);
+    const __m128 vmin    = _mm_setzero_ps();
+    const __m128 vmax    = _mm_set1_ps(255.0f);
+
+    __m128i v[4];
+    for (int i = 0; i < 4; i++) {
+        __m128 a = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + 4*i), vscale), voffset);
+        v[i] = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(a, vmin), vmax));
+    }
+    __m128i lo = _mm_packs_epi32(v[0], v[1]);
+    __m128i hi = _mm_packs_epi32(v[2], v[3]);
+#endif
+    return _mm_packus_epi16(lo, hi);
+}
+#endif
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* convert pixels
+* @par DESCRIPTION
+*   'count' pixels from 'src' on the planes 'plane' floats apart to the
+*   interleaved 'dst'.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+static void
+conv_pixels(const float* src, size_t plane, uint8_t* dst, int channels, size_t count, float scale, float offset)
+{
+    size_t i = 0;
+
+#if defined(IMAGE_CONV_AVX2) || defined(IMAGE_CONV_SSE2)
+    if (channels == 3) {
+        const float* src_r = src;
+        const float* src_g = src + plane;
+        const float* src_b = src + 2*plane;
+
+#if defined(IMAGE_CONV_SSSE3)
+        const __m128i mask_r0 = _mm_setr_epi8( 0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1,  5);
+        const __m128i mask_g0 = _mm_setr_epi8(-1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1);
+        const __m128i mask_b0 = _mm_setr_epi8(-1, -1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1);
+        const __m128i mask_r1 = _mm_setr_epi8(-1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10, -1);
+        const __m128i mask_g1 = _mm_setr_epi8( 5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10);
+        const __m128i mask_b1 = _mm_setr_epi8(-1,  5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1);
+        const __m128i mask_r2 = _mm_setr_epi8(-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1);
+        const __m128i mask_g2 = _mm_setr_epi8(-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1);
+        const __m128i mask_b2 = _mm_setr_epi8(10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15);
+#endif
+
+        for (; i + 16 <= count; i += 16) {
+            __m128i r = conv16_u8(src_r + i, scale, offset);
+            __m128i g = conv16_u8(src_g + i, scale, offset);
+            __m128i b = conv16_u8(src_b + i, scale, offset);
+
+            uint8_t* out = dst + 3*i;
+#if defined(IMAGE_CONV_SSSE3)
+            __m128i o0 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, mask_r0), _mm_shuffle_epi8(g, mask_g0)), _mm_shuffle_epi8(b, mask_b0));
+            __m128i o1 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, mask_r1), _mm_shuffle_epi8(g, mask_g1)), _mm_shuffle_epi8(b, mask_b1));
+            __m128i o2 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, mask_r2), _mm_shuffle_epi8(g, mask_g2)), _mm_shuffle_epi8(b, mask_b2));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out),      o0);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), o1);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 32), o2);
+#else
+            alignas(16) uint8_t tmp[3][16];
+            _mm_store_si128(reinterpret_cast<__m128i*>(tmp[0]), r);
+            _mm_store_si128(reinterpret_cast<__m128i*>(tmp[1]), g);
+            _mm_store_si128(reinterpret_cast<__m128i*>(tmp[2]), b);
+            for (int k = 0; k < 16; k++) {
+                *out++ = tmp[0][k];
+                *out++ = tmp[1][k];
+                *out++ = tmp[2][k];
+            }
+#endif
+        }
+    }
+    else if (channels == 1) {
+        for (; i + 16 <= count; i += 16) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), conv16_u8(src + i, scale, offset));
+        }
+    }
+#endif
+
+    // remainder (or everything on the scalar path)
+    for (; i < count; i++) {
+        for (int c = 0; c < channels; c++) {
+            dst[i*channels + c] = conv_u8(src[c*plane + i], scale, offset);
+        }
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* convert planar float image to interleaved uint8 image
+* @par DESCRIPTION
+*   src [channels, height, width] float -> dst [height, width, channels]
+*   uint8, dst = saturate(src*scale + offset).
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+nchw_to_hwc_u8(const float* src, uint8_t* dst, int channels, int height, int width, float scale, float offset)
+{
+    const size_t plane = size_t(height)*width;
+    conv_pixels(src, plane, dst, channels, plane, scale, offset);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* convert planar float image into a larger image
+* @par DESCRIPTION
+*   the same as nchw_to_hwc_u8(), but the rows of dst are 'dst_stride'
+*   bytes apart, so that the image is put in a tile of a canvas.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+nchw_to_hwc_u8_tile(const float* src, uint8_t* dst, size_t dst_stride, int channels, int height, int width, float scale, float offset)
+{
+    const size_t plane = size_t(height)*width;
+    for (int y = 0; y < height; y++) {
+        conv_pixels(src + size_t(y)*width, plane, dst + y*dst_stride, channels, width, scale, offset);
+    }
+}
+
+/*** image_conv.cpp *******************************************************}}}*/
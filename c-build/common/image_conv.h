@@ -0,0 +1,32 @@
+/***  File Header  ************************************************************/
+/**
+* @file image_conv.h
+*
+* Conversion of the generator output tensor to 8bit images.
+* @author   Shozo Fukuda
+* @date     create Mon Jul 10 09:41:17 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+#ifndef _IMAGE_CONV_H
+#define _IMAGE_CONV_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*--- CONSTANT ---*/
+/* [-1.0, 1.0] -> [0, 255], the same as tflib.convert_images_to_uint8:
+*  u8 = saturate(x*127.5 + 127.5 + 0.5), the +0.5 rounds to nearest.
+*/
+#define IMAGE_CONV_SCALE    127.5f
+#define IMAGE_CONV_OFFSET   128.0f
+
+/*--- EXTERNAL MODULE ---*/
+void nchw_to_hwc_u8(const float* src, uint8_t* dst, int channels, int height, int width,
+                    float scale=IMAGE_CONV_SCALE, float offset=IMAGE_CONV_OFFSET);
+void nchw_to_hwc_u8_tile(const float* src, uint8_t* dst, size_t dst_stride, int channels, int height, int width,
+                         float scale=IMAGE_CONV_SCALE, float offset=IMAGE_CONV_OFFSET);
+
+#endif /* _IMAGE_CONV_H */
+/*** image_conv.h *********************************************************}}}*/
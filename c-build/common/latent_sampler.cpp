@@ -0,0 +1,583 @@
+/***  File Header  ************************************************************/
+/**
+* @file latent_sampler.cpp
+*
+* Gaussian latent samplers: NumPy RandomState compatible and Philox.
+* @author   Shozo Fukuda
+* @date     create Thu Aug 17 09:48:26 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+* NumPy: numpy/random/src/mt19937 (mt19937_seed, mt19937_gen) and
+* numpy/random/src/legacy (legacy_double, legacy_gauss). the Gaussian
+* is left scalar with the libm log/sqrt, as NumPy does; the rejection
+* loop of the polar method draws an unknown number of words per value.
+*
+* Philox: Philox4x32-10 of Random123 (Salmon et al., SC'11) on the
+* counter i and the key {seed, 0}, and the Box-Muller transform in float.
+* the AVX2 path runs 8 counters at once, the scalar path does the same
+* operations one by one, so the results do not depend on the build.
+**/
+/**************************************************************************{{{*/
+
+#include <string.h>
+#include <math.h>
+#include <random>
+#include "latent_sampler.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LATENT_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LATENT_SSE2
+#endif
+
+/* x1*x1 + x2*x2 and the polynomials must not be fused into FMA: the
+*  results would differ from NumPy and between the builds.
+*/
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+/*--- CONSTANT ---*/
+#define MT19937_M       397
+#define MT19937_MATRIX  0x9908b0dfU
+#define MT19937_UPPER   0x80000000U
+#define MT19937_LOWER   0x7fffffffU
+
+#define PHILOX_M0       0xD2511F53U
+#define PHILOX_M1       0xCD9E8D57U
+#define PHILOX_W0       0x9E3779B9U
+#define PHILOX_W1       0xBB67AE85U
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* seed
+* @par DESCRIPTION
+*   mt19937_seed() of NumPy (init_genrand of the reference MT19937), and
+*   no Gaussian kept.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+NumpyRandom::seed(uint32_t seed)
+{
+    for (int i = 0; i < MT19937_N; i++) {
+        mState[i] = seed;
+        seed = 1812433253U*(seed ^ (seed >> 30)) + i + 1;
+    }
+    mPos      = MT19937_N;
+    mHasGauss = false;
+    mGauss    = 0.0;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* regenerate state
+* @par DESCRIPTION
+*   the twist of the 624 words and their tempering. the word i takes the
+*   old words i+1 and i+397, or the new word i-227, so a vector of the
+*   words before 227-VLEN or between 227 and 623-VLEN has no dependency
+*   inside.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+NumpyRandom::generate()
+{
+    uint32_t* mt = mState;
+    int i = 0;
+
+    /*SUBROUTINE*/
+    auto twist = [](uint32_t u, uint32_t v, uint32_t m) {
+        uint32_t y = (u & MT19937_UPPER) | (v & MT19937_LOWER);
+        return m ^ (y >> 1) ^ ((0U - (y & 1U)) & MT19937_MATRIX);
+    };
+    /**/
+
+#if defined(LATENT_AVX2)
+    const __m256i upper  = _mm256_set1_epi32(MT19937_UPPER);
+    const __m256i lower  = _mm256_set1_epi32(MT19937_LOWER);
+    const __m256i matrix = _mm256_set1_epi32(MT19937_MATRIX);
+    const __m256i one    = _mm256_set1_epi32(1);
+    auto twist8 = [&](int i, int k) {
+        __m256i u = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mt + i));
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mt + i + 1));
+        __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mt + k));
+        __m256i y = _mm256_or_si256(_mm256_and_si256(u, upper), _mm256_and_si256(v, lower));
+        __m256i mag = _mm256_and_si256(_mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(y, one)), matrix);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(mt + i), _mm256_xor_si256(_mm256_xor_si256(m, _mm256_srli_epi32(y, 1)), mag));
+    };
+    for (; i + 8 <= MT19937_N - MT19937_M; i += 8) {
+        twist8(i, i + MT19937_M);
+    }
+    for (; i < MT19937_N - MT19937_M; i++) {
+        mt[i] = twist(mt[i], mt[i + 1], mt[i + MT19937_M]);
+    }
+    for (; i + 8 <= MT19937_N - 1; i += 8) {
+        twist8(i, i + MT19937_M - MT19937_N);
+    }
+#elif defined(LATENT_SSE2)
+    const __m128i upper  = _mm_set1_epi32(MT19937_UPPER);
+    const __m128i lower  = _mm_set1_epi32(MT19937_LOWER);
+    const __m128i matrix = _mm_set1_epi32(MT19937_MATRIX);
+    const __m128i one    = _mm_set1_epi32(1);
+    auto twist4 = [&](int i, int k) {
+        __m128i u = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mt + i));
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mt + i + 1));
+        __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mt + k));
+        __m128i y = _mm_or_si128(_mm_and_si128(u, upper), _mm_and_si128(v, lower));
+        __m128i mag = _mm_and_si128(_mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(y, one)), matrix);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mt + i), _mm_xor_si128(_mm_xor_si128(m, _mm_srli_epi32(y, 1)), mag));
+    };
+    for (; i + 4 <= MT19937_N - MT19937_M; i += 4) {
+        twist4(i, i + MT19937_M);
+    }
+    for (; i < MT19937_N - MT19937_M; i++) {
+        mt[i] = twist(mt[i], mt[i + 1], mt[i + MT19937_M]);
+    }
+    for (; i + 4 <= MT19937_N - 1; i += 4) {
+        twist4(i, i + MT19937_M - MT19937_N);
+    }
+#endif
+
+    // remainder (or everything on the scalar path)
+    for (; i < MT19937_N - MT19937_M; i++) {
+        mt[i] = twist(mt[i], mt[i + 1], mt[i + MT19937_M]);
+    }
+    for (; i < MT19937_N - 1; i++) {
+        mt[i] = twist(mt[i], mt[i + 1], mt[i + MT19937_M - MT19937_N]);
+    }
+    mt[MT19937_N - 1] = twist(mt[MT19937_N - 1], mt[0], mt[MT19937_M - 1]);
+
+    // tempering
+    i = 0;
+#if defined(LATENT_AVX2)
+    const __m256i t1 = _mm256_set1_epi32(0x9d2c5680);
+    const __m256i t2 = _mm256_set1_epi32(0xefc60000);
+    for (; i + 8 <= MT19937_N; i += 8) {
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mt + i));
+        y = _mm256_xor_si256(y, _mm256_srli_epi32(y, 11));
+        y = _mm256_xor_si256(y, _mm256_and_si256(_mm256_slli_epi32(y, 7), t1));
+        y = _mm256_xor_si256(y, _mm256_and_si256(_mm256_slli_epi32(y, 15), t2));
+        y = _mm256_xor_si256(y, _mm256_srli_epi32(y, 18));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(mOut + i), y);
+    }
+#elif defined(LATENT_SSE2)
+    const __m128i t1 = _mm_set1_epi32(0x9d2c5680);
+    const __m128i t2 = _mm_set1_epi32(0xefc60000);
+    for (; i + 4 <= MT19937_N; i += 4) {
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mt + i));
+        y = _mm_xor_si128(y, _mm_srli_epi32(y, 11));
+        y = _mm_xor_si128(y, _mm_and_si128(_mm_slli_epi32(y, 7), t1));
+        y = _mm_xor_si128(y, _mm_and_si128(_mm_slli_epi32(y, 15), t2));
+        y = _mm_xor_si128(y, _mm_srli_epi32(y, 18));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mOut + i), y);
+    }
+#endif
+    for (; i < MT19937_N; i++) {
+        uint32_t y = mt[i];
+        y ^= (y >> 11);
+        y ^= (y << 7) & 0x9d2c5680U;
+        y ^= (y << 15) & 0xefc60000U;
+        y ^= (y >> 18);
+        mOut[i] = y;
+    }
+
+    mPos = 0;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* standard normal
+* @par DESCRIPTION
+*   legacy_gauss() of NumPy: the polar method, the second value is kept
+*   for the next call.
+*
+* @retval value
+**/
+/**************************************************************************{{{*/
+double
+NumpyRandom::gauss()
+{
+    if (mHasGauss) {
+        mHasGauss = false;
+        return mGauss;
+    }
+
+    double f, x1, x2, r2;
+    do {
+        x1 = 2.0*random_double() - 1.0;
+        x2 = 2.0*random_double() - 1.0;
+        r2 = x1*x1 + x2*x2;
+    } while (r2 >= 1.0 || r2 == 0.0);
+
+    f = sqrt(-2.0*log(r2)/r2);
+    mGauss    = f*x1;
+    mHasGauss = true;
+    return f*x2;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* standard normals
+* @par DESCRIPTION
+*   randn(n) of RandomState. the float version rounds each double as
+*   Tensorflow does when the float64 latents are fed to a float graph.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+NumpyRandom::randn(double* out, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        out[i] = gauss();
+    }
+}
+
+void
+NumpyRandom::randn(float* out, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        out[i] = static_cast<float>(gauss());
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* NumPy latent
+* @par DESCRIPTION
+*   np.random.RandomState(seed).randn(n) in float, as generate.py and
+*   style_mixing.py draw z.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+randn_numpy(uint32_t seed, float* out, size_t n)
+{
+    NumpyRandom rnd(seed);
+    rnd.randn(out, n);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* Philox4x32-10
+* @par DESCRIPTION
+*   one block of 4 words for the counter 'ctr' and the key 'key'.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+philox4x32_10(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4])
+{
+    uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+    uint32_t k0 = key[0], k1 = key[1];
+
+    for (int r = 0; r < 10; r++) {
+        uint64_t p0 = uint64_t(PHILOX_M0)*c0;
+        uint64_t p1 = uint64_t(PHILOX_M1)*c2;
+        uint32_t n0 = uint32_t(p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = uint32_t(p0 >> 32) ^ c3 ^ k1;
+        c1 = uint32_t(p1);
+        c3 = uint32_t(p0);
+        c0 = n0;
+        c2 = n2;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* Box-Muller on a pair of words
+* @par DESCRIPTION
+*   u1 = (w0>>8 + 1)/2^24 in (0,1], u2 = (w1>>8)/2^24 in [0,1),
+*   z0 = sqrt(-2 log u1) cos(2 pi u2), z1 = sqrt(-2 log u1) sin(2 pi u2).
+*   log is the float one of Cephes, sin and cos are the Cephes polynomials
+*   on 2 pi u2 reduced by the octant of u2, which is exact.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+static inline float
+bits_float(uint32_t x)
+{
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+static inline uint32_t
+float_bits(float f)
+{
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    return x;
+}
+
+static inline void
+box_muller(uint32_t w0, uint32_t w1, float& z0, float& z1)
+{
+    float u1 = float((w0 >> 8) + 1)*(1.0f/16777216.0f);
+    float u2 = float(w1 >> 8)*(1.0f/16777216.0f);
+
+    // log u1: u1 = m 2^e, m in [sqrt(1/2), sqrt(2))
+    uint32_t bits = float_bits(u1);
+    float e = float(int32_t(bits >> 23) - 126);
+    float m = bits_float((bits & 0x807fffffU) | 0x3f000000U);
+    bool  below = m < 0.707106781186547524f;
+    e = e - (below ? 1.0f : 0.0f);
+    m = (m + (below ? m : 0.0f)) - 1.0f;
+    float z = m*m;
+    float y = 7.0376836292E-2f;
+    y = y*m + -1.1514610310E-1f;
+    y = y*m + 1.1676998740E-1f;
+    y = y*m + -1.2420140846E-1f;
+    y = y*m + 1.4249322787E-1f;
+    y = y*m + -1.6668057665E-1f;
+    y = y*m + 2.0000714765E-1f;
+    y = y*m + -2.4999993993E-1f;
+    y = y*m + 3.3333331174E-1f;
+    y = (y*m)*z;
+    y = y + -2.12194440E-4f*e;
+    y = y + -0.5f*z;
+    float lg = m + y;
+    lg = lg + 0.693359375f*e;
+    float r = sqrtf(-2.0f*lg);
+
+    // sin, cos of 2 pi u2: the nearest even octant j, x in [-pi/4, pi/4]
+    int32_t j = (int32_t(u2*8.0f) + 1) & ~1;
+    float x  = (u2 - float(j)*0.125f)*6.28318530717958647692f;
+    float xx = x*x;
+    float ps = -1.9515295891E-4f;
+    ps = ps*xx + 8.3321608736E-3f;
+    ps = ps*xx + -1.6666654611E-1f;
+    float s = (ps*xx)*x + x;
+    float pc = 2.443315711809948E-5f;
+    pc = pc*xx + -1.388731625493765E-3f;
+    pc = pc*xx + 4.166664568298827E-2f;
+    float c = (pc*xx)*xx + -0.5f*xx;
+    c = c + 1.0f;
+
+    int q = (j >> 1) & 3;
+    float sn = (q & 1) ? c : s;
+    float cs = (q & 1) ? s : c;
+    sn = bits_float(float_bits(sn) ^ ((q & 2) ? 0x80000000U : 0U));
+    cs = bits_float(float_bits(cs) ^ (((q + 1) & 2) ? 0x80000000U : 0U));
+
+    z0 = r*cs;
+    z1 = r*sn;
+}
+
+#if defined(LATENT_AVX2)
+/***  Module Header  ******************************************************}}}*/
+/**
+* Philox and Box-Muller of 8 counters
+* @par DESCRIPTION
+*   SIMD version of philox4x32_10() and box_muller() on the counters
+*   'ctr0'..'ctr0'+7: out[4*k + 0..3] for the counter ctr0+k.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+static inline __m256i
+mulhi8(__m256i a, __m256i m)
+{
+    __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(a, m), 32);
+    __m256i odd  = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+    return _mm256_blend_epi32(even, odd, 0xAA);
+}
+
+static inline void
+box_muller8(__m256i w0, __m256i w1, __m256& z0, __m256& z1)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256 u1 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_srli_epi32(w0, 8), _mm256_set1_epi32(1))), _mm256_set1_ps(1.0f/16777216.0f));
+    __m256 u2 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(w1, 8)), _mm256_set1_ps(1.0f/16777216.0f));
+
+    // log u1
+    __m256i bits = _mm256_castps_si256(u1);
+    __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126)));
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x807fffff)), _mm256_set1_epi32(0x3f000000)));
+    __m256 below = _mm256_cmp_ps(m, _mm256_set1_ps(0.707106781186547524f), _CMP_LT_OQ);
+    e = _mm256_sub_ps(e, _mm256_and_ps(below, one));
+    m = _mm256_sub_ps(_mm256_add_ps(m, _mm256_and_ps(below, m)), one);
+    __m256 z = _mm256_mul_ps(m, m);
+    __m256 y = _mm256_set1_ps(7.0376836292E-2f);
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(-1.1514610310E-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(1.1676998740E-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(-1.2420140846E-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(1.4249322787E-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(-1.6668057665E-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(2.0000714765E-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(-2.4999993993E-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(3.3333331174E-1f));
+    y = _mm256_mul_ps(_mm256_mul_ps(y, m), z);
+    y = _mm256_add_ps(y, _mm256_mul_ps(_mm256_set1_ps(-2.12194440E-4f), e));
+    y = _mm256_add_ps(y, _mm256_mul_ps(_mm256_set1_ps(-0.5f), z));
+    __m256 lg = _mm256_add_ps(m, y);
+    lg = _mm256_add_ps(lg, _mm256_mul_ps(_mm256_set1_ps(0.693359375f), e));
+    __m256 r = _mm256_sqrt_ps(_mm256_mul_ps(_mm256_set1_ps(-2.0f), lg));
+
+    // sin, cos of 2 pi u2
+    __m256i j = _mm256_and_si256(_mm256_add_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(u2, _mm256_set1_ps(8.0f))), _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+    __m256 x  = _mm256_mul_ps(_mm256_sub_ps(u2, _mm256_mul_ps(_mm256_cvtepi32_ps(j), _mm256_set1_ps(0.125f))), _mm256_set1_ps(6.28318530717958647692f));
+    __m256 xx = _mm256_mul_ps(x, x);
+    __m256 ps = _mm256_set1_ps(-1.9515295891E-4f);
+    ps = _mm256_add_ps(_mm256_mul_ps(ps, xx), _mm256_set1_ps(8.3321608736E-3f));
+    ps = _mm256_add_ps(_mm256_mul_ps(ps, xx), _mm256_set1_ps(-1.6666654611E-1f));
+    __m256 s = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(ps, xx), x), x);
+    __m256 pc = _mm256_set1_ps(2.443315711809948E-5f);
+    pc = _mm256_add_ps(_mm256_mul_ps(pc, xx), _mm256_set1_ps(-1.388731625493765E-3f));
+    pc = _mm256_add_ps(_mm256_mul_ps(pc, xx), _mm256_set1_ps(4.166664568298827E-2f));
+    __m256 c = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(pc, xx), xx), _mm256_mul_ps(_mm256_set1_ps(-0.5f), xx));
+    c = _mm256_add_ps(c, one);
+
+    __m256i q = _mm256_and_si256(_mm256_srli_epi32(j, 1), _mm256_set1_epi32(3));
+    __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+    __m256 sn = _mm256_blendv_ps(s, c, swap);
+    __m256 cs = _mm256_blendv_ps(c, s, swap);
+    __m256i sign_s = _mm256_slli_epi32(_mm256_and_si256(q, _mm256_set1_epi32(2)), 30);
+    __m256i sign_c = _mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30);
+    sn = _mm256_xor_ps(sn, _mm256_castsi256_ps(sign_s));
+    cs = _mm256_xor_ps(cs, _mm256_castsi256_ps(sign_c));
+
+    z0 = _mm256_mul_ps(r, cs);
+    z1 = _mm256_mul_ps(r, sn);
+}
+
+static inline void
+philox_normal8(uint32_t ctr0, uint32_t seed, float* out)
+{
+    const __m256i m0 = _mm256_set1_epi32(PHILOX_M0);
+    const __m256i m1 = _mm256_set1_epi32(PHILOX_M1);
+
+    __m256i c0 = _mm256_add_epi32(_mm256_set1_epi32(ctr0), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    __m256i c1 = _mm256_setzero_si256();
+    __m256i c2 = _mm256_setzero_si256();
+    __m256i c3 = _mm256_setzero_si256();
+    uint32_t k0 = seed, k1 = 0;
+
+    for (int r = 0; r < 10; r++) {
+        __m256i n0 = _mm256_xor_si256(_mm256_xor_si256(mulhi8(c2, m1), c1), _mm256_set1_epi32(k0));
+        __m256i n2 = _mm256_xor_si256(_mm256_xor_si256(mulhi8(c0, m0), c3), _mm256_set1_epi32(k1));
+        c1 = _mm256_mullo_epi32(c2, m1);
+        c3 = _mm256_mullo_epi32(c0, m0);
+        c0 = n0;
+        c2 = n2;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+
+    __m256 z0, z1, z2, z3;
+    box_muller8(c0, c1, z0, z1);
+    box_muller8(c2, c3, z2, z3);
+
+    // [4][8] -> [8][4]
+    __m256 t0 = _mm256_unpacklo_ps(z0, z1);
+    __m256 t1 = _mm256_unpackhi_ps(z0, z1);
+    __m256 t2 = _mm256_unpacklo_ps(z2, z3);
+    __m256 t3 = _mm256_unpackhi_ps(z2, z3);
+    __m256 v0 = _mm256_shuffle_ps(t0, t2, 0x44);
+    __m256 v1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+    __m256 v2 = _mm256_shuffle_ps(t1, t3, 0x44);
+    __m256 v3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+    _mm256_storeu_ps(out,      _mm256_permute2f128_ps(v0, v1, 0x20));
+    _mm256_storeu_ps(out + 8,  _mm256_permute2f128_ps(v2, v3, 0x20));
+    _mm256_storeu_ps(out + 16, _mm256_permute2f128_ps(v0, v1, 0x31));
+    _mm256_storeu_ps(out + 24, _mm256_permute2f128_ps(v2, v3, 0x31));
+}
+#endif
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* Philox latent
+* @par DESCRIPTION
+*   the counter i gives out[4i..4i+3]: z0, z1 of the words 0,1 and z0, z1
+*   of the words 2,3. no state is carried from one value to the next, so
+*   the latents can be drawn in any order and on any thread.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+randn_philox(uint32_t seed, float* out, size_t n)
+{
+    const uint32_t key[2] = { seed, 0 };
+    size_t i = 0;
+
+#if defined(LATENT_AVX2)
+    for (; i + 32 <= n; i += 32) {
+        philox_normal8(uint32_t(i/4), seed, out + i);
+    }
+#endif
+
+    // remainder (or everything on the scalar path)
+    for (; i < n; i += 4) {
+        const uint32_t ctr[4] = { uint32_t(i/4), 0, 0, 0 };
+        uint32_t w[4];
+        float z[4];
+        philox4x32_10(ctr, key, w);
+        box_muller(w[0], w[1], z[0], z[1]);
+        box_muller(w[2], w[3], z[2], z[3]);
+        for (size_t k = 0; k < 4 && i + k < n; k++) {
+            out[i + k] = z[k];
+        }
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* uniform latent
+* @par DESCRIPTION
+*   the per-element loop of the former generate, kept to render the same
+*   images as before and as the baseline of the benchmark.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+rand_uniform_mt(uint32_t seed, float* out, size_t n)
+{
+    std::uniform_real_distribution<float> dist(0.0, 1.0);
+    std::mt19937 engine(seed);
+
+    for (size_t i = 0; i < n; i++) {
+        out[i] = dist(engine);
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* sampler by name
+* @par DESCRIPTION
+*
+*
+* @retval sampler
+* @retval nullptr  unknown name
+**/
+/**************************************************************************{{{*/
+LatentSampler
+latent_sampler(const std::string& name)
+{
+    if (name == "numpy") {
+        return randn_numpy;
+    }
+    else if (name == "philox") {
+        return randn_philox;
+    }
+    else if (name == "uniform") {
+        return rand_uniform_mt;
+    }
+    return nullptr;
+}
+
+/*** latent_sampler.cpp ***************************************************}}}*/
@@ -0,0 +1,85 @@
+/***  File Header  ************************************************************/
+/**
+* @file latent_sampler.h
+*
+* Gaussian latent samplers: NumPy RandomState compatible and Philox.
+* @author   Shozo Fukuda
+* @date     create Thu Aug 17 09:48:26 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+#ifndef _LATENT_SAMPLER_H
+#define _LATENT_SAMPLER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+/*--- CONSTANT ---*/
+#define MT19937_N   624     // words of the state
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* NumPy random state
+* @par DESCRIPTION
+*   the MT19937 and the Gaussian of np.random.RandomState(seed): the same
+*   seeding, the same 53-bit doubles and the same polar Box-Muller with
+*   the second value kept for the next call, so randn() gives the same
+*   stream bit by bit. the state is regenerated and tempered 624 words at
+*   once with AVX2/SSE2 when they are enabled at compile time.
+**/
+/**************************************************************************{{{*/
+class NumpyRandom {
+//LIFECYCLE:
+public:
+    explicit NumpyRandom(uint32_t seed) { this->seed(seed); }
+
+//ACTION:
+public:
+    void seed(uint32_t seed);
+
+    uint32_t random_uint32() {
+        if (mPos >= MT19937_N) {
+            generate();
+        }
+        return mOut[mPos++];
+    }
+    double random_double() {
+        int32_t a = random_uint32() >> 5;
+        int32_t b = random_uint32() >> 6;
+        return (a*67108864.0 + b)/9007199254740992.0;
+    }
+    double gauss();
+    void randn(double* out, size_t n);
+    void randn(float* out, size_t n);
+
+private:
+    void generate();
+
+//ATTRIBUTE:
+private:
+    uint32_t mState[MT19937_N];
+    uint32_t mOut[MT19937_N];   // tempered words of the state
+    int      mPos;
+    bool     mHasGauss;
+    double   mGauss;
+};
+
+/*--- EXTERNAL MODULE ---*/
+/* np.random.RandomState(seed).randn(n).astype(np.float32) */
+void randn_numpy(uint32_t seed, float* out, size_t n);
+
+/* uniform [0,1) of std::mt19937, the latents of the former versions */
+void rand_uniform_mt(uint32_t seed, float* out, size_t n);
+
+/* counter-based: out[i] depends only on the seed and i */
+void randn_philox(uint32_t seed, float* out, size_t n);
+void philox4x32_10(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]);
+
+/* sampler by name: "numpy", "philox" or "uniform", nullptr for unknown */
+typedef void (*LatentSampler)(uint32_t seed, float* out, size_t n);
+LatentSampler latent_sampler(const std::string& name);
+
+#endif /* _LATENT_SAMPLER_H */
+/*** latent_sampler.h *****************************************************}}}*/
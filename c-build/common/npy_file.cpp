@@ -0,0 +1,391 @@
+/***  File Header  ************************************************************/
+/**
+* @file npy_file.cpp
+*
+* Memory-mapped reader of NumPy .npy/.npz arrays.
+* @author   Shozo Fukuda
+* @date     create Thu Jul 20 15:31:08 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+* .npy format (numpy/lib/format.py):
+*   "\x93NUMPY" major minor HEADER_LEN(u16 v1, u32 v2/v3) header(python dict)
+* .npz is a zip archive of .npy files. zip64 records are used by np.savez.
+**/
+/**************************************************************************{{{*/
+
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "npy_file.h"
+
+/*--- little endian fields ---*/
+static inline uint16_t le16(const uint8_t* p) { uint16_t v; memcpy(&v, p, 2); return v; }
+static inline uint32_t le32(const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+static inline uint64_t le64(const uint8_t* p) { uint64_t v; memcpy(&v, p, 8); return v; }
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* constructor
+* @par DESCRIPTION
+*   construct an instance.
+**/
+/**************************************************************************{{{*/
+NpyFile::NpyFile()
+    : mBase(nullptr), mSize(0),
+#ifdef _WIN32
+      mFile(INVALID_HANDLE_VALUE), mMapping(NULL),
+#endif
+      mData(nullptr), mItemSize(0)
+{
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* destructor
+* @par DESCRIPTION
+*   unmap the file.
+**/
+/**************************************************************************{{{*/
+NpyFile::~NpyFile()
+{
+    close();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* open array
+* @par DESCRIPTION
+*   map the .npy file, or the array 'key' of the .npz archive. the first
+*   array in the archive is taken when 'key' is empty.
+*
+* @retval true  success
+* @retval false error, see error()
+**/
+/**************************************************************************{{{*/
+bool
+NpyFile::open(const std::string& path, const std::string& key)
+{
+    close();
+
+    if (!map(path)) {
+        return false;
+    }
+
+    uint64_t offset = 0;
+    if (mSize >= 4 && le32(mBase) == 0x04034b50) {     // "PK\3\4"
+        if (!find_npz_entry(key, offset)) {
+            close();
+            return false;
+        }
+    }
+
+    if (!parse_header(offset)) {
+        close();
+        return false;
+    }
+
+#ifndef _WIN32
+    // the arrays are read from head to tail once
+    madvise(const_cast<uint8_t*>(mBase), mSize, MADV_SEQUENTIAL);
+#endif
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* close
+* @par DESCRIPTION
+*
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+NpyFile::close()
+{
+#ifdef _WIN32
+    if (mBase != nullptr) {
+        UnmapViewOfFile(mBase);
+    }
+    if (mMapping != NULL) {
+        CloseHandle(mMapping);
+        mMapping = NULL;
+    }
+    if (mFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(mFile);
+        mFile = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (mBase != nullptr) {
+        munmap(const_cast<uint8_t*>(mBase), mSize);
+    }
+#endif
+    mBase = nullptr;
+    mSize = 0;
+    mData = nullptr;
+    mShape.clear();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* bytes of a row
+* @par DESCRIPTION
+*   size of the sub-array along the leading dimension.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+size_t
+NpyFile::row_bytes() const
+{
+    size_t size = mItemSize;
+    for (size_t i = 1; i < mShape.size(); i++) {
+        size *= mShape[i];
+    }
+    return size;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* map file
+* @par DESCRIPTION
+*   map the whole file read-only.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+bool
+NpyFile::map(const std::string& path)
+{
+#ifdef _WIN32
+    mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (mFile == INVALID_HANDLE_VALUE) {
+        return fail("can't open " + path);
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(mFile, &size) || size.QuadPart == 0) {
+        return fail("empty file " + path);
+    }
+    mMapping = CreateFileMappingA(mFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mMapping == NULL) {
+        return fail("can't map " + path);
+    }
+    mBase = reinterpret_cast<const uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+    if (mBase == nullptr) {
+        return fail("can't map " + path);
+    }
+    mSize = size.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return fail("can't open " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return fail("empty file " + path);
+    }
+    void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);     // the mapping keeps the file
+    if (base == MAP_FAILED) {
+        return fail("can't map " + path);
+    }
+    mBase = reinterpret_cast<const uint8_t*>(base);
+    mSize = st.st_size;
+#endif
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* find array in npz
+* @par DESCRIPTION
+*   look up "<key>.npy" in the central directory of the zip archive and
+*   return the offset of its data (the .npy image).
+*
+* @retval true  found
+* @retval false not found, compressed or broken archive
+**/
+/**************************************************************************{{{*/
+bool
+NpyFile::find_npz_entry(const std::string& key, uint64_t& offset)
+{
+    // end of central directory record, followed by the comment up to 64KB
+    if (mSize < 22) {
+        return fail("broken npz");
+    }
+    const uint8_t* eocd = nullptr;
+    uint64_t limit = (mSize > 22 + 0xffff) ? mSize - 22 - 0xffff : 0;
+    for (uint64_t pos = mSize - 22; ; pos--) {
+        if (le32(mBase + pos) == 0x06054b50) {
+            eocd = mBase + pos;
+            break;
+        }
+        if (pos == limit) {
+            return fail("broken npz: no end of central directory");
+        }
+    }
+
+    uint64_t entries = le16(eocd + 10);
+    uint64_t cd_size = le32(eocd + 12);
+    uint64_t cd_offs = le32(eocd + 16);
+    if (cd_offs == 0xffffffff || entries == 0xffff) {
+        // zip64 end of central directory, located by the locator before EOCD
+        const uint8_t* locator = eocd - 20;
+        if (locator < mBase || le32(locator) != 0x07064b50) {
+            return fail("broken npz: no zip64 locator");
+        }
+        uint64_t pos = le64(locator + 8);
+        if (pos + 56 > mSize || le32(mBase + pos) != 0x06064b50) {
+            return fail("broken npz: no zip64 end of central directory");
+        }
+        entries = le64(mBase + pos + 32);
+        cd_size = le64(mBase + pos + 40);
+        cd_offs = le64(mBase + pos + 48);
+    }
+    if (cd_offs + cd_size > mSize) {
+        return fail("broken npz: central directory");
+    }
+
+    std::string name = key.empty() ? "" : key + ".npy";
+
+    const uint8_t* p   = mBase + cd_offs;
+    const uint8_t* end = p + cd_size;
+    for (uint64_t i = 0; i < entries && p + 46 <= end && le32(p) == 0x02014b50; i++) {
+        uint16_t method    = le16(p + 10);
+        uint64_t comp_size = le32(p + 20);
+        uint16_t name_len  = le16(p + 28);
+        uint16_t extra_len = le16(p + 30);
+        uint16_t comm_len  = le16(p + 32);
+        uint64_t local     = le32(p + 42);
+        std::string entry(reinterpret_cast<const char*>(p + 46), name_len);
+
+        // zip64 extended information: the fields saturated in the entry follow in order
+        const uint8_t* extra = p + 46 + name_len;
+        for (const uint8_t* x = extra; x + 4 <= extra + extra_len; x += 4 + le16(x + 2)) {
+            if (le16(x) != 0x0001) {
+                continue;
+            }
+            const uint8_t* field = x + 4;
+            if (le32(p + 24) == 0xffffffff) { field += 8; }
+            if (comp_size == 0xffffffff)    { comp_size = le64(field); field += 8; }
+            if (local == 0xffffffff)        { local = le64(field); }
+        }
+
+        bool match = name.empty() ? (entry.size() > 4 && entry.compare(entry.size() - 4, 4, ".npy") == 0) : (entry == name);
+        if (match) {
+            if (method != 0) {
+                return fail(entry + " is compressed, save it with np.savez");
+            }
+            if (local + 30 > mSize || le32(mBase + local) != 0x04034b50) {
+                return fail("broken npz: local header of " + entry);
+            }
+            offset = local + 30 + le16(mBase + local + 26) + le16(mBase + local + 28);
+            return true;
+        }
+
+        p += 46 + name_len + extra_len + comm_len;
+    }
+
+    return fail("no array " + (name.empty() ? std::string("*.npy") : name) + " in npz");
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* parse npy header
+* @par DESCRIPTION
+*   read dtype and shape from the header dict, e.g.
+*   {'descr': '<f4', 'fortran_order': False, 'shape': (8, 18, 512), }
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+bool
+NpyFile::parse_header(uint64_t offset)
+{
+    const uint8_t* p = mBase + offset;
+    if (offset + 10 > mSize || memcmp(p, "\x93NUMPY", 6) != 0) {
+        return fail("not a npy array");
+    }
+
+    uint64_t header_len, data;
+    if (p[6] == 1) {
+        header_len = le16(p + 8);
+        data = 10;
+    }
+    else {
+        header_len = le32(p + 8);
+        data = 12;
+    }
+    if (offset + data + header_len > mSize) {
+        return fail("broken npy header");
+    }
+    std::string header(reinterpret_cast<const char*>(p + data), header_len);
+
+    /*SUBROUTINE*/
+    auto value_of = [&](const char* key) -> size_t {
+        size_t pos = header.find(key);
+        if (pos == std::string::npos) {
+            return pos;
+        }
+        pos = header.find(':', pos);
+        return (pos == std::string::npos) ? pos : header.find_first_not_of(" ", pos + 1);
+    };
+    /**/
+
+    size_t pos = value_of("'descr'");
+    if (pos == std::string::npos || header[pos] != '\'') {
+        return fail("npy header: no descr");
+    }
+    mDescr = header.substr(pos + 1, header.find('\'', pos + 1) - pos - 1);
+    if (mDescr.size() < 3 || mDescr[0] == '>') {
+        return fail("npy header: unsupported dtype " + mDescr);
+    }
+    mItemSize = atoi(mDescr.c_str() + 2);
+
+    pos = value_of("'fortran_order'");
+    if (pos == std::string::npos || header.compare(pos, 4, "True") == 0) {
+        return fail("npy header: fortran order is not supported");
+    }
+
+    pos = value_of("'shape'");
+    if (pos == std::string::npos || header[pos] != '(') {
+        return fail("npy header: no shape");
+    }
+    mShape.clear();
+    const char* s = header.c_str() + pos + 1;
+    for (;;) {
+        char* next;
+        long long dim = strtoll(s, &next, 10);
+        if (next == s) {
+            break;
+        }
+        mShape.push_back(dim);
+        s = next;
+        while (*s == ',' || *s == ' ' || *s == 'L') { s++; }
+    }
+
+    uint64_t size = mItemSize;
+    for (auto dim : mShape) {
+        size *= dim;
+    }
+    mData = p + data + header_len;
+    if (uint64_t(mData - mBase) + size > mSize) {
+        return fail("npy data is truncated");
+    }
+
+    return true;
+}
+
+/*** npy_file.cpp *********************************************************}}}*/
@@ -0,0 +1,79 @@
+/***  File Header  ************************************************************/
+/**
+* @file npy_file.h
+*
+* Memory-mapped reader of NumPy .npy/.npz arrays.
+* @author   Shozo Fukuda
+* @date     create Thu Jul 20 15:31:08 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+#ifndef _NPY_FILE_H
+#define _NPY_FILE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* NumPy array file
+* @par DESCRIPTION
+*   maps the file into the memory and points at the array data in place,
+*   so nothing is read until it is touched. in the .npz archive, the array
+*   must be stored without compression (np.savez, not np.savez_compressed).
+**/
+/**************************************************************************{{{*/
+class NpyFile {
+//LIFECYCLE:
+public:
+    NpyFile();
+    virtual ~NpyFile();
+
+//ACTION:
+public:
+    bool open(const std::string& path, const std::string& key = "");
+    void close();
+
+//ACCESSOR:
+public:
+    const void* data() const { return mData; }
+
+    /* the i-th sub-array along the leading dimension */
+    template <typename T>
+    const T* row(int64_t index) const { return reinterpret_cast<const T*>(mData + index*row_bytes()); }
+
+//INQUIRY:
+public:
+    const std::string& error() const { return mError; }
+    const std::string& descr() const { return mDescr; }
+    const std::vector<int64_t>& shape() const { return mShape; }
+    size_t  item_size() const { return mItemSize; }
+    size_t  row_bytes() const;
+
+private:
+    bool map(const std::string& path);
+    bool find_npz_entry(const std::string& key, uint64_t& offset);
+    bool parse_header(uint64_t offset);
+    bool fail(const std::string& message) { mError = message; return false; }
+
+//ATTRIBUTE:
+private:
+    const uint8_t* mBase;       // mapped file
+    uint64_t       mSize;
+#ifdef _WIN32
+    void*          mFile;
+    void*          mMapping;
+#endif
+
+    const uint8_t*       mData; // array data in the mapping
+    std::string          mDescr;
+    size_t               mItemSize;
+    std::vector<int64_t> mShape;
+
+    std::string mError;
+};
+
+#endif /* _NPY_FILE_H */
+/*** npy_file.h ***********************************************************}}}*/
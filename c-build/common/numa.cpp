@@ -0,0 +1,189 @@
+/***  File Header  ************************************************************/
+/**
+* @file numa.cpp
+*
+* NUMA topology and thread binding.
+* @author   Shozo Fukuda
+* @date     create Mon Jul 24 13:02:51 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+* the threads created by a thread inherit its CPU affinity and (on Linux)
+* its memory policy. binding the thread which creates a TF session binds
+* the thread pools of the session as well.
+**/
+/**************************************************************************{{{*/
+
+#pragma warning(disable : 4996)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#include "numa.h"
+
+#ifndef _WIN32
+/***  Module Header  ******************************************************}}}*/
+/**
+* parse cpu list
+* @par DESCRIPTION
+*   sysfs list format, e.g. "0-15,32-47".
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+static bool
+read_cpu_list(const char* path, std::vector<int>& cpus)
+{
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL) {
+        return false;
+    }
+    char buff[4096];
+    bool res = fgets(buff, sizeof(buff), fp) != NULL;
+    fclose(fp);
+    if (!res) {
+        return false;
+    }
+
+    cpus.clear();
+    for (char* p = buff; *p != '\0' && *p != '\n'; ) {
+        char* next;
+        int beg = strtol(p, &next, 10);
+        if (next == p) {
+            break;
+        }
+        int end = beg;
+        if (*next == '-') {
+            p = next + 1;
+            end = strtol(p, &next, 10);
+        }
+        for (int cpu = beg; cpu <= end; cpu++) {
+            cpus.push_back(cpu);
+        }
+        p = (*next == ',') ? next + 1 : next;
+    }
+    return !cpus.empty();
+}
+#endif
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* number of NUMA nodes
+* @par DESCRIPTION
+*   1 on the machine without NUMA information.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+int
+numa_node_count()
+{
+#ifdef _WIN32
+    ULONG highest;
+    return GetNumaHighestNodeNumber(&highest) ? highest + 1 : 1;
+#else
+    std::vector<int> nodes;
+    if (!read_cpu_list("/sys/devices/system/node/online", nodes)) {
+        return 1;
+    }
+    return nodes.back() + 1;
+#endif
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* CPUs of NUMA node
+* @par DESCRIPTION
+*   list the logical CPUs of 'node'. without NUMA information, node 0 has
+*   all the CPUs.
+*
+* @retval true  success
+* @retval false no such node
+**/
+/**************************************************************************{{{*/
+bool
+numa_node_cpus(int node, std::vector<int>& cpus)
+{
+    cpus.clear();
+#ifdef _WIN32
+    GROUP_AFFINITY affinity;
+    if (!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity)) {
+        return false;
+    }
+    for (int bit = 0; bit < 64; bit++) {
+        if (affinity.Mask & (KAFFINITY(1) << bit)) {
+            cpus.push_back(affinity.Group*64 + bit);
+        }
+    }
+#else
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    if (!read_cpu_list(path, cpus)) {
+        if (node != 0) {
+            return false;
+        }
+        for (unsigned int cpu = 0; cpu < std::thread::hardware_concurrency(); cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+#endif
+    return !cpus.empty();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* bind thread to NUMA node
+* @par DESCRIPTION
+*   run the calling thread on the CPUs of 'node' and allocate its memory
+*   there. on Windows, the memory follows the node of the running CPU.
+*
+* @retval true  success
+* @retval false can't bind
+**/
+/**************************************************************************{{{*/
+bool
+numa_bind_thread(int node)
+{
+#ifdef _WIN32
+    GROUP_AFFINITY affinity;
+    if (!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity)) {
+        return false;
+    }
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL) != 0;
+#else
+    std::vector<int> cpus;
+    if (!numa_node_cpus(node, cpus)) {
+        return false;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        return false;
+    }
+
+    // MPOL_BIND without libnuma. fails quietly on the kernel without NUMA.
+    const int MPOL_BIND_ = 2;
+    unsigned long mask[1024/(8*sizeof(unsigned long))] = { 0 };
+    if (node < 1024) {
+        mask[node/(8*sizeof(unsigned long))] |= 1UL << (node % (8*sizeof(unsigned long)));
+        syscall(SYS_set_mempolicy, MPOL_BIND_, mask, 1024 + 1);
+    }
+    return true;
+#endif
+}
+
+/*** numa.cpp *************************************************************}}}*/
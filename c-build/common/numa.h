@@ -0,0 +1,23 @@
+/***  File Header  ************************************************************/
+/**
+* @file numa.h
+*
+* NUMA topology and thread binding.
+* @author   Shozo Fukuda
+* @date     create Mon Jul 24 13:02:51 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+#ifndef _NUMA_H
+#define _NUMA_H
+
+#include <vector>
+
+/*--- EXTERNAL MODULE ---*/
+int  numa_node_count();
+bool numa_node_cpus(int node, std::vector<int>& cpus);
+bool numa_bind_thread(int node);
+
+#endif /* _NUMA_H */
+/*** numa.h ***************************************************************}}}*/
@@ -0,0 +1,334 @@
+/***  File Header  ************************************************************/
+/**
+* @file signature_def.cpp
+*
+* SignatureDef reader for the MetaGraphDef of SavedModel
+* @author   Shozo Fukuda
+* @date     create Tue Jul 18 11:20:45 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+* Messages and field numbers (tensorflow/core/protobuf/meta_graph.proto):
+*   MetaGraphDef { map<string, SignatureDef> signature_def = 5; }
+*   SignatureDef { map<string, TensorInfo> inputs = 1; outputs = 2; }
+*   TensorInfo   { string name = 1; DataType dtype = 2; TensorShapeProto tensor_shape = 3; }
+*   TensorShapeProto { repeated Dim dim = 2; bool unknown_rank = 3; }, Dim { int64 size = 1; }
+*   map entry    { key = 1; value = 2; }
+**/
+/**************************************************************************{{{*/
+
+#include <algorithm>
+#include "signature_def.h"
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* read tag
+* @par DESCRIPTION
+*   read the next field tag.
+*
+* @retval true  got a field
+* @retval false end of the message or error
+**/
+/**************************************************************************{{{*/
+bool
+ProtoReader::next(uint32_t& field, int& wire_type)
+{
+    if (mError || mPtr >= mEnd) {
+        return false;
+    }
+    uint64_t tag = varint();
+    field     = static_cast<uint32_t>(tag >> 3);
+    wire_type = static_cast<int>(tag & 7);
+    return !mError;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* read varint
+* @par DESCRIPTION
+*
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+uint64_t
+ProtoReader::varint()
+{
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (mPtr >= mEnd) {
+            break;
+        }
+        uint8_t byte = *mPtr++;
+        value |= uint64_t(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    mError = true;
+    return 0;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* read embedded message
+* @par DESCRIPTION
+*   reader on the length-delimited field.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+ProtoReader
+ProtoReader::message()
+{
+    uint64_t len = varint();
+    if (mError || len > uint64_t(mEnd - mPtr)) {
+        mError = true;
+        return ProtoReader(mEnd, 0);
+    }
+    ProtoReader sub(mPtr, len);
+    mPtr += len;
+    return sub;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* read string
+* @par DESCRIPTION
+*
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+std::string
+ProtoReader::string()
+{
+    ProtoReader sub = message();
+    return std::string(reinterpret_cast<const char*>(sub.mPtr), sub.mEnd - sub.mPtr);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* skip field
+* @par DESCRIPTION
+*   skip the value of an unused field.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+void
+ProtoReader::skip(int wire_type)
+{
+    switch (wire_type) {
+    case WIRE_VARINT:  varint();  break;
+    case WIRE_FIXED64: mPtr += 8; break;
+    case WIRE_BYTES:   message(); break;
+    case WIRE_FIXED32: mPtr += 4; break;
+    default:
+        mError = true;
+        break;
+    }
+    if (mPtr > mEnd) {
+        mError = true;
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* parse TensorShapeProto
+* @par DESCRIPTION
+*
+*
+* @retval true  success
+* @retval false broken message
+**/
+/**************************************************************************{{{*/
+static bool
+parse_tensor_shape(ProtoReader shape, TensorInfo& info)
+{
+    info.mHasShape = true;
+
+    uint32_t field;
+    int      wire;
+    while (shape.next(field, wire)) {
+        if (field == 2 && wire == ProtoReader::WIRE_BYTES) {
+            int64_t size = -1;
+            ProtoReader dim = shape.message();
+            while (dim.next(field, wire)) {
+                if (field == 1 && wire == ProtoReader::WIRE_VARINT) {
+                    size = static_cast<int64_t>(dim.varint());
+                }
+                else {
+                    dim.skip(wire);
+                }
+            }
+            if (dim.error()) {
+                return false;
+            }
+            info.mShape.push_back(size);
+        }
+        else if (field == 3 && wire == ProtoReader::WIRE_VARINT) {
+            if (shape.varint() != 0) {
+                info.mHasShape = false;
+            }
+        }
+        else {
+            shape.skip(wire);
+        }
+    }
+    if (!info.mHasShape) {
+        info.mShape.clear();
+    }
+    return !shape.error();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* parse TensorInfo map entry
+* @par DESCRIPTION
+*
+*
+* @retval true  success
+* @retval false broken message
+**/
+/**************************************************************************{{{*/
+static bool
+parse_tensor_info_entry(ProtoReader entry, TensorInfo& info)
+{
+    info.mDType    = 0;
+    info.mHasShape = false;
+
+    uint32_t field;
+    int      wire;
+    while (entry.next(field, wire)) {
+        if (field == 1 && wire == ProtoReader::WIRE_BYTES) {
+            info.mKey = entry.string();
+        }
+        else if (field == 2 && wire == ProtoReader::WIRE_BYTES) {
+            ProtoReader value = entry.message();
+            while (value.next(field, wire)) {
+                if (field == 1 && wire == ProtoReader::WIRE_BYTES) {
+                    info.mName = value.string();
+                }
+                else if (field == 2 && wire == ProtoReader::WIRE_VARINT) {
+                    info.mDType = static_cast<int>(value.varint());
+                }
+                else if (field == 3 && wire == ProtoReader::WIRE_BYTES) {
+                    if (!parse_tensor_shape(value.message(), info)) {
+                        return false;
+                    }
+                }
+                else {
+                    value.skip(wire);
+                }
+            }
+            if (value.error()) {
+                return false;
+            }
+        }
+        else {
+            entry.skip(wire);
+        }
+    }
+
+    return !entry.error();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* parse signature defs
+* @par DESCRIPTION
+*   extract the signature_def map from the serialized MetaGraphDef which
+*   TF_LoadSessionFromSavedModel returns. an error in any nested message
+*   fails the whole parse.
+*
+* @retval true  success
+* @retval false broken message
+**/
+/**************************************************************************{{{*/
+bool
+parse_signature_defs(const void* meta_graph_def, size_t size, SignatureMap& signatures)
+{
+    ProtoReader meta(meta_graph_def, size);
+
+    uint32_t field;
+    int      wire;
+    while (meta.next(field, wire)) {
+        if (field != 5 || wire != ProtoReader::WIRE_BYTES) {
+            meta.skip(wire);    // the graph_def is skipped without decoding
+            continue;
+        }
+
+        std::string name;
+        Signature   signature;
+
+        ProtoReader entry = meta.message();
+        while (entry.next(field, wire)) {
+            if (field == 1 && wire == ProtoReader::WIRE_BYTES) {
+                name = entry.string();
+            }
+            else if (field == 2 && wire == ProtoReader::WIRE_BYTES) {
+                ProtoReader def = entry.message();
+                while (def.next(field, wire)) {
+                    if (field == 1 && wire == ProtoReader::WIRE_BYTES) {
+                        signature.mInputs.emplace_back();
+                        if (!parse_tensor_info_entry(def.message(), signature.mInputs.back())) {
+                            return false;
+                        }
+                    }
+                    else if (field == 2 && wire == ProtoReader::WIRE_BYTES) {
+                        signature.mOutputs.emplace_back();
+                        if (!parse_tensor_info_entry(def.message(), signature.mOutputs.back())) {
+                            return false;
+                        }
+                    }
+                    else {
+                        def.skip(wire);
+                    }
+                }
+                if (def.error()) {
+                    return false;
+                }
+            }
+            else {
+                entry.skip(wire);
+            }
+        }
+        if (entry.error()) {
+            return false;
+        }
+
+        // map entries are serialized in no particular order
+        auto by_key = [](const TensorInfo& a, const TensorInfo& b) { return a.mKey < b.mKey; };
+        std::sort(signature.mInputs.begin(),  signature.mInputs.end(),  by_key);
+        std::sort(signature.mOutputs.begin(), signature.mOutputs.end(), by_key);
+
+        signatures[name] = signature;
+    }
+
+    return !meta.error();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* split tensor name
+* @par DESCRIPTION
+*   "op_name:index" -> op_name, index. index is 0 without ":index".
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+split_tensor_name(const std::string& name, std::string& op_name, int& index)
+{
+    auto pos = name.rfind(':');
+    if (pos == std::string::npos) {
+        op_name = name;
+        index   = 0;
+    }
+    else {
+        op_name = name.substr(0, pos);
+        index   = std::stoi(name.substr(pos + 1));
+    }
+}
+
+/*** signature_def.cpp ****************************************************}}}*/
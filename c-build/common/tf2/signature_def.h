@@ -0,0 +1,95 @@
+/***  File Header  ************************************************************/
+/**
+* @file signature_def.h
+*
+* SignatureDef reader for the MetaGraphDef of SavedModel
+* @author   Shozo Fukuda
+* @date     create Tue Jul 18 11:20:45 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+#ifndef _SIGNATURE_DEF_H
+#define _SIGNATURE_DEF_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+
+/*--- CONSTANT ---*/
+#define SIGNATURE_SERVING_DEFAULT   "serving_default"
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Protobuf wire format reader
+* @par DESCRIPTION
+*   minimal decoder of the protobuf wire format. it is enough to walk the
+*   few messages we need without linking libprotobuf.
+**/
+/**************************************************************************{{{*/
+class ProtoReader {
+//TYPE:
+public:
+    enum WireType {
+        WIRE_VARINT = 0,
+        WIRE_FIXED64 = 1,
+        WIRE_BYTES = 2,
+        WIRE_FIXED32 = 5,
+    };
+
+//LIFECYCLE:
+public:
+    ProtoReader(const void* data, size_t size)
+        : mPtr(reinterpret_cast<const uint8_t*>(data)), mEnd(mPtr + size), mError(false) {}
+
+//ACTION:
+public:
+    bool next(uint32_t& field, int& wire_type);
+    uint64_t varint();
+    ProtoReader message();
+    std::string string();
+    void skip(int wire_type);
+
+//INQUIRY:
+public:
+    bool error() const { return mError; }
+    const void* data() const { return mPtr; }       // the unread bytes
+    size_t size() const { return mEnd - mPtr; }
+
+//ATTRIBUTE:
+private:
+    const uint8_t* mPtr;
+    const uint8_t* mEnd;
+    bool           mError;
+};
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Signature
+* @par DESCRIPTION
+*   inputs and outputs of a SignatureDef. the tensors are listed in the
+*   order of their keys.
+**/
+/**************************************************************************{{{*/
+struct TensorInfo {
+    std::string mKey;       // key in the signature, e.g. "latents"
+    std::string mName;      // tensor name in the graph, e.g. "Gs/latents_in:0"
+    int         mDType;     // TF_DataType
+    bool        mHasShape;  // false: unknown rank
+    std::vector<int64_t> mShape;    // -1 for unknown dimension, e.g. batch
+};
+
+struct Signature {
+    std::vector<TensorInfo> mInputs;
+    std::vector<TensorInfo> mOutputs;
+};
+
+typedef std::map<std::string, Signature> SignatureMap;
+
+/*--- EXTERNAL MODULE ---*/
+bool parse_signature_defs(const void* meta_graph_def, size_t size, SignatureMap& signatures);
+void split_tensor_name(const std::string& name, std::string& op_name, int& index);
+
+#endif /* _SIGNATURE_DEF_H */
+/*** signature_def.h ******************************************************}}}*/
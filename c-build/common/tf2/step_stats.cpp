@@ -0,0 +1,222 @@
+/***  File Header  ************************************************************/
+/**
+* @file step_stats.cpp
+*
+* Per-op trace from the RunMetadata of the traced session runs
+* @author   Shozo Fukuda
+* @date     create Wed Aug 02 14:36:09 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+* Messages and field numbers (tensorflow/core/protobuf/config.proto,
+* tensorflow/core/framework/step_stats.proto):
+*   RunMetadata     { StepStats step_stats = 1; }
+*   StepStats       { repeated DeviceStepStats dev_stats = 1; }
+*   DeviceStepStats { string device = 1; repeated NodeExecStats node_stats = 2; }
+*   NodeExecStats   { string node_name = 1; int64 all_start_micros = 2;
+*                     int64 all_end_rel_micros = 5; string timeline_label = 8;
+*                     uint32 thread_id = 10; int64 all_start_nanos = 17;
+*                     int64 all_end_rel_nanos = 20; }
+**/
+/**************************************************************************{{{*/
+
+#pragma warning(disable : 4996)
+
+#include <algorithm>
+
+#include "signature_def.h"
+#include "step_stats.h"
+#include "nlohmann/json.hpp"
+using json = nlohmann::json;
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* add traced run
+* @par DESCRIPTION
+*   take the node executions of the serialized RunMetadata, the events of
+*   the runs older than TRACE_MAX_STEPS are dropped. 'op_type'
+*   maps the node name to its op type; the nodes unknown to it take the
+*   type from the timeline label "<node> = <OpType>(<inputs>)".
+*
+* @retval true  success
+* @retval false broken RunMetadata
+**/
+/**************************************************************************{{{*/
+bool
+StepTrace::add(const void* run_metadata, size_t size, std::function<std::string(const std::string&)> op_type)
+{
+    uint32_t field;
+    int wire_type;
+
+    ProtoReader metadata(run_metadata, size);
+    while (metadata.next(field, wire_type)) {
+        if (field != 1 || wire_type != ProtoReader::WIRE_BYTES) {
+            metadata.skip(wire_type);
+            continue;
+        }
+        ProtoReader step_stats = metadata.message();
+        while (step_stats.next(field, wire_type)) {
+            if (field != 1 || wire_type != ProtoReader::WIRE_BYTES) {
+                step_stats.skip(wire_type);
+                continue;
+            }
+
+            // DeviceStepStats: the device name may follow the nodes
+            ProtoReader dev_stats = step_stats.message();
+            std::string device;
+            std::vector<Event> events;
+            while (dev_stats.next(field, wire_type)) {
+                if (field == 1 && wire_type == ProtoReader::WIRE_BYTES) {
+                    device = dev_stats.string();
+                }
+                else if (field == 2 && wire_type == ProtoReader::WIRE_BYTES) {
+                    ProtoReader node = dev_stats.message();
+                    Event event{ mSteps, 0, 0, "", "", 0.0, 0.0 };
+                    int64_t start_us = 0, end_rel_us = 0, start_ns = 0, end_rel_ns = 0;
+                    std::string label;
+                    while (node.next(field, wire_type)) {
+                        switch (field) {
+                        case 1:  event.node = node.string(); break;
+                        case 2:  start_us   = node.varint(); break;
+                        case 5:  end_rel_us = node.varint(); break;
+                        case 8:  label      = node.string(); break;
+                        case 10: event.thread = node.varint(); break;
+                        case 17: start_ns   = node.varint(); break;
+                        case 20: end_rel_ns = node.varint(); break;
+                        default: node.skip(wire_type); break;
+                        }
+                    }
+                    if (node.error()) {
+                        return false;
+                    }
+
+                    // the nanos are newer and finer, when they are filled
+                    event.start    = start_ns ? start_ns/1000.0 : double(start_us);
+                    event.duration = start_ns ? end_rel_ns/1000.0 : double(end_rel_us);
+
+                    event.op_type = op_type(event.node);
+                    if (event.op_type.empty()) {
+                        size_t eq = label.find(" = ");
+                        size_t paren = label.find('(', eq);
+                        event.op_type = (eq != std::string::npos && paren != std::string::npos)
+                                      ? label.substr(eq + 3, paren - eq - 3) : event.node;
+                    }
+                    events.push_back(std::move(event));
+                }
+                else {
+                    dev_stats.skip(wire_type);
+                }
+            }
+            if (dev_stats.error()) {
+                return false;
+            }
+
+            size_t index = std::find(mDevices.begin(), mDevices.end(), device) - mDevices.begin();
+            if (index == mDevices.size()) {
+                mDevices.push_back(device);
+            }
+            for (auto& event : events) {
+                event.device = index;
+
+                Total& total = mTotals[event.op_type];
+                total.count++;
+                total.time += event.duration;
+                total.longest = std::max(total.longest, event.duration);
+
+                mEvents.push_back(std::move(event));
+            }
+        }
+        if (step_stats.error()) {
+            return false;
+        }
+    }
+    if (metadata.error()) {
+        return false;
+    }
+
+    mSteps++;
+
+    // the trace of a long run keeps its last steps only
+    while (!mEvents.empty() && mEvents.front().step < mSteps - TRACE_MAX_STEPS) {
+        mEvents.pop_front();
+    }
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* write Chrome trace
+* @par DESCRIPTION
+*   trace event format: a process per device and a thread per executor
+*   thread. the last TRACE_MAX_STEPS runs are laid out at their own times.
+*
+* @retval true  success
+* @retval false can't write
+**/
+/**************************************************************************{{{*/
+bool
+StepTrace::write_chrome_trace(const std::string& path) const
+{
+    FILE* fp = fopen(path.c_str(), "w");
+    if (fp == NULL) {
+        return false;
+    }
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (size_t i = 0; i < mDevices.size(); i++) {
+        json meta = { {"ph", "M"}, {"name", "process_name"}, {"pid", i}, {"args", {{"name", mDevices[i]}}} };
+        fprintf(fp, "%s,\n", meta.dump().c_str());
+    }
+    for (size_t i = 0; i < mEvents.size(); i++) {
+        const Event& event = mEvents[i];
+        json item = {
+            {"ph", "X"}, {"name", event.node}, {"cat", event.op_type},
+            {"pid", event.device}, {"tid", event.thread},
+            {"ts", event.start}, {"dur", event.duration},
+            {"args", {{"op", event.op_type}, {"step", event.step}}}
+        };
+        fprintf(fp, "%s%s\n", item.dump().c_str(), (i + 1 < mEvents.size()) ? "," : "");
+    }
+    fprintf(fp, "]}\n");
+
+    bool res = !ferror(fp);
+    fclose(fp);
+    return res;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* print op table
+* @par DESCRIPTION
+*   time per op type over all the traced runs, the most expensive first.
+*   the times are the sums of the node executions, so the parallel ops
+*   may add up to more than the wall time of a run. 'rows' 0 prints all.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+StepTrace::print_op_table(FILE* fp, size_t rows) const
+{
+    double all = 0.0;
+    for (const auto& item : mTotals) {
+        all += item.second.time;
+    }
+
+    std::vector<std::pair<std::string, Total>> sorted(mTotals.begin(), mTotals.end());
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second.time > b.second.time; });
+    if (rows > 0 && sorted.size() > rows) {
+        sorted.resize(rows);
+    }
+
+    int steps = std::max(mSteps, 1);
+    fprintf(fp, "op time over %d traced run(s):\n", mSteps);
+    fprintf(fp, "%-32s %8s %12s %12s %10s %7s\n", "op type", "calls", "ms/run", "mean_us", "max_us", "%");
+    for (const auto& item : sorted) {
+        const Total& total = item.second;
+        fprintf(fp, "%-32s %8.1f %12.3f %12.1f %10.1f %6.1f%%\n",
+            item.first.c_str(), double(total.count)/steps, total.time/1e3/steps,
+            total.time/total.count, total.longest, (all > 0.0) ? 100.0*total.time/all : 0.0);
+    }
+}
+
+/*** step_stats.cpp *******************************************************}}}*/
@@ -0,0 +1,75 @@
+/***  File Header  ************************************************************/
+/**
+* @file step_stats.h
+*
+* Per-op trace from the RunMetadata of the traced session runs
+* @author   Shozo Fukuda
+* @date     create Wed Aug 02 14:36:09 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+#ifndef _STEP_STATS_H
+#define _STEP_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <functional>
+
+/*--- CONSTANT ---*/
+#define TRACE_MAX_STEPS     64      // the last runs kept for the Chrome trace
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Step trace
+* @par DESCRIPTION
+*   collects the node executions of the StepStats in RunMetadata over
+*   the traced runs. exported as Chrome trace JSON (chrome://tracing,
+*   Perfetto) of the last TRACE_MAX_STEPS runs and as the table of the
+*   time per op type over all of them.
+**/
+/**************************************************************************{{{*/
+class StepTrace {
+//LIFECYCLE:
+public:
+    StepTrace() : mSteps(0) {}
+
+//ACTION:
+public:
+    bool add(const void* run_metadata, size_t size, std::function<std::string(const std::string&)> op_type);
+    bool write_chrome_trace(const std::string& path) const;
+    void print_op_table(FILE* fp, size_t rows = 0) const;
+
+//INQUIRY:
+public:
+    int steps() const { return mSteps; }
+    bool empty() const { return mEvents.empty(); }
+
+//ATTRIBUTE:
+private:
+    struct Event {
+        int         step;
+        int         device;     // index of mDevices
+        uint32_t    thread;
+        std::string node;
+        std::string op_type;
+        double      start;      // usec since epoch
+        double      duration;   // usec
+    };
+    struct Total {
+        uint64_t    count;
+        double      time;       // usec
+        double      longest;    // usec
+    };
+    std::vector<std::string>     mDevices;
+    std::deque<Event>            mEvents;   // of the last TRACE_MAX_STEPS runs
+    std::map<std::string, Total> mTotals;   // op type -> the executions of all runs
+    int                          mSteps;
+};
+
+#endif /* _STEP_STATS_H */
+/*** step_stats.h *********************************************************}}}*/
@@ -0,0 +1,189 @@
+/***  File Header  ************************************************************/
+/**
+* @file tensor_pool.cpp
+*
+* Pool of aligned buffers for the input tensors
+* @author   Shozo Fukuda
+* @date     create Tue Aug 15 10:21:47 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#include "tensor_pool.h"
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* aligned allocation
+* @par DESCRIPTION
+*
+*
+* @retval buffer
+* @retval nullptr  out of memory
+**/
+/**************************************************************************{{{*/
+static void*
+aligned_alloc_buffer(size_t size)
+{
+#ifdef _WIN32
+    return _aligned_malloc(size, TENSOR_POOL_ALIGN);
+#else
+    void* p = nullptr;
+    return (posix_memalign(&p, TENSOR_POOL_ALIGN, size) == 0) ? p : nullptr;
+#endif
+}
+
+static void
+aligned_free_buffer(void* p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* constructor
+* @par DESCRIPTION
+*   keep up to 'max_free' free buffers of each size.
+**/
+/**************************************************************************{{{*/
+TensorPool::TensorPool(size_t max_free)
+{
+    mArena = new Arena;
+    mArena->mMaxFree   = max_free;
+    mArena->mRefs      = 1;
+    mArena->mAllocated = 0;
+    mArena->mInUse     = 0;
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* destructor
+* @par DESCRIPTION
+*   the buffers of the tensors still alive are freed by their deallocator.
+**/
+/**************************************************************************{{{*/
+TensorPool::~TensorPool()
+{
+    mArena->unref();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* acquire tensor
+* @par DESCRIPTION
+*   a tensor of 'dtype' and 'shape' on a free buffer of the same size, or
+*   on a new one. the contents are undefined.
+*
+* @retval tensor
+* @retval nullptr  out of memory, or the tensor can't be created
+**/
+/**************************************************************************{{{*/
+TensorPtr
+TensorPool::acquire(TF_DataType dtype, const std::vector<int64_t>& shape)
+{
+    size_t len = TF_DataTypeSize(dtype);
+    for (const auto& dim : shape) {
+        len *= dim;
+    }
+    size_t capacity = (len + TENSOR_POOL_ALIGN - 1)/TENSOR_POOL_ALIGN*TENSOR_POOL_ALIGN;
+    if (capacity == 0) {
+        capacity = TENSOR_POOL_ALIGN;
+    }
+
+    void* data = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mArena->mMutex);
+        auto found = mArena->mFree.find(capacity);
+        if (found != mArena->mFree.end() && !found->second.empty()) {
+            data = found->second.back();
+            found->second.pop_back();
+        }
+    }
+    if (data == nullptr) {
+        data = aligned_alloc_buffer(capacity);
+        if (data == nullptr) {
+            return TensorPtr();
+        }
+        mArena->mAllocated += capacity;
+    }
+    mArena->mInUse += capacity;
+    mArena->mRefs++;
+
+    TF_Tensor* tensor = TF_NewTensor(dtype, shape.data(), shape.size(), data, len, release, mArena);
+    if (tensor == nullptr) {
+        // Tensorflow has called release() on the buffer already
+        return TensorPtr();
+    }
+    return TensorPtr(tensor);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* release buffer
+* @par DESCRIPTION
+*   deallocator of the tensors: back to the free list, or freed when the
+*   list is full.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+TensorPool::release(void* data, size_t len, void* arg)
+{
+    Arena* arena = reinterpret_cast<Arena*>(arg);
+    size_t capacity = (len + TENSOR_POOL_ALIGN - 1)/TENSOR_POOL_ALIGN*TENSOR_POOL_ALIGN;
+    if (capacity == 0) {
+        capacity = TENSOR_POOL_ALIGN;
+    }
+    arena->mInUse -= capacity;
+
+    bool kept = false;
+    {
+        std::lock_guard<std::mutex> lock(arena->mMutex);
+        std::vector<void*>& free_list = arena->mFree[capacity];
+        if (arena->mRefs > 1 && free_list.size() < arena->mMaxFree) {
+            free_list.push_back(data);
+            kept = true;
+        }
+    }
+    if (!kept) {
+        aligned_free_buffer(data);
+        arena->mAllocated -= capacity;
+    }
+
+    arena->unref();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* release reference
+* @par DESCRIPTION
+*   the last one frees the free buffers and the arena.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+TensorPool::Arena::unref()
+{
+    if (--mRefs > 0) {
+        return;
+    }
+    for (auto& free_list : mFree) {
+        for (void* p : free_list.second) {
+            aligned_free_buffer(p);
+        }
+    }
+    delete this;
+}
+
+/*** tensor_pool.cpp ******************************************************}}}*/
@@ -0,0 +1,76 @@
+/***  File Header  ************************************************************/
+/**
+* @file tensor_pool.h
+*
+* Pool of aligned buffers for the input tensors
+* @author   Shozo Fukuda
+* @date     create Tue Aug 15 10:21:47 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+#ifndef _TENSOR_POOL_H
+#define _TENSOR_POOL_H
+
+#include <stdint.h>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+
+#include "tf2_interp.h"
+
+/*--- CONSTANT ---*/
+#define TENSOR_POOL_ALIGN   64      // Tensorflow copies the buffers aligned less than this
+#define TENSOR_POOL_FREE    16      // free buffers kept per size
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Tensor pool
+* @par DESCRIPTION
+*   hands out TF_Tensors on recycled 64-byte aligned buffers. the buffer
+*   goes back to the pool by the deallocator of the tensor, when the
+*   tensor is deleted and Tensorflow has released it, so the producer can
+*   write the data in place and pass the tensor on without copying.
+*   acquire() and the release may run on any thread. the buffers are
+*   shared with the tensors alive, so the pool may be destroyed first.
+**/
+/**************************************************************************{{{*/
+class TensorPool {
+//LIFECYCLE:
+public:
+    explicit TensorPool(size_t max_free = TENSOR_POOL_FREE);
+    virtual ~TensorPool();
+
+    TensorPool(const TensorPool&) = delete;
+    TensorPool& operator=(const TensorPool&) = delete;
+
+//ACTION:
+public:
+    TensorPtr acquire(TF_DataType dtype, const std::vector<int64_t>& shape);
+
+//INQUIRY:
+public:
+    size_t allocated() const { return mArena->mAllocated; }
+    size_t in_use() const    { return mArena->mInUse; }
+
+private:
+    static void release(void* data, size_t len, void* arg);
+
+//ATTRIBUTE:
+private:
+    struct Arena {
+        std::mutex mMutex;
+        std::map<size_t, std::vector<void*>> mFree;   // free buffers by capacity
+        size_t     mMaxFree;
+        std::atomic<int>    mRefs;        // the pool and the tensors alive
+        std::atomic<size_t> mAllocated;   // bytes of the buffers, free or not
+        std::atomic<size_t> mInUse;       // bytes of the buffers in the tensors
+
+        void unref();
+    };
+    Arena* mArena;
+};
+
+#endif /* _TENSOR_POOL_H */
+/*** tensor_pool.h ********************************************************}}}*/
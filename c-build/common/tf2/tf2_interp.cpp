@@ -15,8 +15,12 @@
 /**************************************************************************{{{*/
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <memory.h>
+#include <algorithm>
+#include <chrono>
 #include "tensor_spec.h"
+#include "numa.h"
 #include "tf2_interp.h"
 
 
@@ -36,6 +40,109 @@ void init_interp(SysInfo& sys, std::string& model, std::string& inputs, std::str
 }
 #endif
 
+/***  Module Header  ******************************************************}}}*/
+/**
+* serialize ConfigProto
+* @par DESCRIPTION
+*   the fields of tensorflow/core/protobuf/config.proto we set:
+*     intra_op_parallelism_threads = 2, inter_op_parallelism_threads = 5,
+*     use_per_session_threads = 9
+*
+* @retval serialized ConfigProto, empty for the default
+**/
+/**************************************************************************{{{*/
+std::string
+Tf2Options::config_proto() const
+{
+    /*SUBROUTINE*/
+    auto put_varint = [](std::string& proto, int field, uint64_t value) {
+        proto.push_back(static_cast<char>(field << 3));     // wire type 0
+        do {
+            uint8_t byte = value & 0x7f;
+            value >>= 7;
+            proto.push_back(static_cast<char>(value ? (byte | 0x80) : byte));
+        } while (value);
+    };
+    /**/
+
+    std::string proto;
+    if (mIntraOpThreads > 0) {
+        put_varint(proto, 2, mIntraOpThreads);
+    }
+    if (mInterOpThreads > 0) {
+        put_varint(proto, 5, mInterOpThreads);
+    }
+    if (mPerSessionThreads || mNumaNode >= 0) {
+        // the global pools are created once and would ignore the binding
+        put_varint(proto, 9, 1);
+    }
+    return proto;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* read file
+* @par DESCRIPTION
+*   read the whole file 'path' into 'contents'.
+*
+* @retval true  success
+* @retval false can't read
+**/
+/**************************************************************************{{{*/
+static bool
+read_file(const std::string& path, std::string& contents)
+{
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    contents.clear();
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        contents.append(buf, n);
+    }
+    bool res = !ferror(fp);
+    fclose(fp);
+    return res;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* hash of saved model
+* @par DESCRIPTION
+*   64bit FNV-1a of saved_model.pb and variables/variables.index, in hex.
+*   the index holds the checksums of the variables, so the large data
+*   files need not be read. freeze_savedmodel.py names the frozen graph
+*   by the same hash.
+*
+* @retval hash, empty if there is no saved_model.pb
+**/
+/**************************************************************************{{{*/
+std::string
+saved_model_hash(const std::string& tf2_model)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    auto update = [&](const std::string& bytes) {
+        for (unsigned char c : bytes) {
+            hash = (hash ^ c) * 0x100000001b3ULL;
+        }
+    };
+
+    std::string contents;
+    if (!read_file(tf2_model + "/saved_model.pb", contents)) {
+        return "";
+    }
+    update(contents);
+    if (read_file(tf2_model + "/variables/variables.index", contents)) {
+        update(contents);
+    }
+
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+    return hex;
+}
+
 /***  Method Header  ******************************************************}}}*/
 /**
 * constructor
@@ -43,21 +150,9 @@ void init_interp(SysInfo& sys, std::string& model, std::string& inputs, std::str
 *   construct an instance.
 **/
 /**************************************************************************{{{*/
-Tf2Interp::Tf2Interp(std::string tf2_model, std::string inputs, std::string outputs)
+Tf2Interp::Tf2Interp(std::string tf2_model, std::string inputs, std::string outputs, const Tf2Options& options)
 {
-    mStatus  = TF_NewStatus();
-    mGraph   = TF_NewGraph();
-    mSession = nullptr;
-
-    // load saved model
-	const char* tags[] = { "serve" };
-	TF_SessionOptions* session_opts = TF_NewSessionOptions();
-    mSession = TF_LoadSessionFromSavedModel(session_opts, nullptr, tf2_model.c_str(), tags, 1, mGraph, nullptr, mStatus);
-	TF_DeleteSessionOptions(session_opts);
-    TF_Code res = TF_GetCode(mStatus);
-    if (res != TF_OK) {
-	    throw res;
-	}
+    load(tf2_model, options);
 
     // conversion table from TensorSpec::DTytpe to TF_DataType.
     const TF_DataType _dtype[] = {
@@ -70,37 +165,103 @@ Tf2Interp::Tf2Interp(std::string tf2_model, std::string inputs, std::string outp
         TF_INT32    // DTYPE_I32
     };
 
+    // the ops of the specs must be in the graph before anything is allocated
+    std::vector<TensorSpec*> input_spec  = parse_tensor_spec(inputs);
+    std::vector<TensorSpec*> output_spec = parse_tensor_spec(outputs);
+    for (const auto& specs : { input_spec, output_spec }) {
+        for (TensorSpec* spec : specs) {
+            if (TF_GraphOperationByName(mGraph, spec->mName.c_str()) == nullptr) {
+                fprintf(stderr, "Error: no tensor %s in the graph\n", spec->mName.c_str());
+                for (TensorSpec* p : input_spec) {
+                    delete p;
+                }
+                for (TensorSpec* p : output_spec) {
+                    delete p;
+                }
+                throw TF_NOT_FOUND;
+            }
+        }
+    }
+
+    mBind = &mBindings[""];
+    mBind->mBatchSize = 1;
+
 	// prepare input tensors
-    std::vector<TensorSpec*> input_spec = parse_tensor_spec(inputs);
-    mInputCount = input_spec.size();
-    mInputs.resize(mInputCount);
-    mInputTensors.resize(mInputCount);
-    for (int i = 0; i < mInputCount; i++) {
+    size_t input_count = input_spec.size();
+    mBind->mInputs.resize(input_count);
+    mBind->mInputTensors.resize(input_count);
+    mBind->mInputTypes.resize(input_count);
+    mBind->mInputShapes.resize(input_count);
+    for (int i = 0; i < input_count; i++) {
         TensorSpec* spec = input_spec[i];
-        mInputs[i].oper  = TF_GraphOperationByName(mGraph, spec->mName.c_str());
-        mInputs[i].index = i;
-        mInputTensors[i] = TF_AllocateTensor(_dtype[spec->mDType], spec->mShape.data(), spec->mShape.size(), spec->byte_size());
+        mBind->mInputs[i].oper  = TF_GraphOperationByName(mGraph, spec->mName.c_str());
+        mBind->mInputs[i].index = 0;
+        mBind->mInputTensors[i] = TF_AllocateTensor(_dtype[spec->mDType], spec->mShape.data(), spec->mShape.size(), spec->byte_size());
+        mBind->mInputTypes[i]   = _dtype[spec->mDType];
+        mBind->mInputShapes[i]  = spec->mShape;
+
+        // the leading dimension of the inputs is the batch size
+        if (i == 0 && !spec->mShape.empty()) {
+            mBind->mBatchSize = spec->mShape[0];
+        }
 
         delete spec;
     }
     input_spec.clear();
 
-	// prepare output tensors
-    std::vector<TensorSpec*> output_spec = parse_tensor_spec(outputs);
-    mOutputCount = output_spec.size();
-    mOutputs.resize(mOutputCount);
-    mOutputTensors.resize(mOutputCount);
-    for (int i = 0; i < mOutputCount; i++) {
+	// prepare output slots.
+    // TF_SessionRun allocates the output tensors by itself, so nothing is
+    // allocated here. the slots hold the results of the last invoke().
+    size_t output_count = output_spec.size();
+    mBind->mOutputs.resize(output_count);
+    mBind->mOutputTensors.assign(output_count, nullptr);
+    mBind->mOutputShapes.resize(output_count);
+    for (int i = 0; i < output_count; i++) {
         TensorSpec* spec = output_spec[i];
-        mOutputs[i].oper = TF_GraphOperationByName(mGraph, spec->mName.c_str());
-        mOutputs[i].index = i;
-        mOutputTensors[i] = TF_AllocateTensor(_dtype[spec->mDType], spec->mShape.data(), spec->mShape.size(), spec->byte_size());
+        mBind->mOutputs[i].oper = TF_GraphOperationByName(mGraph, spec->mName.c_str());
+        mBind->mOutputs[i].index = 0;
+        mBind->mOutputShapes[i] = graph_shape(mBind->mOutputs[i]);
 
         delete spec;
     }
     output_spec.clear();
 }
 
+/***  Method Header  ******************************************************}}}*/
+/**
+* constructor
+* @par DESCRIPTION
+*   construct an instance bound to the SignatureDefs of the SavedModel.
+*   the signatures missing in the model are ignored, and the first one
+*   found is selected. without 'signatures', all the signatures in the
+*   model are bound and serving_default is selected.
+**/
+/**************************************************************************{{{*/
+Tf2Interp::Tf2Interp(std::string tf2_model, const std::vector<std::string>& signatures, const Tf2Options& options)
+{
+    load(tf2_model, options);
+
+    std::vector<std::string> names = signatures;
+    if (names.empty()) {
+        names.push_back(SIGNATURE_SERVING_DEFAULT);
+        for (const auto& signature : mSignatures) {
+            if (signature.first != SIGNATURE_SERVING_DEFAULT) {
+                names.push_back(signature.first);
+            }
+        }
+    }
+
+    mBind = nullptr;
+    for (const auto& name : names) {
+        if (bind_signature(name) && mBind == nullptr) {
+            mBind = &mBindings[name];
+        }
+    }
+    if (mBind == nullptr) {
+        throw TF_NOT_FOUND;
+    }
+}
+
 /***  Method Header  ******************************************************}}}*/
 /**
 * destructor
@@ -111,18 +272,310 @@ Tf2Interp::Tf2Interp(std::string tf2_model, std::string inputs, std::string outp
 Tf2Interp::~Tf2Interp()
 {
     if (mSession) {
-        for (int i = 0; i < mInputCount; i++) {
-		    TF_DeleteTensor(mInputTensors[i]);
-	    }
-	    for (int i = 0; i < mOutputCount; i++) {
-		    TF_DeleteTensor(mOutputTensors[i]);
-	    }
+        for (auto& binding : mBindings) {
+            for (auto& tensor : binding.second.mInputTensors) {
+                TF_DeleteTensor(tensor);
+            }
+            for (auto& tensor : binding.second.mOutputTensors) {
+                if (tensor != nullptr) {
+                    TF_DeleteTensor(tensor);
+                }
+            }
+        }
         TF_DeleteSession(mSession, mStatus);
     }
 	TF_DeleteGraph(mGraph);
 	TF_DeleteStatus(mStatus);
 }
 
+/***  Module Header  ******************************************************}}}*/
+/**
+* load saved model
+* @par DESCRIPTION
+*   create the session and read the SignatureDefs from the MetaGraphDef.
+*   the op libraries are loaded first to register the custom ops of the
+*   graph; Tensorflow keeps them loaded for the process.
+*   with a NUMA node in the options, the calling thread is bound to the
+*   node before the session creates its thread pools, so that the pools
+*   and their memory stay on the node. the caller remains bound.
+*   the frozen graph of the model (freeze_savedmodel.py) is imported in
+*   place of the SavedModel when it matches the model hash: it has no
+*   variables to restore and its constants are folded, so it starts up
+*   much faster. the SavedModel is the fallback.
+*
+* @retval none (throw TF_Code on error)
+**/
+/**************************************************************************{{{*/
+void
+Tf2Interp::load(const std::string& tf2_model, const Tf2Options& options)
+{
+    mStatus  = TF_NewStatus();
+    mGraph   = TF_NewGraph();
+    mSession = nullptr;
+    mFrozen  = false;
+
+    mTraceEvery = 0;
+    mRuns       = 0;
+
+    // read by Tensorflow when the first kernel is created
+    if (options.mOneDnn >= 0) {
+#ifdef _WIN32
+        _putenv_s("TF_ENABLE_ONEDNN_OPTS", options.mOneDnn ? "1" : "0");
+#else
+        setenv("TF_ENABLE_ONEDNN_OPTS", options.mOneDnn ? "1" : "0", 1);
+#endif
+    }
+
+    for (const auto& path : options.mOpLibraries) {
+        // loading the same library again returns the loaded one
+        TF_Library* library = TF_LoadLibrary(path.c_str(), mStatus);
+        if (TF_GetCode(mStatus) != TF_OK) {
+            // not TF_NOT_FOUND, which means a model without signatures
+            fprintf(stderr, "Error: can't load op library %s: %s\n", path.c_str(), TF_Message(mStatus));
+            throw TF_INVALID_ARGUMENT;
+        }
+        (void)library;  // never released, the kernels stay registered
+    }
+
+    Tf2Options session = options;
+    if (session.mNumaNode >= 0) {
+        if (!numa_bind_thread(session.mNumaNode)) {
+            fprintf(stderr, "Warning: can't bind to NUMA node %d\n", session.mNumaNode);
+        }
+
+        // Tensorflow sizes the pools by all the CPUs of the machine
+        std::vector<int> cpus;
+        if (session.mIntraOpThreads <= 0 && numa_node_cpus(session.mNumaNode, cpus)) {
+            session.mIntraOpThreads = cpus.size();
+        }
+    }
+
+    // load saved model
+	const char* tags[] = { "serve" };
+	TF_SessionOptions* session_opts = TF_NewSessionOptions();
+    std::string config = session.config_proto();
+    if (!config.empty()) {
+        TF_SetConfig(session_opts, config.data(), config.size(), mStatus);
+        if (TF_GetCode(mStatus) != TF_OK) {
+            TF_DeleteSessionOptions(session_opts);
+            throw TF_GetCode(mStatus);
+        }
+    }
+    if (options.mFrozen) {
+        std::string hash = saved_model_hash(tf2_model);
+        if (!hash.empty() && load_frozen(tf2_model + "/frozen/" + hash + ".pb", session_opts)) {
+            TF_DeleteSessionOptions(session_opts);
+            if (TF_GetCode(mStatus) != TF_OK) {
+                throw TF_GetCode(mStatus);
+            }
+            return;
+        }
+    }
+
+    TF_Buffer* meta_graph_def = TF_NewBuffer();
+    mSession = TF_LoadSessionFromSavedModel(session_opts, nullptr, tf2_model.c_str(), tags, 1, mGraph, meta_graph_def, mStatus);
+	TF_DeleteSessionOptions(session_opts);
+    TF_Code res = TF_GetCode(mStatus);
+    if (res != TF_OK) {
+        TF_DeleteBuffer(meta_graph_def);
+	    throw res;
+	}
+
+    bool parsed = parse_signature_defs(meta_graph_def->data, meta_graph_def->length, mSignatures);
+    TF_DeleteBuffer(meta_graph_def);
+    if (!parsed) {
+        fprintf(stderr, "Error: broken MetaGraphDef, can't read the signatures of %s\n", tf2_model.c_str());
+        throw TF_INVALID_ARGUMENT;
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* load frozen graph
+* @par DESCRIPTION
+*   import the GraphDef of the frozen MetaGraphDef 'path' and create the
+*   session on it. the SignatureDefs are in the same MetaGraphDef.
+*
+* @retval true  imported, mStatus tells if the session is created
+* @retval false no such file, or it can't be imported
+**/
+/**************************************************************************{{{*/
+bool
+Tf2Interp::load_frozen(const std::string& path, TF_SessionOptions* session_opts)
+{
+    std::string meta_graph_def;
+    if (!read_file(path, meta_graph_def)) {
+        return false;
+    }
+
+    // MetaGraphDef { GraphDef graph_def = 2; map<string, SignatureDef> signature_def = 5; }
+    ProtoReader reader(meta_graph_def.data(), meta_graph_def.size());
+    const void* graph_def = nullptr;
+    size_t graph_def_size = 0;
+    uint32_t field;
+    int wire_type;
+    while (reader.next(field, wire_type)) {
+        if (field == 2 && wire_type == ProtoReader::WIRE_BYTES) {
+            ProtoReader graph = reader.message();
+            graph_def = graph.data();
+            graph_def_size = graph.size();
+        }
+        else {
+            reader.skip(wire_type);
+        }
+    }
+    if (reader.error() || graph_def == nullptr) {
+        fprintf(stderr, "Warning: broken frozen graph %s, loading the SavedModel\n", path.c_str());
+        return false;
+    }
+    if (!parse_signature_defs(meta_graph_def.data(), meta_graph_def.size(), mSignatures)) {
+        fprintf(stderr, "Warning: broken signatures in frozen graph %s, loading the SavedModel\n", path.c_str());
+        mSignatures.clear();
+        return false;
+    }
+
+    // the import is all or nothing, the graph stays empty on error
+    TF_Buffer* buffer = TF_NewBufferFromString(graph_def, graph_def_size);
+    TF_ImportGraphDefOptions* import_opts = TF_NewImportGraphDefOptions();
+    TF_GraphImportGraphDef(mGraph, buffer, import_opts, mStatus);
+    TF_DeleteImportGraphDefOptions(import_opts);
+    TF_DeleteBuffer(buffer);
+    if (TF_GetCode(mStatus) != TF_OK) {
+        fprintf(stderr, "Warning: can't import frozen graph %s: %s, loading the SavedModel\n", path.c_str(), TF_Message(mStatus));
+        return false;
+    }
+
+    mFrozen = true;
+
+    mSession = TF_NewSession(mGraph, session_opts, mStatus);
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* shape in graph
+* @par DESCRIPTION
+*   the shape inferred by the graph. -1 for unknown dimension.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+std::vector<int64_t>
+Tf2Interp::graph_shape(TF_Output op)
+{
+    int num_dims = TF_GraphGetTensorNumDims(mGraph, op, mStatus);
+    std::vector<int64_t> shape(num_dims > 0 ? num_dims : 0);
+    TF_GraphGetTensorShape(mGraph, op, shape.data(), shape.size(), mStatus);
+    return shape;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* bind signature
+* @par DESCRIPTION
+*   prepare the I/O of the SignatureDef 'name'. the op, the output index,
+*   the dtype and the shape come from the TensorInfo, and the graph fills
+*   in what is missing there. the input tensors are allocated with the
+*   unknown dimensions (batch) as 1, set_batch_size() resizes them.
+*
+* @retval true  success
+* @retval false no such signature, or a tensor is missing in the graph
+**/
+/**************************************************************************{{{*/
+bool
+Tf2Interp::bind_signature(const std::string& name)
+{
+    auto found = mSignatures.find(name);
+    if (found == mSignatures.end()) {
+        return false;
+    }
+    const Signature& signature = found->second;
+
+    /*SUBROUTINE*/
+    auto resolve = [&](const TensorInfo& info, TF_Output& op, std::vector<int64_t>& shape) {
+        std::string op_name;
+        split_tensor_name(info.mName, op_name, op.index);
+        op.oper = TF_GraphOperationByName(mGraph, op_name.c_str());
+        if (op.oper == nullptr || op.index >= TF_OperationNumOutputs(op.oper)) {
+            fprintf(stderr, "Error: signature %s: no tensor %s\n", name.c_str(), info.mName.c_str());
+            return false;
+        }
+        shape = info.mHasShape ? info.mShape : graph_shape(op);
+        return true;
+    };
+    /**/
+
+    Binding binding;
+    binding.mBatchSize = 1;
+
+    for (const auto& info : signature.mInputs) {
+        TF_Output op;
+        std::vector<int64_t> shape;
+        if (!resolve(info, op, shape)) {
+            for (auto& tensor : binding.mInputTensors) {
+                TF_DeleteTensor(tensor);
+            }
+            return false;
+        }
+
+        TF_DataType dtype = (info.mDType != 0) ? static_cast<TF_DataType>(info.mDType) : TF_OperationOutputType(op);
+        size_t size = TF_DataTypeSize(dtype);
+        for (auto& dim : shape) {
+            if (dim < 0) {
+                dim = 1;
+            }
+            size *= dim;
+        }
+
+        binding.mInputs.push_back(op);
+        binding.mInputTensors.push_back(TF_AllocateTensor(dtype, shape.data(), shape.size(), size));
+        binding.mInputTypes.push_back(dtype);
+        binding.mInputShapes.push_back(shape);
+    }
+    if (!binding.mInputShapes.empty() && !binding.mInputShapes[0].empty()) {
+        binding.mBatchSize = binding.mInputShapes[0][0];
+    }
+
+    for (const auto& info : signature.mOutputs) {
+        TF_Output op;
+        std::vector<int64_t> shape;
+        if (!resolve(info, op, shape)) {
+            for (auto& tensor : binding.mInputTensors) {
+                TF_DeleteTensor(tensor);
+            }
+            return false;
+        }
+        binding.mOutputs.push_back(op);
+        binding.mOutputShapes.push_back(shape);
+    }
+    binding.mOutputTensors.assign(binding.mOutputs.size(), nullptr);
+
+    mBindings[name] = binding;
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* select binding
+* @par DESCRIPTION
+*   switch the I/O to the signature 'name'. the tensors of the other
+*   bindings are kept, so switching back and forth costs nothing.
+*
+* @retval true  success
+* @retval false no such binding
+**/
+/**************************************************************************{{{*/
+bool
+Tf2Interp::select(const std::string& signature)
+{
+    auto found = mBindings.find(signature);
+    if (found == mBindings.end()) {
+        return false;
+    }
+    mBind = &found->second;
+    return true;
+}
+
 /***  Module Header  ******************************************************}}}*/
 /**
 * query dimension of input tensor
@@ -166,10 +619,10 @@ Tf2Interp::info(json& res)
     int     num_dims;
     int64_t shape[10];
 
-    for (int index = 0; index < mInputCount; index++) {
+    for (int index = 0; index < mBind->mInputs.size(); index++) {
         json tf2_tensor;
-        TF_Output& op = mInputs[index];
-        TF_Tensor* t = mInputTensors[index];
+        TF_Output& op = mBind->mInputs[index];
+        TF_Tensor* t = mBind->mInputTensors[index];
 
         tf2_tensor["index"] = index;
         tf2_tensor["name"] = TF_OperationName(op.oper);
@@ -192,15 +645,14 @@ Tf2Interp::info(json& res)
         res["inputs"].push_back(tf2_tensor);
     }
 
-    for (int index = 0; index < mOutputCount; index++) {
+    for (int index = 0; index < mBind->mOutputs.size(); index++) {
         json tf2_tensor;
-        TF_Output& op = mOutputs[index];
-        TF_Tensor* t = mOutputTensors[index];
+        TF_Output& op = mBind->mOutputs[index];
 
         tf2_tensor["index"] = index;
         tf2_tensor["name"] = TF_OperationName(op.oper);
 
-        tf2_tensor["type"] = _dtype[TF_TensorType(t)];
+        tf2_tensor["type"] = _dtype[TF_OperationOutputType(op)];
 
         num_dims = TF_GraphGetTensorNumDims(mGraph, op, mStatus);
         if (num_dims > 10) { num_dims = 10; }
@@ -219,6 +671,47 @@ Tf2Interp::info(json& res)
     }
 }
 
+/***  Module Header  ******************************************************}}}*/
+/**
+* change batch size
+* @par DESCRIPTION
+*   re-allocate the input tensors with the new leading (batch) dimension.
+*   the session is kept as it is, so the model is not reloaded.
+*
+* @retval batch size
+* @retval -1  invalid batch size
+**/
+/**************************************************************************{{{*/
+int
+Tf2Interp::set_batch_size(int batch)
+{
+    if (batch <= 0) {
+        return -1;
+    }
+    if (batch == mBind->mBatchSize) {
+        return batch;
+    }
+
+    for (int i = 0; i < mBind->mInputs.size(); i++) {
+        std::vector<int64_t>& shape = mBind->mInputShapes[i];
+        if (shape.empty()) {
+            continue;
+        }
+        shape[0] = batch;
+
+        size_t size = TF_DataTypeSize(mBind->mInputTypes[i]);
+        for (const auto& dim : shape) {
+            size *= dim;
+        }
+
+        TF_DeleteTensor(mBind->mInputTensors[i]);
+        mBind->mInputTensors[i] = TF_AllocateTensor(mBind->mInputTypes[i], shape.data(), shape.size(), size);
+    }
+    mBind->mBatchSize = batch;
+
+    return batch;
+}
+
 /***  Module Header  ******************************************************}}}*/
 /**
 * set input tensor
@@ -231,8 +724,8 @@ Tf2Interp::info(json& res)
 int
 Tf2Interp::set_input_tensor(unsigned int index, const uint8_t* data, int size)
 {
-    if (size == TF_TensorByteSize(mInputTensors[index])) {
-        memcpy(TF_TensorData(mInputTensors[index]), data, size);
+    if (size == TF_TensorByteSize(mBind->mInputTensors[index])) {
+        memcpy(TF_TensorData(mBind->mInputTensors[index]), data, size);
         return size;
     }
     else {
@@ -252,7 +745,7 @@ Tf2Interp::set_input_tensor(unsigned int index, const uint8_t* data, int size)
 int
 Tf2Interp::set_input_tensor(unsigned int index, const uint8_t* data, int size, std::function<float(uint8_t)> conv)
 {
-    float* dst = reinterpret_cast<float*>(TF_TensorData(mInputTensors[index]));
+    float* dst = reinterpret_cast<float*>(TF_TensorData(mBind->mInputTensors[index]));
     const uint8_t* src = data;
     for (int i = 0; i < size; i++) {
         *dst++ = conv(*src++);
@@ -261,20 +754,94 @@ Tf2Interp::set_input_tensor(unsigned int index, const uint8_t* data, int size, s
     return size;
 }
 
+/***  Module Header  ******************************************************}}}*/
+/**
+* set input tensor
+* @par DESCRIPTION
+*   take over 'tensor' as the input, e.g. from a TensorPool, instead of
+*   copying its data. the dtype and the dimensions but the leading one
+*   must match the input; the batch size follows the tensor.
+*
+* @retval batch size
+* @retval -2  the tensor doesn't match the input
+**/
+/**************************************************************************{{{*/
+int
+Tf2Interp::set_input_tensor(unsigned int index, TensorPtr tensor)
+{
+    std::vector<int64_t>& shape = mBind->mInputShapes[index];
+    if (!tensor || TF_TensorType(tensor.get()) != mBind->mInputTypes[index]) {
+        return -2;
+    }
+    if (!shape.empty()) {
+        if (TF_NumDims(tensor.get()) != shape.size()) {
+            return -2;
+        }
+        for (int i = 1; i < shape.size(); i++) {
+            if (shape[i] >= 0 && TF_Dim(tensor.get(), i) != shape[i]) {
+                return -2;
+            }
+        }
+        shape[0] = TF_Dim(tensor.get(), 0);
+        mBind->mBatchSize = shape[0];
+    }
+
+    TF_DeleteTensor(mBind->mInputTensors[index]);
+    mBind->mInputTensors[index] = tensor.release();
+
+    return mBind->mBatchSize;
+}
+
 /***  Module Header  ******************************************************}}}*/
 /**
 * execute inference
 * @par DESCRIPTION
 *
 *
-* @retval
+* @retval true  success
+* @retval false the session failed, no output tensors
 **/
 /**************************************************************************{{{*/
 bool
 Tf2Interp::invoke()
 {
-    TF_SessionRun(mSession, nullptr, mInputs.data(), mInputTensors.data(), mInputCount, mOutputs.data(), mOutputTensors.data(), mOutputCount, nullptr, 0, nullptr, mStatus);
-    return true;
+    // the results of the previous run are not needed any more
+    release_output_tensors();
+
+    // RunOptions { trace_level: FULL_TRACE } on the sampled runs
+    TF_Buffer* run_options  = nullptr;
+    TF_Buffer* run_metadata = nullptr;
+    mRuns++;
+    if (mTraceEvery > 0 && (mRuns % mTraceEvery) == 0) {
+        static const uint8_t FULL_TRACE[] = { 0x08, 0x03 };
+        run_options  = TF_NewBufferFromString(FULL_TRACE, sizeof(FULL_TRACE));
+        run_metadata = TF_NewBuffer();
+    }
+
+    TF_SessionRun(mSession, run_options,
+        mBind->mInputs.data(), mBind->mInputTensors.data(), mBind->mInputs.size(),
+        mBind->mOutputs.data(), mBind->mOutputTensors.data(), mBind->mOutputs.size(),
+        nullptr, 0, run_metadata, mStatus);
+    bool res = (TF_GetCode(mStatus) == TF_OK);
+    if (!res) {
+        fprintf(stderr, "Error: session run: %s\n", TF_Message(mStatus));
+        release_output_tensors();
+    }
+
+    if (run_metadata != nullptr) {
+        if (res) {
+            auto op_type = [this](const std::string& node) -> std::string {
+                TF_Operation* oper = TF_GraphOperationByName(mGraph, node.c_str());
+                return (oper != nullptr) ? TF_OperationOpType(oper) : "";
+            };
+            if (!mTrace->add(run_metadata->data, run_metadata->length, op_type)) {
+                fprintf(stderr, "Warning: broken RunMetadata, the run is not traced\n");
+            }
+        }
+        TF_DeleteBuffer(run_metadata);
+        TF_DeleteBuffer(run_options);
+    }
+    return res;
 }
 
 /***  Module Header  ******************************************************}}}*/
@@ -289,7 +856,206 @@ Tf2Interp::invoke()
 std::string
 Tf2Interp::get_output_tensor(unsigned int index)
 {
-    return std::string(reinterpret_cast<char*>(TF_TensorData(mOutputTensors[index])), TF_TensorByteSize(mOutputTensors[index]));
+    TF_Tensor* tensor = mBind->mOutputTensors[index];
+    return std::string(reinterpret_cast<char*>(TF_TensorData(tensor)), TF_TensorByteSize(tensor));
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* get view on result tensor
+* @par DESCRIPTION
+*   read the result tensor in place without copying.
+*   the view is valid until the next invoke().
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+TensorView
+Tf2Interp::output_view(unsigned int index)
+{
+    return TensorView(mBind->mOutputTensors[index]);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* take result tensor
+* @par DESCRIPTION
+*   hand over the ownership of the result tensor to the caller.
+*   the buffer is released when the returned pointer is destroyed.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+TensorPtr
+Tf2Interp::take_output_tensor(unsigned int index)
+{
+    TF_Tensor* tensor = mBind->mOutputTensors[index];
+    mBind->mOutputTensors[index] = nullptr;
+    return TensorPtr(tensor);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* release result tensors
+* @par DESCRIPTION
+*   delete the result tensors of the current binding still owned by the
+*   interpreter.
+*   the tensors taken by take_output_tensor() are not touched.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+void
+Tf2Interp::release_output_tensors()
+{
+    for (auto& tensor : mBind->mOutputTensors) {
+        if (tensor != nullptr) {
+            TF_DeleteTensor(tensor);
+            tensor = nullptr;
+        }
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* output tensor name
+* @par DESCRIPTION
+*   the op name of the 'index'-th output of the 'signature'.
+*
+* @retval op name
+* @retval ""  no such signature or output
+**/
+/**************************************************************************{{{*/
+std::string
+Tf2Interp::output_name(const std::string& signature, unsigned int index) const
+{
+    auto found = mBindings.find(signature);
+    if (found == mBindings.end() || index >= found->second.mOutputs.size()) {
+        return std::string();
+    }
+    return TF_OperationName(found->second.mOutputs[index].oper);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* fetch tensor
+* @par DESCRIPTION
+*   evaluate the tensor 'name' ("op_name:index") without feeding anything,
+*   e.g. to read a variable of the model. the bindings are not touched.
+*
+* @retval tensor
+* @retval nullptr  no such tensor or error
+**/
+/**************************************************************************{{{*/
+TensorPtr
+Tf2Interp::fetch(const std::string& tensor_name)
+{
+    std::string op_name;
+    TF_Output op;
+    split_tensor_name(tensor_name, op_name, op.index);
+    op.oper = TF_GraphOperationByName(mGraph, op_name.c_str());
+    if (op.oper == nullptr) {
+        return TensorPtr();
+    }
+
+    TF_Tensor* tensor = nullptr;
+    TF_SessionRun(mSession, nullptr, nullptr, nullptr, 0, &op, &tensor, 1, nullptr, 0, nullptr, mStatus);
+    if (TF_GetCode(mStatus) != TF_OK) {
+        return TensorPtr();
+    }
+    return TensorPtr(tensor);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* set tracing
+* @par DESCRIPTION
+*   trace the 'every'-th, 2*'every'-th, ... invoke() from now on with
+*   FULL_TRACE, so the first run with the one-time setup is traced only
+*   for 'every' 1. the step stats are collected in trace(). 0 stops
+*   tracing and keeps the collected ones.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+Tf2Interp::set_trace(int every)
+{
+    mTraceEvery = std::max(every, 0);
+    mRuns       = 0;
+    if (mTraceEvery > 0 && !mTrace) {
+        mTrace.reset(new StepTrace());
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* warm up session
+* @par DESCRIPTION
+*   run the bindings 'signatures' (all of them for none) once per batch
+*   size of 'batch_sizes' on zero inputs, so the kernel selection, the
+*   oneDNN primitives and the memory pools for those shapes are done
+*   before the first real run. the runs are not traced. the current
+*   binding is selected again with its batch size, but its input tensors
+*   are re-allocated.
+*
+* @retval elapsed msec
+* @retval -1  a run failed
+**/
+/**************************************************************************{{{*/
+double
+Tf2Interp::warmup(const std::vector<int>& batch_sizes, const std::vector<std::string>& signatures)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<Binding*> binds;
+    if (signatures.empty()) {
+        for (auto& binding : mBindings) {
+            binds.push_back(&binding.second);
+        }
+    }
+    else {
+        for (const auto& name : signatures) {
+            auto found = mBindings.find(name);
+            if (found != mBindings.end()) {
+                binds.push_back(&found->second);
+            }
+        }
+    }
+
+    Binding* current     = mBind;
+    int      trace_every = mTraceEvery;
+    uint64_t runs        = mRuns;
+    mTraceEvery = 0;
+
+    bool res = true;
+    for (Binding* bind : binds) {
+        mBind = bind;
+        int batch = mBind->mBatchSize;
+        for (int size : batch_sizes) {
+            if (set_batch_size(size) < 0) {
+                continue;
+            }
+            for (TF_Tensor* tensor : mBind->mInputTensors) {
+                memset(TF_TensorData(tensor), 0, TF_TensorByteSize(tensor));
+            }
+            res = invoke();
+            release_output_tensors();
+            if (!res) {
+                break;
+            }
+        }
+        set_batch_size(batch);
+        if (!res) {
+            break;
+        }
+    }
+
+    mBind       = current;
+    mTraceEvery = trace_every;
+    mRuns       = runs;
+
+    return res ? std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() : -1.0;
 }
 
 /*** tf2_interp.cpp ******************************************************}}}*/
@@ -16,20 +16,107 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <memory>
+#include <map>
 
 #include "tensorflow/c/c_api.h"
+#include "signature_def.h"
+#include "step_stats.h"
 #include "nlohmann/json.hpp"
 using json = nlohmann::json;
 
 /*--- CONSTANT ---*/
 
 /*--- TYPE ---*/
+struct TensorDeleter {
+    void operator()(TF_Tensor* tensor) const { TF_DeleteTensor(tensor); }
+};
+typedef std::unique_ptr<TF_Tensor, TensorDeleter> TensorPtr;
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Tensor view
+* @par DESCRIPTION
+*   read-only view on the buffer of a TF_Tensor. it does not own the tensor,
+*   so it is valid only while the tensor is alive.
+*
+**/
+/**************************************************************************{{{*/
+class TensorView {
+//LIFECYCLE:
+public:
+    TensorView() : mTensor(nullptr) {}
+    explicit TensorView(const TF_Tensor* tensor) : mTensor(tensor) {}
+
+//ACCESSOR:
+public:
+    template <typename T>
+    const T* data() const { return reinterpret_cast<const T*>(TF_TensorData(mTensor)); }
+
+    template <typename T>
+    const T* data(int64_t batch_index) const {
+        return data<T>() + batch_index*(count()/dim(0));
+    }
+
+//INQUIRY:
+public:
+    bool    empty() const     { return mTensor == nullptr; }
+    size_t  byte_size() const { return TF_TensorByteSize(mTensor); }
+    int     num_dims() const  { return TF_NumDims(mTensor); }
+    int64_t dim(int index) const { return TF_Dim(mTensor, index); }
+    size_t  count() const {
+        size_t n = 1;
+        for (int i = 0; i < num_dims(); i++) {
+            n *= dim(i);
+        }
+        return n;
+    }
+
+//ATTRIBUTE:
+private:
+    const TF_Tensor* mTensor;
+};
+
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Session options
+* @par DESCRIPTION
+*   thread pools and placement of the session. 0 or -1 leaves the choice
+*   to Tensorflow.
+**/
+/**************************************************************************{{{*/
+struct Tf2Options {
+//LIFECYCLE:
+    Tf2Options()
+        : mIntraOpThreads(0), mInterOpThreads(0), mPerSessionThreads(false), mOneDnn(-1), mNumaNode(-1), mFrozen(true) {}
+
+//INQUIRY:
+    std::string config_proto() const;
+
+//ATTRIBUTE:
+    int  mIntraOpThreads;       // threads to run an op in parallel
+    int  mInterOpThreads;       // ops to run in parallel
+    bool mPerSessionThreads;    // own thread pools instead of the process-wide ones
+    int  mOneDnn;               // oneDNN optimizations: 0 off, 1 on, -1 default
+    int  mNumaNode;             // bind the session to the node, -1 no binding
+    std::vector<std::string> mOpLibraries;  // custom op plugins used by the graph
+    bool mFrozen;               // load <model>/frozen/<hash>.pb when there is one
+};
+
+std::string saved_model_hash(const std::string& tf2_model);
 
 /***  Class Header  *******************************************************}}}*/
 /**
 * Tensorflow2 Interpreter
 * @par DESCRIPTION
 *   Tiny ML Interpreter on Libtensorflow
+*   the interpreter holds one or more I/O bindings on the same session:
+*   the tensors given by the spec strings, or the SignatureDefs of the
+*   SavedModel. the SignatureDefs give the op names, the output indices,
+*   the dtypes and the shapes, so the model needs no spec strings.
+*   set_input_tensor(), invoke() and the output accessors work on the
+*   binding chosen by select().
 *
 **/
 /**************************************************************************{{{*/
@@ -41,22 +128,52 @@ public:
 
 //LIFECYCLE:
 public:
-  Tf2Interp(std::string tf2_model, std::string inputs, std::string outputs);
+  Tf2Interp(std::string tf2_model, std::string inputs, std::string outputs, const Tf2Options& options = Tf2Options());
+  explicit Tf2Interp(std::string tf2_model, const std::vector<std::string>& signatures = {}, const Tf2Options& options = Tf2Options());
   virtual ~Tf2Interp();
 
 //ACTION:
 public:
+    bool select(const std::string& signature);
     void info(json& res);
+    int set_batch_size(int batch);
     int set_input_tensor(unsigned int index, const uint8_t* data, int size);
     int set_input_tensor(unsigned int index, const uint8_t* data, int size, std::function<float(uint8_t)> conv);
+    int set_input_tensor(unsigned int index, TensorPtr tensor);
     bool invoke();
     std::string get_output_tensor(unsigned int index);
+    TensorView output_view(unsigned int index);
+    TensorPtr take_output_tensor(unsigned int index);
+    void release_output_tensors();
+    TensorPtr fetch(const std::string& tensor_name);
+    void set_trace(int every);
+    double warmup(const std::vector<int>& batch_sizes, const std::vector<std::string>& signatures = {});
 
 //ACCESSOR:
 public:
 
 //INQUIRY:
 public:
+    int batch_size() const { return mBind->mBatchSize; }
+    bool has_signature(const std::string& name) const { return mBindings.count(name) != 0; }
+    std::vector<std::string> signatures() const {
+        std::vector<std::string> names;
+        for (const auto& binding : mBindings) {
+            names.push_back(binding.first);
+        }
+        return names;
+    }
+    const std::vector<int64_t>& input_shape(unsigned int index) const { return mBind->mInputShapes[index]; }
+    const std::vector<int64_t>& output_shape(unsigned int index) const { return mBind->mOutputShapes[index]; }
+    std::string output_name(const std::string& signature, unsigned int index) const;
+    const StepTrace* trace() const { return mTrace.get(); }
+    bool frozen() const { return mFrozen; }
+
+private:
+    void load(const std::string& tf2_model, const Tf2Options& options);
+    bool load_frozen(const std::string& path, TF_SessionOptions* session_opts);
+    bool bind_signature(const std::string& name);
+    std::vector<int64_t> graph_shape(TF_Output op);
 
 //ATTRIBUTE:
 private:
@@ -64,13 +181,28 @@ private:
     TF_Graph*    mGraph;
     TF_Session*  mSession;
 
-    size_t mInputCount;
-    std::vector<TF_Output>  mInputs;
-    std::vector<TF_Tensor*> mInputTensors;
+    SignatureMap mSignatures;
+    bool         mFrozen;   // the graph is the frozen one, not the SavedModel
+
+    struct Binding {
+        int mBatchSize;
+
+        std::vector<TF_Output>  mInputs;
+        std::vector<TF_Tensor*> mInputTensors;
+        std::vector<TF_DataType>          mInputTypes;
+        std::vector<std::vector<int64_t>> mInputShapes;
+
+        std::vector<TF_Output>  mOutputs;
+        std::vector<TF_Tensor*> mOutputTensors;
+        std::vector<std::vector<int64_t>> mOutputShapes;    // -1 for unknown dimension
+    };
+    std::map<std::string, Binding> mBindings;
+    Binding* mBind;     // current binding
 
-    size_t mOutputCount;
-    std::vector<TF_Output>  mOutputs;
-    std::vector<TF_Tensor*> mOutputTensors;
+    // tracing of the session runs
+    int      mTraceEvery;   // trace every n-th run, 0 for no tracing
+    uint64_t mRuns;
+    std::unique_ptr<StepTrace> mTrace;
 };
 
 /*INLINE METHOD:
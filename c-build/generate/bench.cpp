@@ -0,0 +1,481 @@
+/***  File Header  ************************************************************/
+/**
+* @file bench.cpp
+*
+* Benchmark of the generate pipeline with per-stage timing.
+* @author   Shozo Fukuda
+* @date     create Mon Jul 31 10:22:47 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+
+#pragma warning(disable : 4996)
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include "image_conv.h"
+#include "latent_sampler.h"
+#include "bench.h"
+
+typedef std::chrono::steady_clock Clock;
+
+/*--- elapsed time in usec ---*/
+static inline double usec_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* peak resident set size
+* @par DESCRIPTION
+*   high-water mark of the process memory in bytes.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+static uint64_t
+peak_rss()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return uint64_t(usage.ru_maxrss)*1024;     // KB on Linux
+#endif
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* current resident set size
+* @par DESCRIPTION
+*   the process memory in bytes now, which falls back as the memory is
+*   freed unlike the peak.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+static uint64_t
+current_rss()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return counters.WorkingSetSize;
+#else
+    unsigned long long size, resident;
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (fp == nullptr) {
+        return 0;
+    }
+    int n = fscanf(fp, "%llu %llu", &size, &resident);
+    fclose(fp);
+    return (n == 2) ? uint64_t(resident)*sysconf(_SC_PAGESIZE) : 0;
+#endif
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* total time
+* @par DESCRIPTION
+*
+*
+* @retval usec
+**/
+/**************************************************************************{{{*/
+double
+BenchStage::total() const
+{
+    double sum = 0.0;
+    for (double usec : mSamples) {
+        sum += usec;
+    }
+    return sum;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* percentile
+* @par DESCRIPTION
+*   nearest-rank percentile, 'p' in [0, 100].
+*
+* @retval usec
+**/
+/**************************************************************************{{{*/
+double
+BenchStage::percentile(double p) const
+{
+    if (mSamples.empty()) {
+        return 0.0;
+    }
+    std::vector<double> sorted(mSamples);
+    size_t rank = std::min(sorted.size() - 1, size_t(ceil(p/100.0*sorted.size())) - (p > 0.0 ? 1 : 0));
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* stage report
+* @par DESCRIPTION
+*   the bucket "le_us": 2^k counts the samples in (2^(k-1), 2^k] usec.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+json
+BenchStage::report() const
+{
+    json res;
+    res["unit"]    = mUnit;
+    res["count"]   = mSamples.size();
+    res["mean_us"] = mSamples.empty() ? 0.0 : total()/mSamples.size();
+    res["p50_us"]  = percentile(50);
+    res["p90_us"]  = percentile(90);
+    res["p99_us"]  = percentile(99);
+    res["max_us"]  = percentile(100);
+
+    std::vector<uint64_t> buckets;
+    for (double usec : mSamples) {
+        size_t k = (usec <= 1.0) ? 0 : size_t(ceil(log2(usec)));
+        if (k >= buckets.size()) {
+            buckets.resize(k + 1, 0);
+        }
+        buckets[k]++;
+    }
+    res["histogram"] = json::array();
+    for (size_t k = 0; k < buckets.size(); k++) {
+        if (buckets[k] != 0) {
+            res["histogram"].push_back({ {"le_us", uint64_t(1) << k}, {"count", buckets[k]} });
+        }
+    }
+    return res;
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* constructor
+* @par DESCRIPTION
+*   construct an instance.
+**/
+/**************************************************************************{{{*/
+Bench::Bench(Tf2Interp& interp, const BenchOptions& options)
+    : mInterp(interp), mOptions(options), mImages(0)
+{
+    mStages.emplace_back("sampling",    "batch");
+    mStages.emplace_back("input_copy",  "batch");
+    mStages.emplace_back("session_run", "batch");
+    mStages.emplace_back("output_copy", "batch");
+    mStages.emplace_back("conversion",  "image");
+    mStages.emplace_back("encode",      "image");
+    mStages.emplace_back("write",       "image");
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* run benchmark
+* @par DESCRIPTION
+*   warm up, then time the iterations and report.
+*
+* @retval exit status
+**/
+/**************************************************************************{{{*/
+int
+Bench::run(const Seeds& seeds, int batch, const ImageFormat& format, OutputSink* sink)
+{
+    if (mInterp.has_signature(SIGNATURE_SERVING_DEFAULT)) {
+        mInterp.select(SIGNATURE_SERVING_DEFAULT);
+    }
+
+    const std::vector<int64_t>& shape = mInterp.input_shape(0);
+    size_t latent_size = 1;
+    for (size_t i = 1; i < shape.size(); i++) {
+        latent_size *= shape[i];
+    }
+
+    size_t next = 0;
+    try {
+        // the first runs pay for the graph optimization and the allocations
+        for (int i = 0; i < mOptions.mWarmup; i++) {
+            iterate(seeds, next, batch, format, sink, false);
+        }
+
+        // the samples are allocated up front not to be taken for a leak
+        for (auto& stage : mStages) {
+            stage.reserve(size_t(mOptions.mIterations)*batch);
+        }
+        uint64_t rss_start = current_rss();
+
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < mOptions.mIterations; i++) {
+            iterate(seeds, next, batch, format, sink, true);
+        }
+        double elapsed = usec_since(start)/1e6;
+        double rss_growth = double(int64_t(current_rss() - rss_start));
+
+        json report;
+        report["config"]     = mOptions.mConfig;
+        report["host"]       = host();
+        report["warmup"]     = mOptions.mWarmup;
+        report["iterations"] = mOptions.mIterations;
+        report["batch"]      = batch;
+        report["images"]     = mImages;
+        report["elapsed_s"]  = elapsed;
+        report["images_per_s"] = (elapsed > 0.0) ? mImages/elapsed : 0.0;
+        report["peak_rss_bytes"] = peak_rss();
+        report["rss_growth_bytes"] = rss_growth;
+        report["samplers"] = samplers(latent_size);
+        for (const auto& stage : mStages) {
+            report["stages"][stage.name()] = stage.report();
+        }
+
+        // summary
+        fprintf(stderr, "%-12s %-6s %8s %10s %10s %10s %10s\n", "stage", "unit", "count", "mean_ms", "p50_ms", "p99_ms", "max_ms");
+        for (const auto& stage : mStages) {
+            const json& res = report["stages"][stage.name()];
+            fprintf(stderr, "%-12s %-6s %8zu %10.3f %10.3f %10.3f %10.3f\n",
+                stage.name().c_str(), res["unit"].get<std::string>().c_str(), stage.count(),
+                res["mean_us"].get<double>()/1e3, res["p50_us"].get<double>()/1e3,
+                res["p99_us"].get<double>()/1e3, res["max_us"].get<double>()/1e3);
+        }
+        for (const auto& item : report["samplers"].items()) {
+            fprintf(stderr, "rng %-8s %10.3f us/latent %10.1f Mvalues/s\n",
+                item.key().c_str(), item.value()["us_per_latent"].get<double>(), item.value()["mvalues_per_s"].get<double>());
+        }
+        fprintf(stderr, "throughput: %.2f images/s (%llu images in %.3f s), peak RSS: %.1f MB\n",
+            report["images_per_s"].get<double>(), (unsigned long long)mImages, elapsed, peak_rss()/1048576.0);
+        fprintf(stderr, "RSS growth: %.2f MB over %d batches\n", rss_growth/1048576.0, mOptions.mIterations);
+
+        if (mOptions.mReport.empty()) {
+            std::cout << report.dump(2) << std::endl;
+        }
+        else {
+            std::ofstream out(mOptions.mReport);
+            out << report.dump(2) << std::endl;
+            if (!out) {
+                std::cerr << "Error: can't write report: " << mOptions.mReport << std::endl;
+                return 1;
+            }
+        }
+
+        if (mOptions.mMaxRssGrowth >= 0.0 && rss_growth > mOptions.mMaxRssGrowth*1048576.0) {
+            fprintf(stderr, "Error: the RSS grew by %.2f MB, over the limit of %.2f MB.\n", rss_growth/1048576.0, mOptions.mMaxRssGrowth);
+            return 1;
+        }
+    }
+    catch (...) {
+        std::cerr << "Error: benchmark failed." << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* one batch through the pipeline
+* @par DESCRIPTION
+*   the stage times are recorded on the timed iterations.
+*
+* @retval none (throw TF_Code on error)
+**/
+/**************************************************************************{{{*/
+void
+Bench::iterate(const Seeds& seeds, size_t& next, int batch, const ImageFormat& format, OutputSink* sink, bool timed)
+{
+    /*SUBROUTINE*/
+    auto record = [&](int stage, Clock::time_point start) {
+        if (timed) {
+            mStages[stage].add(usec_since(start));
+        }
+    };
+    /**/
+
+    if (batch != mInterp.batch_size()) {
+        mInterp.set_batch_size(batch);
+    }
+    const std::vector<int64_t>& shape = mInterp.input_shape(0);
+    size_t latent_size = 1;
+    for (size_t i = 1; i < shape.size(); i++) {
+        latent_size *= shape[i];
+    }
+
+    // the latents are written in place of the input tensor, as the pipeline does
+    Clock::time_point start = Clock::now();
+    std::vector<int64_t> latent_shape = shape;
+    latent_shape[0] = batch;
+    TensorPtr input = mPool.acquire(TF_FLOAT, latent_shape);
+    if (!input) {
+        throw TF_RESOURCE_EXHAUSTED;
+    }
+    float* latents = reinterpret_cast<float*>(TF_TensorData(input.get()));
+    std::vector<int> index(batch);
+    for (int k = 0; k < batch; k++) {
+        index[k] = next;
+        mOptions.mSampler(seeds[next % seeds.size()], &latents[k*latent_size], latent_size);
+        next++;
+    }
+    record(SAMPLING, start);
+
+    start = Clock::now();
+    if (mInterp.set_input_tensor(0, std::move(input)) < 0) {
+        throw TF_INVALID_ARGUMENT;
+    }
+    record(INPUT_COPY, start);
+
+    start = Clock::now();
+    if (!mInterp.invoke()) {
+        throw TF_INTERNAL;
+    }
+    record(SESSION_RUN, start);
+
+    // the output is handed over without copying, as the pipeline does
+    start = Clock::now();
+    std::shared_ptr<TF_Tensor> images = mInterp.take_output_tensor(0);
+    if (!images) {
+        throw TF_INTERNAL;
+    }
+    record(OUTPUT_COPY, start);
+
+    TensorView view(images.get());
+    int height = view.dim(2);
+    int width  = view.dim(3);
+    std::vector<uint8_t> rgb(size_t(3)*height*width);
+    std::vector<uint8_t> encoded;
+    for (int k = 0; k < batch; k++) {
+        start = Clock::now();
+        nchw_to_hwc_u8(view.data<float>(k), rgb.data(), 3, height, width);
+        record(CONVERSION, start);
+
+        start = Clock::now();
+        format.encode(rgb.data(), height, width, encoded);
+        record(ENCODE, start);
+
+        if (sink != nullptr) {
+            char name[64];
+            snprintf(name, sizeof(name), "bench_%06d%s", index[k], format.ext());
+            start = Clock::now();
+            if (!sink->write(name, encoded.data(), encoded.size())) {
+                fprintf(stderr, "Error: can't write %s\n", name);
+            }
+            record(WRITE, start);
+        }
+    }
+
+    if (timed) {
+        mImages += batch;
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* host description
+* @par DESCRIPTION
+*   CPU and build, to tell the reports of the machines and builds apart.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+json
+Bench::host() const
+{
+    json res;
+    res["hardware_threads"] = std::thread::hardware_concurrency();
+
+    std::string cpu;
+#ifdef _WIN32
+    const char* id = getenv("PROCESSOR_IDENTIFIER");
+    cpu = (id != NULL) ? id : "";
+#else
+    FILE* fp = fopen("/proc/cpuinfo", "r");
+    if (fp != NULL) {
+        char line[256];
+        while (fgets(line, sizeof(line), fp) != NULL) {
+            if (strncmp(line, "model name", 10) == 0) {
+                const char* value = strchr(line, ':');
+                cpu = (value != NULL) ? value + 2 : "";
+                cpu.erase(cpu.find_last_not_of("\r\n") + 1);
+                break;
+            }
+        }
+        fclose(fp);
+    }
+#endif
+    res["cpu"] = cpu;
+
+#if defined(_MSC_VER)
+    res["compiler"] = "msvc " + std::to_string(_MSC_VER);
+#elif defined(__VERSION__)
+    res["compiler"] = __VERSION__;
+#endif
+    res["built"] = __DATE__ " " __TIME__;
+    res["tensorflow"] = TF_Version();
+
+    time_t now = time(NULL);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    res["date"] = stamp;
+    return res;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* sampler benchmark
+* @par DESCRIPTION
+*   time of each latent sampler (--rng) for latents of 'latent_size' on
+*   one thread, uniform is the per-element loop of the former versions.
+*
+* @retval json
+**/
+/**************************************************************************{{{*/
+json
+Bench::samplers(size_t latent_size) const
+{
+    const int latents = 2000;
+    std::vector<float> z(latent_size);
+
+    json res;
+    for (const char* name : {"uniform", "numpy", "philox"}) {
+        LatentSampler sampler = latent_sampler(name);
+        sampler(0, z.data(), z.size());     // warm up
+
+        Clock::time_point start = Clock::now();
+        for (int seed = 0; seed < latents; seed++) {
+            sampler(uint32_t(seed), z.data(), z.size());
+        }
+        double usec = usec_since(start);
+
+        res[name]["us_per_latent"] = usec/latents;
+        res[name]["mvalues_per_s"] = (usec > 0.0) ? double(latents)*latent_size/usec : 0.0;
+    }
+    return res;
+}
+
+/*** bench.cpp ************************************************************}}}*/
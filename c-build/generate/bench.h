@@ -0,0 +1,117 @@
+/***  File Header  ************************************************************/
+/**
+* @file bench.h
+*
+* Benchmark of the generate pipeline with per-stage timing.
+* @author   Shozo Fukuda
+* @date     create Mon Jul 31 10:22:47 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "tf2/tf2_interp.h"
+#include "tf2/tensor_pool.h"
+#include "seeds.h"
+#include "image_writer.h"
+#include "output_sink.h"
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Stage timing
+* @par DESCRIPTION
+*   latency samples of a pipeline stage, summarized as the percentiles and
+*   a log2 histogram in microseconds.
+**/
+/**************************************************************************{{{*/
+class BenchStage {
+//LIFECYCLE:
+public:
+    BenchStage(const char* name, const char* unit) : mName(name), mUnit(unit) {}
+
+//ACTION:
+public:
+    void add(double usec) { mSamples.push_back(usec); }
+    void reserve(size_t count) { mSamples.reserve(count); }
+    json report() const;
+
+//INQUIRY:
+public:
+    const std::string& name() const { return mName; }
+    size_t count() const { return mSamples.size(); }
+    double total() const;
+    double percentile(double p) const;
+
+//ATTRIBUTE:
+private:
+    std::string mName;
+    std::string mUnit;      // "batch" or "image"
+    std::vector<double> mSamples;   // usec
+};
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Bench options
+* @par DESCRIPTION
+*
+**/
+/**************************************************************************{{{*/
+struct BenchOptions {
+    BenchOptions() : mIterations(0), mWarmup(3), mMaxRssGrowth(-1.0) {}
+
+    int         mIterations;    // timed batches, 0 for no benchmark
+    int         mWarmup;        // batches run before the timing
+    double      mMaxRssGrowth;  // MB the RSS may grow over the timed batches, < 0 for no check
+    std::string mReport;        // JSON report file, empty for stdout
+    json        mConfig;        // run configuration copied into the report
+    std::function<void(int, float*, size_t)> mSampler;   // seed -> latent of the size
+};
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Pipeline benchmark
+* @par DESCRIPTION
+*   runs the stages of the generate pipeline one after another on the
+*   calling thread, so that each stage is timed alone:
+*     sampling, input copy, session run, output copy    per batch
+*     conversion, encode, write                         per image
+*   the seeds are used round robin. the images are written only when a
+*   sink is given. the latent samplers are timed alone, too. the summary goes to stderr and the JSON report to the
+*   file or stdout. the growth of the RSS over the timed batches is
+*   reported, and checked against a limit as a soak test of the leaks.
+**/
+/**************************************************************************{{{*/
+class Bench {
+//LIFECYCLE:
+public:
+    Bench(Tf2Interp& interp, const BenchOptions& options);
+
+//ACTION:
+public:
+    int run(const Seeds& seeds, int batch, const ImageFormat& format, OutputSink* sink);
+
+private:
+    void iterate(const Seeds& seeds, size_t& next, int batch, const ImageFormat& format, OutputSink* sink, bool timed);
+    json host() const;
+    json samplers(size_t latent_size) const;
+
+//ATTRIBUTE:
+private:
+    Tf2Interp&   mInterp;
+    BenchOptions mOptions;
+    TensorPool   mPool;         // the input tensors, as the pipeline has
+
+    enum { SAMPLING = 0, INPUT_COPY, SESSION_RUN, OUTPUT_COPY, CONVERSION, ENCODE, WRITE };
+    std::vector<BenchStage> mStages;
+    uint64_t mImages;       // images of the timed batches
+};
+
+#endif /* _BENCH_H */
+/*** bench.h **************************************************************}}}*/
@@ -0,0 +1,127 @@
+/***  File Header  ************************************************************/
+/**
+* @file dlatent_cache.cpp
+*
+* Cache of the mapping network results (W, dlatents) per seed.
+* @author   Shozo Fukuda
+* @date     create Wed Jul 19 10:12:37 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+
+#pragma warning(disable : 4996)
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dlatent_cache.h"
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* constructor
+* @par DESCRIPTION
+*   create the cache directory if it is given.
+**/
+/**************************************************************************{{{*/
+DlatentCache::DlatentCache(size_t dlatent_size, const fs::path& dir, size_t capacity)
+    : mDlatentSize(dlatent_size), mDir(dir), mCapacity(capacity > 0 ? capacity : 1)
+{
+    if (!mDir.empty() && !fs::exists(mDir)) {
+        fs::create_directories(mDir);
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* cache file
+* @par DESCRIPTION
+*
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+fs::path
+DlatentCache::path(int seed) const
+{
+    return mDir / ("w_" + std::to_string(seed) + ".bin");
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* find W
+* @par DESCRIPTION
+*   copy the cached W of 'seed' to 'dlatent'. the cache file of the wrong
+*   size (other model) is ignored.
+*
+* @retval true  hit
+* @retval false miss
+**/
+/**************************************************************************{{{*/
+bool
+DlatentCache::find(int seed, float* dlatent)
+{
+    auto found = mIndex.find(seed);
+    if (found != mIndex.end()) {
+        mEntries.splice(mEntries.begin(), mEntries, found->second);
+        memcpy(dlatent, found->second->second.data(), mDlatentSize*sizeof(float));
+        return true;
+    }
+
+    if (mDir.empty()) {
+        return false;
+    }
+
+    FILE* fp = fopen(path(seed).string().c_str(), "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    size_t n = fread(dlatent, sizeof(float), mDlatentSize, fp);
+    bool eof = (fgetc(fp) == EOF);
+    fclose(fp);
+    if (n != mDlatentSize || !eof) {
+        return false;
+    }
+
+    insert(seed, dlatent);
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* insert W
+* @par DESCRIPTION
+*   cache the W of 'seed'. the least recently used one is dropped from the
+*   memory when the cache is full.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+DlatentCache::insert(int seed, const float* dlatent)
+{
+    auto found = mIndex.find(seed);
+    if (found != mIndex.end()) {
+        mEntries.splice(mEntries.begin(), mEntries, found->second);
+        return;
+    }
+
+    if (!mDir.empty() && !fs::exists(path(seed))) {
+        FILE* fp = fopen(path(seed).string().c_str(), "wb");
+        if (fp != NULL) {
+            bool res = fwrite(dlatent, sizeof(float), mDlatentSize, fp) == mDlatentSize;
+            if (fclose(fp) != 0 || !res) {
+                fs::remove(path(seed));     // don't leave a broken cache file
+            }
+        }
+    }
+
+    if (mEntries.size() >= mCapacity) {
+        mIndex.erase(mEntries.back().first);
+        mEntries.pop_back();
+    }
+    mEntries.emplace_front(seed, std::vector<float>(dlatent, dlatent + mDlatentSize));
+    mIndex[seed] = mEntries.begin();
+}
+
+/*** dlatent_cache.cpp ****************************************************}}}*/
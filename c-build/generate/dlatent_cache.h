@@ -0,0 +1,65 @@
+/***  File Header  ************************************************************/
+/**
+* @file dlatent_cache.h
+*
+* Cache of the mapping network results (W, dlatents) per seed.
+* @author   Shozo Fukuda
+* @date     create Wed Jul 19 10:12:37 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+#ifndef _DLATENT_CACHE_H
+#define _DLATENT_CACHE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+/*--- CONSTANT ---*/
+#define DLATENT_CACHE_ENTRIES   1024    // W vectors kept in memory
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Dlatent cache
+* @par DESCRIPTION
+*   keeps the W of the recently used seeds in memory (LRU). when a cache
+*   directory is given, W is also stored to "<dir>/w_<seed>.bin" so that
+*   the later runs on the same seeds skip the mapping network.
+*   it is used by the inference thread only.
+**/
+/**************************************************************************{{{*/
+class DlatentCache {
+//LIFECYCLE:
+public:
+    DlatentCache(size_t dlatent_size, const fs::path& dir = fs::path(), size_t capacity = DLATENT_CACHE_ENTRIES);
+
+//ACTION:
+public:
+    bool find(int seed, float* dlatent);
+    void insert(int seed, const float* dlatent);
+
+//INQUIRY:
+public:
+    size_t dlatent_size() const { return mDlatentSize; }
+
+private:
+    fs::path path(int seed) const;
+
+//ATTRIBUTE:
+private:
+    size_t   mDlatentSize;      // number of floats in a W: layers x components
+    fs::path mDir;
+    size_t   mCapacity;
+
+    typedef std::pair<int, std::vector<float>> Entry;
+    std::list<Entry> mEntries;  // the most recently used first
+    std::unordered_map<int, std::list<Entry>::iterator> mIndex;
+};
+
+#endif /* _DLATENT_CACHE_H */
+/*** dlatent_cache.h ******************************************************}}}*/
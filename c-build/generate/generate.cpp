@@ -17,91 +17,164 @@
 #include <filesystem>
 namespace fs = std::filesystem;
 #include <string>
+#include <string.h>
+#include <limits.h>
 #include <vector>
-#include <random>
 #include <memory>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
 
 #include "getopt/getopt.h"
 #include "tf2/tf2_interp.h"
+#include "tf2/tensor_pool.h"
+#include "npy_file.h"
+#include "numa.h"
+#include "latent_sampler.h"
+#include "bounded_queue.h"
+#include "image_writer.h"
+#include "dlatent_cache.h"
+#include "server.h"
+#include "bench.h"
+#include "seeds.h"
+#include "wspace.h"
+#include "stylemix.h"
+#include "interpolate.h"
 
-#define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
 
-#include "CImgEx.h"
-using namespace cimg_library;
+#define MAX_LATANT	512
 
+#define QUEUE_DEPTH		2	// batches in flight between sampling and inference
 
-typedef std::vector<int> Seeds;
+/* long options without short form */
+enum {
+	OPT_INTRA_THREADS = 0x100,
+	OPT_INTER_THREADS,
+	OPT_NUMA_NODE,
+	OPT_ONEDNN,
+	OPT_SERVE,
+	OPT_MAX_WAIT,
+	OPT_BENCH,
+	OPT_WARMUP,
+	OPT_REPORT,
+	OPT_MAX_RSS_GROWTH,
+	OPT_TRACE,
+	OPT_TRACE_EVERY,
+	OPT_OP_LIBRARY,
+	OPT_NO_FROZEN,
+	OPT_WARMUP_BATCHES,
+	OPT_RNG,
+	OPT_TRUNC,
+	OPT_TRUNC_CUTOFF,
+	OPT_ROWS,
+	OPT_COLS,
+	OPT_STYLES,
+	OPT_INTERP,
+	OPT_SLERP,
+	OPT_LOOP,
+};
 
-#define MAX_LATANT	512
-typedef std::vector<std::unique_ptr<float>> LatantIn;
+/* latents of one batch: sampling stage -> inference stage */
+struct LatantBatch {
+	uint64_t           seq;		// position of the first image in the output
+	std::vector<int>   index;	// image indices of the batch
+	TensorPtr          data;	// [index.size(), MAX_LATANT] on the input pool
+};
 
 /***  Module Header  ******************************************************}}}*/
 /**
-* <title>
+* open model
 * @par DESCRIPTION
-*   <description>
+*   load the model with its signatures. the I/O and the resolution come
+*   from the signatures, the model exported without them is driven by the
+*   tensor names.
+*
+* @retval interpreter (throw TF_Code on error)
 **/
 /**************************************************************************{{{*/
-Seeds parse_seeds(const std::string& str)
+Tf2Interp*
+open_model(const fs::path& model, const Tf2Options& options)
 {
-	Seeds seeds;
-
-	if (str.empty()) {
-		return seeds;
+	try {
+		return new Tf2Interp(model.string(), {}, options);
 	}
-
-	size_t pos = std::string::size_type(0);
-	do {
-		std::string chunk;
-
-		// split to chunk
-		size_t end = str.find(',', pos);
-		if (end != std::string::npos) {
-			chunk = str.substr(pos, end - pos);
-			pos = end + 1;
-		}
-		else {
-			chunk = str.substr(pos);
-			pos = std::string::npos;
-		}
-
-		// translate seeds
-		size_t dash = chunk.find('-');
-		if (dash != std::string::npos) {
-			// range seeds
-			int beg = std::stoi(chunk.substr(0, dash));
-			int end = std::stoi(chunk.substr(dash + 1));
-			for (int i = beg; i <= end; i++) {
-				seeds.push_back(i);
-			}
-		}
-		else {
-			// single seed
-			seeds.push_back(std::stoi(chunk));
+	catch (TF_Code res) {
+		if (res != TF_NOT_FOUND) {
+			throw;
 		}
-	} while (pos != std::string::npos);
-
-	return seeds;
+		return new Tf2Interp(model.string(), "Gs/latents_in,f32,1,512", "Gs/images_out", options);
+	}
 }
 
-LatantIn latants_from_seeds(std::string str)
+/***  Module Header  ******************************************************}}}*/
+/**
+* warm up model
+* @par DESCRIPTION
+*   run the signatures which generate uses on dummy batches of 'sizes'
+*   before the first image, and print the time it took.
+*
+* @retval elapsed msec
+* @retval -1  failed
+**/
+/**************************************************************************{{{*/
+double
+warmup_model(Tf2Interp& interp, const std::vector<int>& sizes, bool dlatents, int shard = 0)
 {
-	LatantIn latants;
-
-	std::uniform_real_distribution<float> dist(0.0, 1.0);
+	std::vector<std::string> signatures;
+	if (interp.has_signature("mapping") && interp.has_signature("synthesis")) {
+		signatures.push_back("synthesis");
+		if (!dlatents) {
+			signatures.push_back("mapping");
+		}
+	}
 
-	for (auto seed : parse_seeds(str)) {
-		std::mt19937 engine(seed);
+	double elapsed = interp.warmup(sizes, signatures);
 
-		float* latant = new float[MAX_LATANT];
-		for (int i = 0; i < MAX_LATANT; i++) {
-			latant[i] = dist(engine);
+	std::ostringstream msg;
+	if (elapsed < 0) {
+		msg << "Error: warmup failed";
+	}
+	else {
+		msg << "warmup: " << std::fixed << std::setprecision(1) << elapsed << " ms, batch";
+		for (size_t i = 0; i < sizes.size(); i++) {
+			msg << (i == 0 ? " " : ",") << sizes[i];
 		}
-		latants.emplace_back(latant);
 	}
+	if (shard > 0) {
+		msg << " (shard " << shard << ")";
+	}
+	msg << "\n";
+	std::cerr << msg.str() << std::flush;	// one write, the shards warm up at once
+	return elapsed;
+}
 
-	return latants;
+/***  Module Header  ******************************************************}}}*/
+/**
+* save trace
+* @par DESCRIPTION
+*   write the traced runs of the session as Chrome trace JSON to 'path',
+*   and print the time per op type.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+save_trace(const Tf2Interp& interp, const std::string& path)
+{
+	const StepTrace* trace = interp.trace();
+	if (trace == nullptr || trace->empty()) {
+		std::cerr << "Warning: no run was traced." << std::endl;
+		return;
+	}
+	if (!trace->write_chrome_trace(path)) {
+		std::cerr << "Error: can't write trace: " << path << std::endl;
+	}
+	trace->print_op_table(stderr, 40);
 }
 
 /***  Module Header  ******************************************************}}}*/
@@ -129,40 +202,28 @@ model_card(Tf2Interp& interp)
 	};
 	/**/
 
-	json res;
-	interp.info(res);
-
-	std::cout << "inputs:" << std::endl << "{" << std::endl;
-	for (auto& item : res["inputs"]) {
-		print_tensor_spec(item);
-	}
-	std::cout << "}" << std::endl;
-
-	std::cout << "outputs:" << std::endl << "{" << std::endl;
-	for (auto& item : res["outputs"]) {
-		print_tensor_spec(item);
-	}
-	std::cout << "}" << std::endl;
-}
+	std::cout << "graph: " << (interp.frozen() ? "frozen" : "SavedModel") << std::endl;
+	for (const auto& name : interp.signatures()) {
+		if (!name.empty()) {
+			std::cout << "signature: " << name << std::endl;
+		}
+		interp.select(name);
 
-/***  Module Header  ******************************************************}}}*/
-/**
-* save result image
-* @par DESCRIPTION
-*   convert the result tensor to the image and save it.
-**/
-/**************************************************************************{{{*/
-void
-save_to_image(const std::string& bin, const fs::path& outdir, const char* format, int n)
-{
-	char basename[32];
-	sprintf(basename, format, n);
-	fs::path fname = outdir / basename;
+		json res;
+		interp.info(res);
 
-	int hw = sqrt(bin.size() / 4 / 3);
-	CImg<uint8_t> img = 255*(CImg<float>((float*)bin.data(), hw, hw, 1, 3) + 1.0)/2.0;
+		std::cout << "inputs:" << std::endl << "{" << std::endl;
+		for (auto& item : res["inputs"]) {
+			print_tensor_spec(item);
+		}
+		std::cout << "}" << std::endl;
 
-	img.save(fname.string().c_str());
+		std::cout << "outputs:" << std::endl << "{" << std::endl;
+		for (auto& item : res["outputs"]) {
+			print_tensor_spec(item);
+		}
+		std::cout << "}" << std::endl;
+	}
 }
 
 /***  Module Header  ******************************************************}}}*/
@@ -176,11 +237,53 @@ void
 usage()
 {
     std::cout
-    << "generate [opts] <model> [<outdir>]\n"
+    << "generate [opts] <model> [<output>]\n"
+    << "\toutput:\n"
+    << "\t  <dir>      : one file per image (default: ./out)\n"
+    << "\t  <path>.tar : tar archive\n"
+    << "\t  <path>.pack: packed file with index <path>.pack.idx\n"
+    << "\t  -          : standard output\n"
     << "\toption:\n"
     << "\t  -s <seeds> : random seeds - \"f4,1,3,224,224\"\n"
-	<< "\t  -d <path>  : dlatants file\n"
+	<< "\t  -d <path>  : dlatents file - .npy or .npz (np.savez) of [N,18,512] float32\n"
+	<< "\t  -b <n>     : batch size - number of latents per inference (default: 1)\n"
+	<< "\t  -k <n>     : shards - sessions running in parallel (default: 1)\n"
 	<< "\t  -p         : print model card\n"
+	<< "\t  -j <n>     : image encoding threads (default: 2)\n"
+	<< "\t  -f <fmt>   : image format - jpg, png, ppm, raw (default: jpg)\n"
+	<< "\t  -q <n>     : JPEG quality 1..100 (default: 100)\n"
+	<< "\t  -z <n>     : PNG compression level 0..9 (default: 8)\n"
+	<< "\t  -r         : resume - skip the images already in <output>\n"
+	<< "\t  -w <dir>   : keep W of the seeds in <dir>/<model hash>/<rng> to skip the mapping network next time\n"
+	<< "\t  --rng <name>        : latents of the seeds - numpy: np.random.RandomState(seed).randn as generate.py,\n"
+	<< "\t                        philox: counter-based, faster, uniform: the former versions (default: numpy)\n"
+	<< "\t  --trunc <psi>       : truncation toward the average W, a list - \"0.3,0.5,0.7\" - renders each seed with each psi\n"
+	<< "\t                        from one mapping run, the file names get \"_psi<psi>\" (default: 0.5 as generate.py on\n"
+	<< "\t                        the seeds, none on the dlatents)\n"
+	<< "\t  --trunc-cutoff <n>  : truncate the first <n> layers only (default: all)\n"
+	<< "\t  --rows <seeds>      : style mixing grid of style_mixing.py, seeds of the rows, with --cols, -> <output>/grid\n"
+	<< "\t  --cols <seeds>      : style mixing grid, seeds of the columns\n"
+	<< "\t  --styles <layers>   : style mixing grid, layers taken from the column seeds (default: 0-6)\n"
+	<< "\t  --interp <n>        : latent walk through the seeds or the dlatents as keyframes, <n> frames between\n"
+	<< "\t                        two of them, written as frame%06d in order (-f raw to - pipes RGB to ffmpeg)\n"
+	<< "\t  --slerp             : interpolation: slerp the latents Z of the seeds instead of lerp W\n"
+	<< "\t  --loop              : interpolation: walk back to the first keyframe\n"
+	<< "\t  --intra-threads <n> : threads to run an op in parallel (default: all CPUs)\n"
+	<< "\t  --inter-threads <n> : ops to run in parallel (default: all CPUs)\n"
+	<< "\t  --numa-node <n>     : run the session and its memory on NUMA node <n>\n"
+	<< "\t  --onednn <on|off>   : oneDNN optimizations of Tensorflow\n"
+	<< "\t  --op-library <path> : load the custom op plugin, repeatable (default: <model>/ops/*.so|*.dll)\n"
+	<< "\t  --no-frozen         : load the SavedModel even if freeze_savedmodel.py made its frozen graph\n"
+	<< "\t  --warmup-batches <sizes> : run dummy batches of the sizes - \"1,8\" - before the first image\n"
+	<< "\t  --serve <endpoint>  : run as server on [<host>:]<port> or unix:<path>, no <output>\n"
+	<< "\t                        GET /generate?seed=<n>[&psi=<f>][&cutoff=<n>][&format=<fmt>], POST /generate (W), GET /stats\n"
+	<< "\t  --max-wait <ms>     : server: wait for more requests to batch up to -b (default: 5)\n"
+	<< "\t  --bench <n>         : benchmark <n> batches of the seeds (default: 0-63), <output> is optional\n"
+	<< "\t  --warmup <n>        : bench: batches run before the timing (default: 3)\n"
+	<< "\t  --report <path>     : bench: JSON report file (default: standard output)\n"
+	<< "\t  --max-rss-growth <mb> : bench: fail if the RSS grows more over the timed batches, a soak test of the leaks\n"
+	<< "\t  --trace <path>      : trace the session runs to Chrome trace JSON <path>, print time per op type\n"
+	<< "\t  --trace-every <n>   : trace every <n>-th run (default: 10), the first session with -k\n"
     ;
 }
 
@@ -199,19 +302,74 @@ main(int argc, char* argv[])
 	int opt;
 	const struct option longopts[] = {
 	    {"seeds",     required_argument, NULL, 's'},
+		{"dlatents",  required_argument, NULL, 'd'},
+		{"batch",     required_argument, NULL, 'b'},
+		{"shards",    required_argument, NULL, 'k'},
 		{"print",     no_argument,       NULL, 'p'},
+		{"jobs",      required_argument, NULL, 'j'},
+		{"format",    required_argument, NULL, 'f'},
+		{"quality",   required_argument, NULL, 'q'},
+		{"png-level", required_argument, NULL, 'z'},
+		{"resume",    no_argument,       NULL, 'r'},
+		{"wcache",    required_argument, NULL, 'w'},
+		{"intra-threads", required_argument, NULL, OPT_INTRA_THREADS},
+		{"inter-threads", required_argument, NULL, OPT_INTER_THREADS},
+		{"numa-node",     required_argument, NULL, OPT_NUMA_NODE},
+		{"onednn",        required_argument, NULL, OPT_ONEDNN},
+		{"op-library",    required_argument, NULL, OPT_OP_LIBRARY},
+		{"no-frozen",     no_argument,       NULL, OPT_NO_FROZEN},
+		{"warmup-batches", required_argument, NULL, OPT_WARMUP_BATCHES},
+		{"rng",           required_argument, NULL, OPT_RNG},
+		{"trunc",         required_argument, NULL, OPT_TRUNC},
+		{"trunc-cutoff",  required_argument, NULL, OPT_TRUNC_CUTOFF},
+		{"rows",          required_argument, NULL, OPT_ROWS},
+		{"cols",          required_argument, NULL, OPT_COLS},
+		{"styles",        required_argument, NULL, OPT_STYLES},
+		{"interp",        required_argument, NULL, OPT_INTERP},
+		{"slerp",         no_argument,       NULL, OPT_SLERP},
+		{"loop",          no_argument,       NULL, OPT_LOOP},
+		{"serve",         required_argument, NULL, OPT_SERVE},
+		{"max-wait",      required_argument, NULL, OPT_MAX_WAIT},
+		{"bench",         required_argument, NULL, OPT_BENCH},
+		{"warmup",        required_argument, NULL, OPT_WARMUP},
+		{"report",        required_argument, NULL, OPT_REPORT},
+		{"max-rss-growth", required_argument, NULL, OPT_MAX_RSS_GROWTH},
+		{"trace",         required_argument, NULL, OPT_TRACE},
+		{"trace-every",   required_argument, NULL, OPT_TRACE_EVERY},
 		{0,0,0,0}
 	};
 
 	fs::path model;
-	fs::path outdir;
+	std::string output;
 
 	std::string seeds;
+	std::string dlatents_path;
+	int batch = 1;
+	int shards = 1;
+
+	int jobs = 2;
+	ImageFormat format;
 
 	bool do_inspect = false;
+	bool resume = false;
+	fs::path wcache_dir;
+	Tf2Options session;
+	ServerOptions server;
+	BenchOptions bench;
+	std::string trace_path;
+	int trace_every = 10;
+	std::vector<int> warmup_batches;
+	std::string rng = "numpy";
+	LatentSampler rng_sampler = randn_numpy;
+	std::vector<float> psi_list;		// empty: no truncation
+	int trunc_cutoff = 0;
+	StyleMixOptions stylemix;
+	stylemix.mStyles = parse_seeds("0-6").to_vector();
+	InterpOptions interpolate;
+	interpolate.mFrames = 0;		// 0: no interpolation
 
 	for (;;) {
-		opt = getopt_long(argc, argv, "s:p", longopts, NULL);
+		opt = getopt_long(argc, argv, "s:d:b:k:pj:f:q:z:rw:", longopts, NULL);
 		if (opt == -1) {
 			break;
 		}
@@ -219,9 +377,147 @@ main(int argc, char* argv[])
 		case 's':
 			seeds = optarg;
 		    break;
+		case 'd':
+			dlatents_path = optarg;
+			break;
+		case 'b':
+			batch = std::stoi(optarg);
+			if (batch < 1) {
+				std::cerr << "error: batch size must be >= 1\n\n";
+				usage();
+				return 1;
+			}
+			break;
+		case 'k':
+			shards = std::max(1, std::stoi(optarg));
+			break;
 		case 'p':
 			do_inspect = true;
 			break;
+		case 'j':
+			jobs = std::max(1, std::stoi(optarg));
+			break;
+		case 'f':
+			if (!format.parse(optarg)) {
+				std::cerr << "error: unknown image format: " << optarg << "\n\n";
+				usage();
+				return 1;
+			}
+			break;
+		case 'q':
+			format.mQuality = std::min(std::max(std::stoi(optarg), 1), 100);
+			break;
+		case 'z':
+			format.mPngLevel = std::min(std::max(std::stoi(optarg), 0), 9);
+			break;
+		case 'r':
+			resume = true;
+			break;
+		case 'w':
+			wcache_dir = fs::absolute(optarg);
+			break;
+		case OPT_INTRA_THREADS:
+			session.mIntraOpThreads = std::max(0, std::stoi(optarg));
+			break;
+		case OPT_INTER_THREADS:
+			session.mInterOpThreads = std::max(0, std::stoi(optarg));
+			break;
+		case OPT_NUMA_NODE:
+			session.mNumaNode = std::stoi(optarg);
+			if (session.mNumaNode < 0 || session.mNumaNode >= numa_node_count()) {
+				std::cerr << "error: no NUMA node " << optarg << "\n\n";
+				return 1;
+			}
+			break;
+		case OPT_SERVE:
+			server.mEndpoint = optarg;
+			break;
+		case OPT_MAX_WAIT:
+			server.mMaxWait = std::max(0, std::stoi(optarg));
+			break;
+		case OPT_BENCH:
+			bench.mIterations = std::max(1, std::stoi(optarg));
+			break;
+		case OPT_WARMUP:
+			bench.mWarmup = std::max(0, std::stoi(optarg));
+			break;
+		case OPT_REPORT:
+			bench.mReport = optarg;
+			break;
+		case OPT_MAX_RSS_GROWTH:
+			bench.mMaxRssGrowth = std::stod(optarg);
+			break;
+		case OPT_OP_LIBRARY:
+			session.mOpLibraries.push_back(fs::absolute(optarg).string());
+			break;
+		case OPT_NO_FROZEN:
+			session.mFrozen = false;
+			break;
+		case OPT_RNG:
+			rng = optarg;
+			rng_sampler = latent_sampler(rng);
+			if (rng_sampler == nullptr) {
+				std::cerr << "error: unknown rng: " << optarg << "\n\n";
+				usage();
+				return 1;
+			}
+			break;
+		case OPT_TRUNC:
+			psi_list = parse_psi(optarg);
+			break;
+		case OPT_TRUNC_CUTOFF:
+			trunc_cutoff = std::max(0, std::stoi(optarg));
+			break;
+		case OPT_ROWS:
+			stylemix.mRows = parse_seeds(optarg).to_vector();
+			break;
+		case OPT_COLS:
+			stylemix.mCols = parse_seeds(optarg).to_vector();
+			break;
+		case OPT_STYLES:
+			stylemix.mStyles = parse_seeds(optarg).to_vector();
+			break;
+		case OPT_INTERP:
+			interpolate.mFrames = std::stoi(optarg);
+			if (interpolate.mFrames < 1) {
+				std::cerr << "error: interpolation frames must be >= 1\n\n";
+				usage();
+				return 1;
+			}
+			break;
+		case OPT_SLERP:
+			interpolate.mSlerp = true;
+			break;
+		case OPT_LOOP:
+			interpolate.mLoop = true;
+			break;
+		case OPT_WARMUP_BATCHES:
+			warmup_batches = parse_seeds(optarg).to_vector();
+			if (warmup_batches.empty() || *std::min_element(warmup_batches.begin(), warmup_batches.end()) < 1) {
+				std::cerr << "error: warmup batch sizes must be >= 1\n\n";
+				usage();
+				return 1;
+			}
+			break;
+		case OPT_TRACE:
+			trace_path = optarg;
+			break;
+		case OPT_TRACE_EVERY:
+			trace_every = std::max(1, std::stoi(optarg));
+			break;
+		case OPT_ONEDNN:
+			if (std::string(optarg) == "on") {
+				session.mOneDnn = 1;
+			}
+			else if (std::string(optarg) == "off") {
+				session.mOneDnn = 0;
+			}
+			else {
+				std::cerr << "error: --onednn expects on or off\n\n";
+				usage();
+				return 1;
+			}
+			break;
 		case '?':
 		case ':':
 			std::cerr << "error: unknown options\n\n";
@@ -242,46 +538,624 @@ main(int argc, char* argv[])
 		exit(1);
 	}
 
-	outdir = fs::absolute(((argc - optind) == 2) ? argv[optind + 1] : "./out");
-	if (!fs::exists(outdir)) {
-		fs::create_directories(outdir);
+	// the images go to stdout, the model card and the reports to stderr
+	if ((argc - optind) == 2 && strcmp(argv[optind + 1], "-") == 0) {
+		std::cout.rdbuf(std::cerr.rdbuf());
 	}
 
-	// 85,265,297,849 
+	// W depends on the model and the latents: <dir>/<model hash>/<rng>
+	if (!wcache_dir.empty()) {
+		std::string hash = saved_model_hash(model.string());
+		if (hash.empty()) {
+			std::cerr << "Warning: no saved_model.pb to tell the model by, -w is ignored." << std::endl;
+			wcache_dir.clear();
+		}
+		else {
+			wcache_dir = wcache_dir / hash / rng;
+		}
+	}
+
+	// the plugins of the custom ops exported with the model (pkl2savedmodel.py --impl cpu)
+	if (session.mOpLibraries.empty() && fs::is_directory(model / "ops")) {
+		for (const auto& entry : fs::directory_iterator(model / "ops")) {
+			if (entry.path().extension() == ".so" || entry.path().extension() == ".dll") {
+				session.mOpLibraries.push_back(entry.path().string());
+			}
+		}
+		std::sort(session.mOpLibraries.begin(), session.mOpLibraries.end());
+	}
+
+	// seed -> 'size' values of the latent, as many as the model takes
+	auto latant_from_seed = [rng_sampler](int seed, float* latant, size_t size) {
+		rng_sampler(uint32_t(seed), latant, size);
+	};
+
+	if (!server.mEndpoint.empty()) {
+		// the session stays warm across the requests
+		try {
+			std::unique_ptr<Tf2Interp> interp(open_model(model, session));
+			if (do_inspect) {
+				model_card(*interp);
+			}
+			if (!warmup_batches.empty() && warmup_model(*interp, warmup_batches, false) < 0) {
+				return 1;
+			}
+			server.mMaxBatch = batch;
+			server.mFormat   = format;
+			server.mSampler  = latant_from_seed;
+			server.mPsi      = psi_list.empty() ? PSI_NONE : psi_list[0];
+			server.mTruncCutoff = trunc_cutoff;
+			GenServer gen_server(*interp, server);
+			return gen_server.run();
+		}
+		catch (...) {
+			std::cerr << "Error: can't launch interp." << std::endl;
+			return 1;
+		}
+	}
+
+	if (bench.mIterations > 0) {
+		// the stages run one after another on this thread to time them alone
+		std::unique_ptr<OutputSink> bench_sink;
+		if ((argc - optind) == 2) {
+			bench_sink.reset(OutputSink::create(argv[optind + 1], false));
+			if (!bench_sink) {
+				std::cerr << "Error: can't open output: " << argv[optind + 1] << std::endl;
+				return 1;
+			}
+		}
+		Seeds bench_seeds = parse_seeds(seeds.empty() ? "0-63" : seeds);
+
+		int status;
+		try {
+			auto load_start = std::chrono::steady_clock::now();
+			std::unique_ptr<Tf2Interp> interp(open_model(model, session));
+			double load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load_start).count();
+			double warmup_ms = 0.0;
+			if (!warmup_batches.empty()) {
+				warmup_ms = warmup_model(*interp, warmup_batches, false);
+				if (warmup_ms < 0) {
+					return 1;
+				}
+			}
+			bench.mSampler = latant_from_seed;
+			bench.mConfig = {
+				{"model",         model.string()},
+				{"format",        format.ext() + 1},
+				{"seeds",         bench_seeds.size()},
+				{"intra_threads", session.mIntraOpThreads},
+				{"inter_threads", session.mInterOpThreads},
+				{"numa_node",     session.mNumaNode},
+				{"onednn",        session.mOneDnn},
+				{"write",         bench_sink != nullptr},
+				{"frozen",        interp->frozen()},
+				{"load_ms",       load_ms},
+				{"rng",           rng},
+				{"warmup_ms",     warmup_ms},
+			};
+			if (!trace_path.empty()) {
+				interp->set_trace(trace_every);
+			}
+			Bench bench_run(*interp, bench);
+			status = bench_run.run(bench_seeds, batch, format, bench_sink.get());
+			if (!trace_path.empty()) {
+				save_trace(*interp, trace_path);
+			}
+		}
+		catch (...) {
+			std::cerr << "Error: can't launch interp." << std::endl;
+			return 1;
+		}
+		if (bench_sink && !bench_sink->close()) {
+			std::cerr << "Error: can't write the output: " << argv[optind + 1] << std::endl;
+			status = 1;
+		}
+		return status;
+	}
+
+	if (!stylemix.mRows.empty() || !stylemix.mCols.empty()) {
+		// one grid image of all the seeds, written at the end
+		if (stylemix.mRows.empty() || stylemix.mCols.empty()) {
+			std::cerr << "Error: style mixing needs both --rows and --cols." << std::endl;
+			return 1;
+		}
+		output = ((argc - optind) == 2) ? argv[optind + 1] : "./out";
+		std::unique_ptr<OutputSink> grid_sink(OutputSink::create(output, false));
+		if (!grid_sink) {
+			std::cerr << "Error: can't open output: " << output << std::endl;
+			return 1;
+		}
+
+		int status;
+		try {
+			std::unique_ptr<Tf2Interp> interp(open_model(model, session));
+			if (do_inspect) {
+				model_card(*interp);
+			}
+			if (!warmup_batches.empty() && warmup_model(*interp, warmup_batches, false) < 0) {
+				return 1;
+			}
+			stylemix.mBatch       = batch;
+			stylemix.mPsi         = psi_list.empty() ? PSI_NONE : psi_list[0];
+			stylemix.mTruncCutoff = trunc_cutoff;
+			stylemix.mWCacheDir   = wcache_dir;
+			stylemix.mSampler     = latant_from_seed;
+			StyleMix grid(*interp, stylemix);
+			status = grid.run(format, grid_sink.get());
+		}
+		catch (...) {
+			std::cerr << "Error: can't launch interp." << std::endl;
+			return 1;
+		}
+		if (!grid_sink->close()) {
+			std::cerr << "Error: can't write the output: " << output << std::endl;
+			status = 1;
+		}
+		return status;
+	}
+
+	if (interpolate.mFrames > 0) {
+		// the frames are streamed to the sink as they come
+		NpyFile keyframes;
+		if (!dlatents_path.empty()) {
+			if (interpolate.mSlerp) {
+				std::cerr << "Error: --slerp takes the seeds, not the dlatents." << std::endl;
+				return 1;
+			}
+			if (!keyframes.open(dlatents_path, "dlatents") && !keyframes.open(dlatents_path)) {
+				std::cerr << "Error: " << keyframes.error() << std::endl;
+				return 1;
+			}
+			if (keyframes.descr() != "<f4" || keyframes.shape().size() < 2) {
+				std::cerr << "Error: dlatents must be float32 [N,layers,components]: " << keyframes.descr() << std::endl;
+				return 1;
+			}
+			interpolate.mDlatents = &keyframes;
+		}
+		else {
+			interpolate.mSeeds = parse_seeds(seeds).to_vector();
+		}
+
+		output = ((argc - optind) == 2) ? argv[optind + 1] : "./out";
+		std::unique_ptr<OutputSink> frame_sink(OutputSink::create(output, false));
+		if (!frame_sink) {
+			std::cerr << "Error: can't open output: " << output << std::endl;
+			return 1;
+		}
+
+		int status;
+		{
+			ImageWriter frame_writer(frame_sink.get(), "frame%06d", format, jobs, 2*batch);
+			try {
+				std::unique_ptr<Tf2Interp> interp(open_model(model, session));
+				if (do_inspect) {
+					model_card(*interp);
+				}
+				if (!warmup_batches.empty() && warmup_model(*interp, warmup_batches, !dlatents_path.empty()) < 0) {
+					return 1;
+				}
+				interpolate.mBatch       = batch;
+				interpolate.mPsi         = psi_list.empty() ? PSI_NONE : psi_list[0];
+				interpolate.mTruncCutoff = trunc_cutoff;
+				interpolate.mWCacheDir   = wcache_dir;
+				interpolate.mSampler     = latant_from_seed;
+				Interpolator walk(*interp, interpolate);
+				status = walk.run(frame_writer);
+			}
+			catch (...) {
+				std::cerr << "Error: can't launch interp." << std::endl;
+				status = 1;
+			}
+			frame_writer.finish();
+			if (frame_writer.failed() > 0) {
+				std::cerr << "Error: " << frame_writer.failed() << " frames are not written." << std::endl;
+				status = 1;
+			}
+		}
+		if (!frame_sink->close()) {
+			std::cerr << "Error: can't write the output: " << output << std::endl;
+			status = 1;
+		}
+		return status;
+	}
+
+	output = ((argc - optind) == 2) ? argv[optind + 1] : "./out";
+	std::unique_ptr<OutputSink> sink(OutputSink::create(output, resume));
+	if (!sink) {
+		std::cerr << "Error: can't open output: " << output << std::endl;
+		exit(1);
+	}
 
-	LatantIn latant_in;
+	// 85,265,297,849 
 
-	if (!seeds.empty()) {
-		latant_in = latants_from_seeds(seeds);
+	/* the images are rendered from the seeds, or from the dlatents of
+	*  the file. the file is mapped, so it is read batch by batch.
+	*/
+	Seeds seed_list;
+	NpyFile dlatents;
+	int64_t num_sources;
+	if (!dlatents_path.empty()) {
+		if (!dlatents.open(dlatents_path, "dlatents") && !dlatents.open(dlatents_path)) {
+			std::cerr << "Error: " << dlatents.error() << std::endl;
+			exit(1);
+		}
+		if (dlatents.descr() != "<f4" || dlatents.shape().size() < 2) {
+			std::cerr << "Error: dlatents must be float32 [N,layers,components]: " << dlatents.descr() << std::endl;
+			exit(1);
+		}
+		num_sources = dlatents.shape()[0];
 	}
 	else {
-		std::cerr << "Error: needs --seeds option." << std::endl;
+		seed_list = parse_seeds(seeds);
+		if (seed_list.empty()) {
+			std::cerr << "Error: needs --seeds or --dlatents option." << std::endl;
+			exit(1);
+		}
+		num_sources = seed_list.size();
+	}
+
+	/* with the psi list, each seed or dlatent (source) is rendered with
+	*  each psi: the image i is the source i/num_psi truncated by the psi
+	*  i%num_psi, so the images of a source come in a row and share its W.
+	*/
+	int num_psi = std::max<int>(1, psi_list.size());
+	if (num_sources > INT_MAX/num_psi) {
+		std::cerr << "Error: too many images, " << num_sources << " sources x " << num_psi << " psi." << std::endl;
 		exit(1);
 	}
+	int num_images = int(num_sources*num_psi);
 
-	try {
-		Tf2Interp interp(model.string(), "Gs/latents_in,f32,1,512", "Gs/images_out,f32,1,3,512,512");
-		
-		if (do_inspect) { model_card(interp); }
+	std::string name_format = dlatents_path.empty() ? "result_%d" : "dlatent%02d";
+	std::vector<std::string> psi_suffix;
+	if (psi_list.size() > 1) {
+		for (float psi : psi_list) {
+			std::ostringstream suffix;
+			suffix << "_psi" << psi;
+			psi_suffix.push_back(suffix.str());
+		}
+	}
+
+	// stage 3: image encoding and writing
+	// the shards may post their batches out of order
+	ImageWriter writer(sink.get(), [&](int i) {
+		char name[64];
+		snprintf(name, sizeof(name), name_format.c_str(), i/num_psi);
+		return psi_suffix.empty() ? std::string(name) : name + psi_suffix[i % num_psi];
+	}, format, jobs, 2*shards*batch);
+
+	/* pipeline: sampling -> inference -> encoding/writing.
+	*  each stage runs on its own thread(s) and the bounded queues between
+	*  them throttle the faster stages down to the speed of the inference.
+	*  the input tensors come from the pool and go back to it after the
+	*  run, so the memory doesn't grow with the number of images.
+	*/
+	BoundedQueue<LatantBatch> latant_q(QUEUE_DEPTH*shards);
+	TensorPool input_pool;
+
+	// stage 1: latent sampling
+	// the seeds are taken as the batches go, the images written by the previous run are skipped
+	std::thread sampler([&]() {
+		uint64_t seq = 0;
+		for (int i = 0; i < num_images; ) {
+			LatantBatch item;
+			item.seq = seq;
+			for (; i < num_images && item.index.size() < batch; i++) {
+				if (!sink->exists(writer.name(i))) {
+					item.index.push_back(i);
+				}
+			}
+			if (item.index.empty()) {
+				break;
+			}
+			seq += item.index.size();
+
+			// the dlatents of the file are taken by the inference, the latents
+			// of the seeds are written in place of the input tensor
+			if (!seed_list.empty()) {
+				item.data = input_pool.acquire(TF_FLOAT, {int64_t(item.index.size()), MAX_LATANT});
+				if (!item.data) {
+					std::cerr << "Error: out of memory." << std::endl;
+					break;
+				}
+				float* latents = reinterpret_cast<float*>(TF_TensorData(item.data.get()));
+				for (int k = 0; k < item.index.size(); k++) {
+					int source = item.index[k]/num_psi;
+					if (k > 0 && source == item.index[k - 1]/num_psi) {
+						std::copy_n(&latents[(k - 1)*MAX_LATANT], MAX_LATANT, &latents[k*MAX_LATANT]);
+					}
+					else {
+						latant_from_seed(seed_list[source], &latents[k*MAX_LATANT], MAX_LATANT);
+					}
+				}
+			}
+			if (!latant_q.push(std::move(item))) {
+				break;
+			}
+		}
+		latant_q.close();
+	});
+
+	// stage 2: inference, on one or more sessions
+	std::atomic<int> live_shards(std::max(shards, 1));
+	auto inference = [&](int shard, const Tf2Options& options) -> int {
+		LatantBatch item;
+		int posted = 0;		// images of 'item' passed to the writer
+		try {
+			std::unique_ptr<Tf2Interp> interp(open_model(model, options));
+
+			if (do_inspect && shard == 0) {
+				model_card(*interp);
+				interp->select(SIGNATURE_SERVING_DEFAULT);
+			}
+			if (!warmup_batches.empty() && warmup_model(*interp, warmup_batches, dlatents.data() != nullptr, shard) < 0) {
+				throw TF_INTERNAL;
+			}
+			if (!trace_path.empty() && shard == 0) {
+				interp->set_trace(trace_every);
+			}
+
+			/* with the separate mapping and synthesis, the mapping network runs
+			*  only for the seeds whose W is not in the cache.
+			*/
+			bool split = interp->has_signature("mapping") && interp->has_signature("synthesis");
+
+			std::unique_ptr<DlatentCache> wcache;
+			std::vector<int64_t> wshape;	// [count, layers, components]
+			WSpace wspace;
+			if (split) {
+				interp->select("synthesis");
+				wshape = interp->input_shape(0);
+				size_t dlatent_size = 1;
+				for (int i = 1; i < wshape.size(); i++) {
+					dlatent_size *= wshape[i];
+				}
+				// W depends on the latents, so each sampler has its own cache
+				wcache.reset(new DlatentCache(dlatent_size, wcache_dir));
+
+				int layers = (wshape.size() == 3) ? wshape[1] : 1;
+				wspace = WSpace(layers, dlatent_size/layers);
+			}
+
+			// psi on the W of the sources: the seeds without --trunc take DEFAULT_PSI as
+			// serving_default, the dlatents none
+			std::vector<float> psi_of(psi_list);
+			if (!split && !psi_of.empty()) {
+				std::cerr << "Error: the model has no mapping and synthesis signatures for truncation." << std::endl;
+				throw TF_NOT_FOUND;
+			}
+			if (split && dlatents.data() == nullptr) {
+				if (psi_of.empty()) {
+					psi_of.push_back(PSI_NONE);
+				}
+				for (float& psi : psi_of) {
+					psi = mapping_psi(*interp, psi);
+					if (psi == PSI_NONE) {
+						throw TF_INVALID_ARGUMENT;
+					}
+				}
+			}
+			bool truncating = std::any_of(psi_of.begin(), psi_of.end(), [](float psi) { return psi != 1.0f; });
+			if (truncating) {
+				if (!wspace.load_avg(*interp)) {
+					std::cerr << "Error: truncation is not available on this model." << std::endl;
+					throw TF_NOT_FOUND;
+				}
+			}
+
+			if (dlatents.data() != nullptr) {
+				if (!split) {
+					std::cerr << "Error: the model has no synthesis signature for dlatents." << std::endl;
+					throw TF_NOT_FOUND;
+				}
+				if (dlatents.row_bytes() != wcache->dlatent_size()*sizeof(float)) {
+					std::cerr << "Error: the shape of dlatents doesn't match the model." << std::endl;
+					throw TF_INVALID_ARGUMENT;
+				}
+			}
+
+			std::vector<int> miss;		// the seeds missing in the cache
+
+			/*SUBROUTINE*/
+			auto acquire = [&](const std::vector<int64_t>& shape) {
+				TensorPtr tensor = input_pool.acquire(TF_FLOAT, shape);
+				if (!tensor) {
+					std::cerr << "Error: out of memory." << std::endl;
+					throw TF_RESOURCE_EXHAUSTED;
+				}
+				return tensor;
+			};
+			auto truncate = [&](float* w, const LatantBatch& item) {
+				if (!truncating) {
+					return;
+				}
+				for (int k = 0; k < item.index.size(); k++) {
+					wspace.truncate(&w[k*wspace.dlatent_size()], 1, psi_of[item.index[k] % num_psi], trunc_cutoff);
+				}
+			};
+			auto set_input = [&](TensorPtr tensor) {
+				if (interp->set_input_tensor(0, std::move(tensor)) < 0) {
+					std::cerr << "Error: the input doesn't match the model." << std::endl;
+					throw TF_INVALID_ARGUMENT;
+				}
+			};
+			/**/
 
-		for (int i = 0; i < latant_in.size(); i++) {
-			float* latant = latant_in[i].get();
-			//std::cout << latant[0] << "," << latant[10] << "," << latant[511] << std::endl;
+			while (latant_q.pop(item)) {
+				// the last batch may be partial
+				int count = item.index.size();
+				posted = 0;
 
-			interp.set_input_tensor(0, reinterpret_cast<uint8_t*>(latant), MAX_LATANT*sizeof(float));
-			interp.invoke();
-			std::string bin = interp.get_output_tensor(0);
+				if (dlatents.data() != nullptr) {
+					interp->select("synthesis");
 
-			save_to_image(bin, outdir, "result_%d.jpg", i);
+					wshape[0] = count;
+					TensorPtr wbatch = acquire(wshape);
+					uint8_t* w = reinterpret_cast<uint8_t*>(TF_TensorData(wbatch.get()));
+					size_t row_bytes = dlatents.row_bytes();
+					if (num_psi == 1 && item.index.back() - item.index.front() == count - 1) {
+						// consecutive rows go from the mapping to the tensor at once
+						memcpy(w, dlatents.row<uint8_t>(item.index.front()), count*row_bytes);
+					}
+					else {
+						for (int k = 0; k < count; k++) {
+							memcpy(&w[k*row_bytes], dlatents.row<uint8_t>(item.index[k]/num_psi), row_bytes);
+						}
+					}
+					truncate(reinterpret_cast<float*>(w), item);
+					set_input(std::move(wbatch));
+				}
+				else if (split) {
+					size_t dlatent_size = wcache->dlatent_size();
+					wshape[0] = count;
+					TensorPtr wbatch = acquire(wshape);
+					float* w = reinterpret_cast<float*>(TF_TensorData(wbatch.get()));
+
+					// the images of a source in a row take its W once
+					miss.clear();
+					for (int k = 0; k < count; k++) {
+						int source = item.index[k]/num_psi;
+						if (k > 0 && source == item.index[k - 1]/num_psi) {
+							continue;
+						}
+						if (!wcache->find(seed_list[source], &w[k*dlatent_size])) {
+							miss.push_back(k);
+						}
+					}
+
+					if (!miss.empty()) {
+						interp->select("mapping");
+						if (miss.size() == count) {
+							set_input(std::move(item.data));
+						}
+						else {
+							TensorPtr zmiss = acquire({int64_t(miss.size()), MAX_LATANT});
+							const float* z = reinterpret_cast<const float*>(TF_TensorData(item.data.get()));
+							float* zm = reinterpret_cast<float*>(TF_TensorData(zmiss.get()));
+							for (int m = 0; m < miss.size(); m++) {
+								std::copy_n(&z[miss[m]*MAX_LATANT], MAX_LATANT, &zm[m*MAX_LATANT]);
+							}
+							set_input(std::move(zmiss));
+						}
+						if (!interp->invoke()) {
+							throw TF_INTERNAL;
+						}
+
+						TensorView w_view = interp->output_view(0);
+						for (int m = 0; m < miss.size(); m++) {
+							float* wm = &w[miss[m]*dlatent_size];
+							std::copy_n(w_view.data<float>(m), dlatent_size, wm);
+							wcache->insert(seed_list[item.index[miss[m]]/num_psi], wm);
+						}
+					}
+
+					for (int k = 1; k < count; k++) {
+						if (item.index[k]/num_psi == item.index[k - 1]/num_psi) {
+							std::copy_n(&w[(k - 1)*dlatent_size], dlatent_size, &w[k*dlatent_size]);
+						}
+					}
+					truncate(w, item);
+
+					interp->select("synthesis");
+					set_input(std::move(wbatch));
+				}
+				else {
+					set_input(std::move(item.data));
+				}
+				if (!interp->invoke()) {
+					throw TF_INTERNAL;
+				}
+
+				// the images of the batch share the output tensor
+				std::shared_ptr<TF_Tensor> images = interp->take_output_tensor(0);
+				for (; posted < count; posted++) {
+					writer.post(item.seq + posted, item.index[posted], images, posted);
+				}
+			}
+
+			if (!trace_path.empty() && shard == 0) {
+				save_trace(*interp, trace_path);
+			}
+		}
+		catch (...) {
+			std::cerr << "Error: can't launch interp." << std::endl;
+
+			// the images of the failed batch won't come, don't let the others wait
+			for (int k = posted; k < item.index.size(); k++) {
+				writer.skip(item.seq + k);
+			}
+
+			// nobody takes the queued batches after the last shard, stop the sampler
+			// and skip them, so the writer flushes the images rendered after them
+			if (--live_shards == 0) {
+				latant_q.close();
+				int skipped = 0;
+				while (latant_q.pop(item)) {
+					for (int k = 0; k < item.index.size(); k++) {
+						writer.skip(item.seq + k);
+					}
+					skipped += item.index.size();
+				}
+				if (skipped > 0) {
+					std::cerr << "Error: no shard left, " << skipped << " queued images are not rendered." << std::endl;
+				}
+			}
+			return 1;
 		}
+		--live_shards;
+		return 0;
+	};
+
+	int status = 0;
+	if (shards <= 1) {
+		status = inference(0, session);
 	}
+	else {
+		/* the shards take the batches from the shared queue as they become
+		*  free (work stealing). without --numa-node, the shards are spread
+		*  over the NUMA nodes, and the CPUs of a node are divided among its
+		*  shards.
+		*/
+		int nodes = numa_node_count();
+		std::vector<std::thread> workers;
+		std::vector<int> results(shards, 0);
+		for (int i = 0; i < shards; i++) {
+			Tf2Options options = session;
+			options.mPerSessionThreads = true;
+			if (options.mNumaNode < 0 && nodes > 1) {
+				options.mNumaNode = i % nodes;
+			}
 
-	catch (...) {
-		std::cerr << "Error: can't launch interp.";
-		exit(1);
+			int sharing = (options.mNumaNode < 0 || session.mNumaNode >= 0) ? shards : (shards + nodes - 1 - options.mNumaNode)/nodes;
+			std::vector<int> cpus;
+			int num_cpus = (options.mNumaNode >= 0 && numa_node_cpus(options.mNumaNode, cpus)) ? cpus.size() : std::thread::hardware_concurrency();
+			if (options.mIntraOpThreads <= 0) {
+				options.mIntraOpThreads = std::max(1, num_cpus/sharing);
+			}
+			if (options.mInterOpThreads <= 0) {
+				options.mInterOpThreads = 1;
+			}
+
+			workers.emplace_back([&, i, options]() { results[i] = inference(i, options); });
+		}
+		for (auto& worker : workers) {
+			worker.join();
+		}
+		status = *std::max_element(results.begin(), results.end());
+	}
+
+	latant_q.close();
+	sampler.join();
+	writer.finish();
+	if (writer.failed() > 0) {
+		std::cerr << "Error: " << writer.failed() << " images are not written." << std::endl;
+		status = 1;
+	}
+	if (!sink->close()) {
+		std::cerr << "Error: can't write the output: " << output << std::endl;
+		status = 1;
 	}
 
-    return 0;
+    return status;
 }
 
 /*** generate.cpp *********************************************************}}}*/
@@ -0,0 +1,353 @@
+/***  File Header  ************************************************************/
+/**
+* @file image_writer.cpp
+*
+* Worker pool to encode and write the generated images.
+* @author   Shozo Fukuda
+* @date     create Wed Jul 12 14:05:33 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+
+#pragma warning(disable : 4996)
+
+#include <stdio.h>
+#include <algorithm>
+#include "stb_image_write.h"
+
+#include "image_conv.h"
+#include "image_writer.h"
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* stb write callback
+* @par DESCRIPTION
+*   append the encoded chunk to std::vector<uint8_t>.
+**/
+/**************************************************************************{{{*/
+static void
+append_to_vector(void* context, void* data, int size)
+{
+    auto mem = reinterpret_cast<std::vector<uint8_t>*>(context);
+    auto ptr = reinterpret_cast<uint8_t*>(data);
+    mem->insert(mem->end(), ptr, ptr + size);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* parse format name
+* @par DESCRIPTION
+*   "jpg"/"jpeg", "png", "ppm" or "raw".
+*
+* @retval true  success
+* @retval false unknown format
+**/
+/**************************************************************************{{{*/
+bool
+ImageFormat::parse(const std::string& name)
+{
+    if (name == "jpg" || name == "jpeg") {
+        mType = FORMAT_JPEG;
+    }
+    else if (name == "png") {
+        mType = FORMAT_PNG;
+    }
+    else if (name == "ppm") {
+        mType = FORMAT_PPM;
+    }
+    else if (name == "raw") {
+        mType = FORMAT_RAW;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* file extension
+* @par DESCRIPTION
+*   extension of the format including '.'.
+**/
+/**************************************************************************{{{*/
+const char*
+ImageFormat::ext() const
+{
+    switch (mType) {
+    case FORMAT_PNG: return ".png";
+    case FORMAT_PPM: return ".ppm";
+    case FORMAT_RAW: return ".rgb";
+    default:         return ".jpg";
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* file header
+* @par DESCRIPTION
+*   the bytes before the pixels of the uncompressed formats: the PPM
+*   header, or none for raw. empty for JPEG and PNG as well.
+**/
+/**************************************************************************{{{*/
+std::string
+ImageFormat::header(int height, int width) const
+{
+    if (mType != FORMAT_PPM) {
+        return std::string();
+    }
+    char header[32];
+    snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+    return std::string(header);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* encode image
+* @par DESCRIPTION
+*   encode interleaved RGB image to the format into the memory.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+ImageFormat::encode(const uint8_t* rgb, int height, int width, std::vector<uint8_t>& out) const
+{
+    out.clear();
+
+    switch (mType) {
+    case FORMAT_JPEG:
+        stbi_write_jpg_to_func(append_to_vector, &out, width, height, 3, rgb, mQuality);
+        break;
+    case FORMAT_PNG:
+        stbi_write_png_to_func(append_to_vector, &out, width, height, 3, rgb, 0);
+        break;
+    case FORMAT_PPM: {
+            std::string head = header(height, width);
+            out.reserve(head.size() + size_t(3)*height*width);
+            out.insert(out.end(), head.begin(), head.end());
+            out.insert(out.end(), rgb, rgb + size_t(3)*height*width);
+        }
+        break;
+    case FORMAT_RAW:
+        out.assign(rgb, rgb + size_t(3)*height*width);
+        break;
+    }
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* constructor
+* @par DESCRIPTION
+*   the file names by the printf format 'basename' of the image index.
+**/
+/**************************************************************************{{{*/
+ImageWriter::ImageWriter(OutputSink* sink, const char* basename, const ImageFormat& format, int threads, int window)
+    : ImageWriter(sink, [fmt = std::string(basename)](int index) {
+          char name[64];
+          snprintf(name, sizeof(name), fmt.c_str(), index);
+          return std::string(name);
+      }, format, threads, window)
+{
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* constructor
+* @par DESCRIPTION
+*   start the worker threads. 'window' must cover the images posted out
+*   of order, e.g. the batches in flight of all producers.
+**/
+/**************************************************************************{{{*/
+ImageWriter::ImageWriter(OutputSink* sink, std::function<std::string(int)> basename, const ImageFormat& format, int threads, int window)
+    : mSink(sink), mBasename(basename), mFormat(format), mQueue(2*(threads > 0 ? threads : 1)),
+      mPosted(0), mNext(0), mFailed(0)
+{
+    // stb keeps the PNG level in a global, so set it before the workers run.
+    stbi_write_png_compression_level = mFormat.mPngLevel;
+
+    if (threads < 1) {
+        threads = 1;
+    }
+    mWindow = std::max(4*threads, window);
+    for (int i = 0; i < threads; i++) {
+        mWorkers.emplace_back(&ImageWriter::worker, this);
+    }
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* destructor
+* @par DESCRIPTION
+*   wait for the pending images.
+**/
+/**************************************************************************{{{*/
+ImageWriter::~ImageWriter()
+{
+    finish();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* post image
+* @par DESCRIPTION
+*   queue the image 'batch_index' of the output tensor as image 'index'.
+*   blocks while all workers are busy and the queue is full. for a single
+*   producer, the images are written in the posting order.
+*
+* @retval true  queued
+* @retval false the writer is finished
+**/
+/**************************************************************************{{{*/
+bool
+ImageWriter::post(int index, std::shared_ptr<TF_Tensor> images, int batch_index)
+{
+    return post(mPosted++, index, std::move(images), batch_index);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* post image in order
+* @par DESCRIPTION
+*   queue the image as the 'seq'-th one of the output. the producer which
+*   runs too far ahead of the writing waits here; the producer of the next
+*   image to write never waits, so the workers never stall on a gap.
+*
+* @retval true  queued
+* @retval false the writer is finished
+**/
+/**************************************************************************{{{*/
+bool
+ImageWriter::post(uint64_t seq, int index, std::shared_ptr<TF_Tensor> images, int batch_index)
+{
+    {
+        std::unique_lock<std::mutex> lock(mCommitMutex);
+        mCommitted.wait(lock, [&]{ return seq < mNext + mWindow; });
+    }
+    return mQueue.push(Job{ seq, index, std::move(images), batch_index });
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* skip image
+* @par DESCRIPTION
+*   give up the 'seq'-th image, e.g. the inference failed. the images
+*   after it are written without waiting for it.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+ImageWriter::skip(uint64_t seq)
+{
+    commit(seq, -1, std::vector<uint8_t>());
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* finish
+* @par DESCRIPTION
+*   write all queued images and stop the workers. the images still
+*   waiting for a sequence number that never came are counted as failed.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+ImageWriter::finish()
+{
+    mQueue.close();
+    for (auto& worker : mWorkers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mCommitMutex);
+    for (auto& item : mPending) {
+        if (item.second.first >= 0) {
+            fprintf(stderr, "Error: %s is lost, an earlier image never came\n", name(item.second.first).c_str());
+            mFailed++;
+        }
+    }
+    mPending.clear();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* image name
+* @par DESCRIPTION
+*   name of the image 'index' in the sink.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+std::string
+ImageWriter::name(int index) const
+{
+    return mBasename(index) + mFormat.ext();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* worker thread
+* @par DESCRIPTION
+*   convert and encode the queued images.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+ImageWriter::worker()
+{
+    std::vector<uint8_t> rgb;
+
+    Job job;
+    while (mQueue.pop(job)) {
+        TensorView images(job.images.get());
+        int height = images.dim(2);
+        int width  = images.dim(3);
+
+        // planar float tensor -> interleaved RGB in one pass
+        rgb.resize(size_t(3)*height*width);
+        nchw_to_hwc_u8(images.data<float>(job.batch_index), rgb.data(), 3, height, width);
+        job.images.reset();
+
+        std::vector<uint8_t> encoded;
+        mFormat.encode(rgb.data(), height, width, encoded);
+
+        commit(job.seq, job.index, std::move(encoded));
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* commit encoded image
+* @par DESCRIPTION
+*   pass the encoded images to the sink in the sequence order. post()
+*   keeps the sequence numbers in the window, so the reorder buffer stays
+*   small and a worker never waits here.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+ImageWriter::commit(uint64_t seq, int index, std::vector<uint8_t>&& encoded)
+{
+    std::unique_lock<std::mutex> lock(mCommitMutex);
+
+    mPending.emplace(seq, std::make_pair(index, std::move(encoded)));
+    while (!mPending.empty() && mPending.begin()->first == mNext) {
+        auto& item = mPending.begin()->second;
+        if (item.first >= 0 && !mSink->write(name(item.first), item.second.data(), item.second.size())) {
+            fprintf(stderr, "Error: can't write %s\n", name(item.first).c_str());
+            mFailed++;
+        }
+        mPending.erase(mPending.begin());
+        mNext++;
+    }
+    mCommitted.notify_all();
+}
+
+/*** image_writer.cpp *****************************************************}}}*/
@@ -0,0 +1,124 @@
+/***  File Header  ************************************************************/
+/**
+* @file image_writer.h
+*
+* Worker pool to encode and write the generated images.
+* @author   Shozo Fukuda
+* @date     create Wed Jul 12 14:05:33 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+#ifndef _IMAGE_WRITER_H
+#define _IMAGE_WRITER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <map>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "tf2/tf2_interp.h"
+#include "bounded_queue.h"
+#include "output_sink.h"
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Image format
+* @par DESCRIPTION
+*   output file format and its encoder parameters.
+**/
+/**************************************************************************{{{*/
+struct ImageFormat {
+//TYPE:
+    enum Type {
+        FORMAT_JPEG = 0,
+        FORMAT_PNG,
+        FORMAT_PPM,     // binary PPM (P6)
+        FORMAT_RAW,     // interleaved RGB bytes without header
+    };
+
+//LIFECYCLE:
+    ImageFormat() : mType(FORMAT_JPEG), mQuality(100), mPngLevel(8) {}
+
+//ACTION:
+    bool parse(const std::string& name);
+    void encode(const uint8_t* rgb, int height, int width, std::vector<uint8_t>& out) const;
+
+//INQUIRY:
+    const char* ext() const;
+    std::string header(int height, int width) const;
+
+//ATTRIBUTE:
+    Type mType;
+    int  mQuality;      // JPEG quality 1..100
+    int  mPngLevel;     // PNG compression level 0..9
+};
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Image writer
+* @par DESCRIPTION
+*   converts the output tensors to images and encodes them on a pool of
+*   worker threads. the encoded images are handed to the sink in the order
+*   they were posted, so the output does not depend on which worker
+*   handles which image. with several producers, each image is posted with
+*   its sequence number and the sink gets them in that order.
+**/
+/**************************************************************************{{{*/
+class ImageWriter {
+//LIFECYCLE:
+public:
+    ImageWriter(OutputSink* sink, const char* basename, const ImageFormat& format, int threads, int window = 0);
+    ImageWriter(OutputSink* sink, std::function<std::string(int)> basename, const ImageFormat& format, int threads, int window = 0);
+    virtual ~ImageWriter();
+
+//ACTION:
+public:
+    bool post(int index, std::shared_ptr<TF_Tensor> images, int batch_index);
+    bool post(uint64_t seq, int index, std::shared_ptr<TF_Tensor> images, int batch_index);
+    void skip(uint64_t seq);
+    void finish();
+
+//INQUIRY:
+public:
+    std::string name(int index) const;
+
+    /* the images the sink couldn't write, valid after finish() */
+    int failed() const { return mFailed; }
+
+private:
+    void worker();
+    void commit(uint64_t seq, int index, std::vector<uint8_t>&& encoded);
+
+//ATTRIBUTE:
+private:
+    struct Job {
+        uint64_t seq;                       // posting order
+        int index;
+        std::shared_ptr<TF_Tensor> images;  // [N, 3, H, W], shared by the images of a batch
+        int batch_index;
+    };
+
+    OutputSink* mSink;
+    std::function<std::string(int)> mBasename;  // index -> file name without extension
+    ImageFormat mFormat;
+
+    BoundedQueue<Job>        mQueue;
+    std::vector<std::thread> mWorkers;
+    uint64_t                 mPosted;
+
+    // reorder buffer: encoded images waiting for their turn
+    std::mutex              mCommitMutex;
+    std::condition_variable mCommitted;
+    uint64_t                mNext;
+    uint64_t                mWindow;    // images posted ahead of the next one to write
+    int                     mFailed;    // images not written
+    std::map<uint64_t, std::pair<int, std::vector<uint8_t>>> mPending;
+};
+
+#endif /* _IMAGE_WRITER_H */
+/*** image_writer.h *******************************************************}}}*/
@@ -0,0 +1,255 @@
+/***  File Header  ************************************************************/
+/**
+* @file interpolate.cpp
+*
+* Latent walk between the keyframes, streamed as frames.
+* @author   Shozo Fukuda
+* @date     create Wed Aug 23 13:52:41 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include "dlatent_cache.h"
+#include "interpolate.h"
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* constructor
+* @par DESCRIPTION
+*
+**/
+/**************************************************************************{{{*/
+Interpolator::Interpolator(Tf2Interp& interp, const InterpOptions& options)
+    : mInterp(interp), mOptions(options)
+{
+    mOptions.mBatch  = std::max(1, mOptions.mBatch);
+    mOptions.mFrames = std::max(1, mOptions.mFrames);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* number of keyframes
+* @par DESCRIPTION
+*
+*
+* @retval keyframes
+**/
+/**************************************************************************{{{*/
+size_t
+Interpolator::keys() const
+{
+    return (mOptions.mDlatents != nullptr) ? mOptions.mDlatents->shape()[0] : mOptions.mSeeds.size();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* number of frames
+* @par DESCRIPTION
+*   'frames' per segment between two keyframes. the open walk ends on the
+*   last keyframe, the loop ends one frame before the first one.
+*
+* @retval frames
+**/
+/**************************************************************************{{{*/
+size_t
+Interpolator::frames() const
+{
+    size_t segments = mOptions.mLoop ? keys() : keys() - 1;
+    return segments*mOptions.mFrames + (mOptions.mLoop ? 0 : 1);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* keyframe of frame
+* @par DESCRIPTION
+*   the frame is at 't' from the keyframe 'key' to the next one.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+Interpolator::key_of(size_t frame, size_t& key, float& t) const
+{
+    key = frame/mOptions.mFrames;
+    t   = float(frame % mOptions.mFrames)/mOptions.mFrames;
+    if (key >= keys()) {
+        // the last frame of the open walk
+        key = keys() - 1;
+        t   = 0.0f;
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* render walk
+* @par DESCRIPTION
+*   compute the frames batch by batch, run the synthesis and post the
+*   images to 'writer' as the frames 0, 1, 2...
+*
+* @retval exit status
+**/
+/**************************************************************************{{{*/
+int
+Interpolator::run(ImageWriter& writer)
+{
+    bool split = mInterp.has_signature("mapping") && mInterp.has_signature("synthesis");
+    if (keys() < 2) {
+        fprintf(stderr, "Error: interpolation needs 2 keyframes or more.\n");
+        return 1;
+    }
+    if (!split && (!mOptions.mSlerp || mOptions.mDlatents != nullptr || mOptions.mPsi != PSI_NONE)) {
+        fprintf(stderr, "Error: the model has no mapping and synthesis signatures, only --slerp of the seeds without --trunc is available.\n");
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<int64_t> wshape;    // [count, layers, components]
+    float psi = 1.0f;               // on the W of the keyframes
+    if (split) {
+        mInterp.select("synthesis");
+        wshape = mInterp.input_shape(0);
+        int layers = (wshape.size() == 3) ? wshape[1] : 1;
+        size_t dlatent_size = 1;
+        for (size_t i = 1; i < wshape.size(); i++) {
+            dlatent_size *= wshape[i];
+        }
+        mWSpace = WSpace(layers, dlatent_size/layers);
+
+        // the seeds without psi take DEFAULT_PSI as serving_default, the dlatents none
+        if (mOptions.mDlatents != nullptr) {
+            psi = (mOptions.mPsi == PSI_NONE) ? 1.0f : mOptions.mPsi;
+        }
+        else if ((psi = mapping_psi(mInterp, mOptions.mPsi)) == PSI_NONE) {
+            return 1;
+        }
+        if (psi != 1.0f && !mWSpace.load_avg(mInterp)) {
+            fprintf(stderr, "Error: truncation is not available on this model.\n");
+            return 1;
+        }
+        if (mOptions.mDlatents != nullptr && mOptions.mDlatents->row_bytes() != dlatent_size*sizeof(float)) {
+            fprintf(stderr, "Error: the shape of dlatents doesn't match the model.\n");
+            return 1;
+        }
+    }
+    size_t dlatent_size = mWSpace.dlatent_size();
+
+    std::vector<int64_t> zshape;    // [count, latent]
+    size_t latent_size = 0;
+    std::vector<float> keyframes;   // Z or W of the seeds
+    if (mOptions.mSlerp) {
+        mInterp.select(split ? "mapping" : SIGNATURE_SERVING_DEFAULT);
+        zshape = mInterp.input_shape(0);
+        latent_size = 1;
+        for (size_t i = 1; i < zshape.size(); i++) {
+            latent_size *= zshape[i];
+        }
+        keyframes.resize(keys()*latent_size);
+        for (size_t i = 0; i < keys(); i++) {
+            mOptions.mSampler(mOptions.mSeeds[i], &keyframes[i*latent_size], latent_size);
+        }
+    }
+    else if (mOptions.mDlatents == nullptr) {
+        // W of the seeds are mapped once
+        keyframes.resize(keys()*dlatent_size);
+        DlatentCache cache(dlatent_size, mOptions.mWCacheDir);
+        if (!mWSpace.map_seeds(mInterp, mPool, cache, mOptions.mSampler, mOptions.mSeeds, keyframes.data(), mOptions.mBatch)) {
+            fprintf(stderr, "Error: mapping failed.\n");
+            return 1;
+        }
+    }
+
+    /*SUBROUTINE*/
+    auto key_w = [&](size_t key) {
+        return (mOptions.mDlatents != nullptr) ? mOptions.mDlatents->row<float>(key) : &keyframes[key*dlatent_size];
+    };
+    auto acquire = [&](std::vector<int64_t>& shape, size_t count) {
+        shape[0] = count;
+        TensorPtr tensor = mPool.acquire(TF_FLOAT, shape);
+        if (!tensor) {
+            throw std::bad_alloc();
+        }
+        return tensor;
+    };
+    /**/
+
+    size_t total = frames();
+    size_t posted = 0;
+    try {
+        for (size_t first = 0; first < total; first += mOptions.mBatch) {
+            size_t count = std::min(total - first, size_t(mOptions.mBatch));
+
+            TensorPtr input;
+            if (mOptions.mSlerp) {
+                TensorPtr z = acquire(zshape, count);
+                float* zb = reinterpret_cast<float*>(TF_TensorData(z.get()));
+                for (size_t k = 0; k < count; k++) {
+                    size_t key;
+                    float  t;
+                    key_of(first + k, key, t);
+                    const float* a = &keyframes[key*latent_size];
+                    const float* b = &keyframes[((key + 1) % keys())*latent_size];
+                    slerp(a, b, t, &zb[k*latent_size], latent_size);
+                }
+
+                if (split) {
+                    input = acquire(wshape, count);
+                    if (!mWSpace.map(mInterp, std::move(z), reinterpret_cast<float*>(TF_TensorData(input.get())))) {
+                        throw std::runtime_error("mapping failed");
+                    }
+                }
+                else {
+                    input = std::move(z);
+                }
+            }
+            else {
+                input = acquire(wshape, count);
+                float* wb = reinterpret_cast<float*>(TF_TensorData(input.get()));
+                for (size_t k = 0; k < count; k++) {
+                    size_t key;
+                    float  t;
+                    key_of(first + k, key, t);
+                    mWSpace.lerp(key_w(key), key_w((key + 1) % keys()), t, &wb[k*dlatent_size]);
+                }
+            }
+            if (split) {
+                // the truncation is linear, so it is the same before or after the lerp
+                mWSpace.truncate(reinterpret_cast<float*>(TF_TensorData(input.get())), count, psi, mOptions.mTruncCutoff);
+            }
+
+            mInterp.select(split ? "synthesis" : SIGNATURE_SERVING_DEFAULT);
+            if (mInterp.set_input_tensor(0, std::move(input)) < 0 || !mInterp.invoke()) {
+                throw std::runtime_error("synthesis failed");
+            }
+            std::shared_ptr<TF_Tensor> images = mInterp.take_output_tensor(0);
+            if (!images) {
+                throw std::runtime_error("synthesis failed");
+            }
+            for (size_t k = 0; k < count; k++) {
+                if (!writer.post(int(first + k), images, k)) {
+                    throw std::runtime_error("the writer is closed");
+                }
+                posted++;
+            }
+        }
+    }
+    catch (std::bad_alloc&) {
+        fprintf(stderr, "Error: out of memory.\n");
+        return 1;
+    }
+    catch (std::exception& e) {
+        fprintf(stderr, "Error: %s\n", e.what());
+        return 1;
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "interpolate: %zu keyframes, %zu frames, %.1f frames/s\n",
+        keys(), posted, (elapsed > 0.0) ? posted/elapsed : 0.0);
+    return 0;
+}
+
+/*** interpolate.cpp ******************************************************}}}*/
@@ -0,0 +1,88 @@
+/***  File Header  ************************************************************/
+/**
+* @file interpolate.h
+*
+* Latent walk between the keyframes, streamed as frames.
+* @author   Shozo Fukuda
+* @date     create Wed Aug 23 13:52:41 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+#ifndef _INTERPOLATE_H
+#define _INTERPOLATE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <functional>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+#include "tf2/tf2_interp.h"
+#include "tf2/tensor_pool.h"
+#include "npy_file.h"
+#include "image_writer.h"
+#include "wspace.h"
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Interpolation options
+* @par DESCRIPTION
+*
+**/
+/**************************************************************************{{{*/
+struct InterpOptions {
+    InterpOptions() : mDlatents(nullptr), mFrames(30), mLoop(false), mSlerp(false), mBatch(1), mPsi(PSI_NONE), mTruncCutoff(0) {}
+
+    std::vector<int> mSeeds;        // keyframes by seed
+    const NpyFile*   mDlatents;     // keyframes by W [N,layers,components], nullptr for the seeds
+    int         mFrames;            // frames from a keyframe to the next
+    bool        mLoop;              // back to the first keyframe at the end
+    bool        mSlerp;             // slerp the latents Z instead of lerp W
+    int         mBatch;             // frames per synthesis run
+    float       mPsi;               // truncation, PSI_NONE for the default
+    int         mTruncCutoff;       // layers to truncate, 0 for all
+    fs::path    mWCacheDir;         // W of the seeds, empty for none
+    std::function<void(int, float*, size_t)> mSampler;   // seed -> latent of the size
+};
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Interpolator
+* @par DESCRIPTION
+*   walks through the keyframes: W of the keyframes are lerped, or their
+*   latents Z are slerped and mapped batch by batch. the frames of a batch
+*   are computed just before its run and posted to the writer in order,
+*   which throttles the walk to the encoding, so the memory stays the
+*   same for any number of frames. the model without the mapping and
+*   synthesis signatures takes the slerped Z as they are.
+**/
+/**************************************************************************{{{*/
+class Interpolator {
+//LIFECYCLE:
+public:
+    Interpolator(Tf2Interp& interp, const InterpOptions& options);
+
+//ACTION:
+public:
+    int run(ImageWriter& writer);
+
+//INQUIRY:
+public:
+    size_t keys() const;
+    size_t frames() const;
+
+private:
+    void key_of(size_t frame, size_t& key, float& t) const;
+
+//ATTRIBUTE:
+private:
+    Tf2Interp&     mInterp;
+    InterpOptions  mOptions;
+    TensorPool     mPool;
+    WSpace         mWSpace;
+};
+
+#endif /* _INTERPOLATE_H */
+/*** interpolate.h ********************************************************}}}*/
@@ -0,0 +1,508 @@
+/***  File Header  ************************************************************/
+/**
+* @file output_sink.cpp
+*
+* Destinations of the encoded images.
+* @author   Shozo Fukuda
+* @date     create Fri Jul 14 16:48:02 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+
+#pragma warning(disable : 4996)
+
+#include <string.h>
+#include <time.h>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#define fseek64 _fseeki64
+#else
+#define fseek64 fseeko
+#endif
+
+#include "output_sink.h"
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* create sink
+* @par DESCRIPTION
+*   choose the sink by the output path:
+*     "-"        standard output
+*     "*.tar"    tar archive
+*     "*.pack"   packed file with index
+*     otherwise  directory
+*
+* @retval sink
+* @retval nullptr  can't open the output
+**/
+/**************************************************************************{{{*/
+OutputSink*
+OutputSink::create(const std::string& path, bool resume)
+{
+    OutputSink* sink;
+
+    fs::path out(path);
+    if (path == "-") {
+        sink = new StdoutSink();
+    }
+    else if (out.extension() == ".tar") {
+        sink = new TarSink(fs::absolute(out), resume);
+    }
+    else if (out.extension() == ".pack") {
+        sink = new PackSink(fs::absolute(out), resume);
+    }
+    else {
+        sink = new DirSink(fs::absolute(out), resume);
+    }
+
+    if (!sink->good()) {
+        delete sink;
+        return nullptr;
+    }
+    return sink;
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* constructor
+* @par DESCRIPTION
+*   create the output directory.
+**/
+/**************************************************************************{{{*/
+DirSink::DirSink(const fs::path& outdir, bool resume)
+    : mOutdir(outdir), mResume(resume)
+{
+    if (!fs::exists(mOutdir)) {
+        fs::create_directories(mOutdir);
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* write image
+* @par DESCRIPTION
+*   save the image to the file <outdir>/<name>. the file gets the name
+*   when it is complete, so resume never takes a broken one.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+bool
+DirSink::write(const std::string& name, const uint8_t* data, size_t size)
+{
+    fs::path fname = mOutdir / name;
+    fs::path tmp   = fname.string() + ".tmp";
+
+    FILE* fp = fopen(tmp.string().c_str(), "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "Error: can't write %s\n", fname.string().c_str());
+        return false;
+    }
+    bool res = fwrite(data, 1, size, fp) == size;
+    res = (fclose(fp) == 0) && res;
+
+    std::error_code ec;
+    if (res) {
+        fs::rename(tmp, fname, ec);
+    }
+    if (!res || ec) {
+        fs::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* check the image
+* @par DESCRIPTION
+*   the image file exists in resume mode.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+bool
+DirSink::exists(const std::string& name)
+{
+    return mResume && fs::exists(mOutdir / name);
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* destructor
+* @par DESCRIPTION
+*   flush and close the stream.
+**/
+/**************************************************************************{{{*/
+StreamSink::~StreamSink()
+{
+    StreamSink::close();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* open stream
+* @par DESCRIPTION
+*   open the file and place the write position at 'offset'.
+*   offset 0 creates a new file.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+bool
+StreamSink::open(const fs::path& path, uint64_t offset)
+{
+    mFile = fopen(path.string().c_str(), (offset == 0) ? "wb" : "r+b");
+    if (mFile == NULL) {
+        fprintf(stderr, "Error: can't open %s\n", path.string().c_str());
+        return false;
+    }
+
+    if (offset != 0 && fseek64(mFile, offset, SEEK_SET) != 0) {
+        fclose(mFile);
+        mFile = nullptr;
+        return false;
+    }
+    mOffset = offset;
+
+    mBuffer.resize(SINK_BUFFER_SIZE);
+    setvbuf(mFile, mBuffer.data(), _IOFBF, mBuffer.size());
+
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* put data
+* @par DESCRIPTION
+*   append data to the stream. after a failure, the position of the
+*   next data is unknown, so nothing is appended any more.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+bool
+StreamSink::put(const void* data, size_t size)
+{
+    if (mFailed || fwrite(data, 1, size, mFile) != size) {
+        mFailed = true;
+        return false;
+    }
+    mOffset += size;
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* close stream
+* @par DESCRIPTION
+*   flush the buffer to the file.
+*
+* @retval false  a write or the flush failed
+**/
+/**************************************************************************{{{*/
+bool
+StreamSink::close()
+{
+    if (mFile != nullptr) {
+        if (fclose(mFile) != 0) {
+            mFailed = true;
+        }
+        mFile = nullptr;
+    }
+    return !mFailed;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* tar helpers
+* @par DESCRIPTION
+*   octal field and header checksum of ustar.
+**/
+/**************************************************************************{{{*/
+#define TAR_BLOCK   512
+
+static uint64_t
+tar_octal(const char* field, size_t len)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < len && field[i] >= '0' && field[i] <= '7'; i++) {
+        value = (value << 3) + (field[i] - '0');
+    }
+    return value;
+}
+
+static unsigned int
+tar_checksum(const char* header)
+{
+    unsigned int sum = 0;
+    for (int i = 0; i < TAR_BLOCK; i++) {
+        // the checksum field itself is counted as spaces
+        sum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(header[i]);
+    }
+    return sum;
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* constructor
+* @par DESCRIPTION
+*   open the archive. on resume, scan the entries of the archive and cut
+*   off everything after the last complete one.
+**/
+/**************************************************************************{{{*/
+TarSink::TarSink(const fs::path& path, bool resume)
+{
+    uint64_t end = 0;
+
+    if (resume && fs::exists(path)) {
+        uint64_t file_size = fs::file_size(path);
+
+        FILE* fp = fopen(path.string().c_str(), "rb");
+        if (fp != NULL) {
+            char header[TAR_BLOCK];
+            while (end + TAR_BLOCK <= file_size && fread(header, 1, TAR_BLOCK, fp) == TAR_BLOCK) {
+                if (header[0] == '\0' || tar_octal(header + 148, 8) != tar_checksum(header)) {
+                    break;  // end of archive or broken header
+                }
+
+                uint64_t size = tar_octal(header + 124, 12);
+                uint64_t next = end + TAR_BLOCK + (size + TAR_BLOCK - 1)/TAR_BLOCK*TAR_BLOCK;
+                if (next > file_size) {
+                    break;  // incomplete entry
+                }
+
+                mDone.insert(std::string(header, strnlen(header, 100)));
+                end = next;
+                fseek64(fp, end, SEEK_SET);
+            }
+            fclose(fp);
+        }
+
+        fs::resize_file(path, end);
+    }
+
+    open(path, end);
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* destructor
+* @par DESCRIPTION
+*   terminate the archive.
+**/
+/**************************************************************************{{{*/
+TarSink::~TarSink()
+{
+    TarSink::close();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* write image
+* @par DESCRIPTION
+*   append an ustar entry.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+bool
+TarSink::write(const std::string& name, const uint8_t* data, size_t size)
+{
+    static const time_t mtime = time(NULL);
+
+    char header[TAR_BLOCK];
+    memset(header, 0, sizeof(header));
+
+    strncpy(header, name.c_str(), 100);
+    sprintf(header + 100, "%07o", 0644);    // mode
+    sprintf(header + 108, "%07o", 0);       // uid
+    sprintf(header + 116, "%07o", 0);       // gid
+    sprintf(header + 124, "%011llo", static_cast<unsigned long long>(size));
+    sprintf(header + 136, "%011llo", static_cast<unsigned long long>(mtime));
+    header[156] = '0';                      // regular file
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+    sprintf(header + 148, "%06o", tar_checksum(header));
+    header[155] = ' ';
+
+    static const char padding[TAR_BLOCK] = { 0 };
+    size_t pad = (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+
+    return put(header, TAR_BLOCK) && put(data, size) && put(padding, pad);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* close archive
+* @par DESCRIPTION
+*   put the end-of-archive blocks. a broken archive is left without
+*   them, resume cuts off its tail.
+*
+* @retval false  the archive is broken
+**/
+/**************************************************************************{{{*/
+bool
+TarSink::close()
+{
+    if (mFile != nullptr) {
+        static const char eoa[2*TAR_BLOCK] = { 0 };
+        put(eoa, sizeof(eoa));
+    }
+    return StreamSink::close();
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* constructor
+* @par DESCRIPTION
+*   open the packed file and its index. on resume, keep the entries listed
+*   in the index and cut off the rest.
+**/
+/**************************************************************************{{{*/
+PackSink::PackSink(const fs::path& path, bool resume)
+    : mIndex(nullptr)
+{
+    fs::path index = path.string() + ".idx";
+    uint64_t end = 0;
+
+    if (resume && fs::exists(path) && fs::exists(index)) {
+        uint64_t file_size  = fs::file_size(path);
+        uint64_t index_size = 0;
+
+        std::ifstream in(index, std::ios::binary);
+        std::string line;
+        while (std::getline(in, line) && !in.eof()) {
+            std::istringstream fields(line);
+            std::string name;
+            uint64_t offset, size;
+            if (!(fields >> name >> offset >> size) || offset != end || offset + size > file_size) {
+                break;
+            }
+            mDone.insert(name);
+            end = offset + size;
+            index_size += line.size() + 1;
+        }
+        in.close();
+
+        fs::resize_file(path,  end);
+        fs::resize_file(index, index_size);
+    }
+
+    if (open(path, end)) {
+        mIndex = fopen(index.string().c_str(), (end == 0) ? "wb" : "ab");
+        if (mIndex == NULL) {
+            StreamSink::close();
+        }
+    }
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* destructor
+* @par DESCRIPTION
+*
+**/
+/**************************************************************************{{{*/
+PackSink::~PackSink()
+{
+    PackSink::close();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* write image
+* @par DESCRIPTION
+*   append the image and its index entry.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+bool
+PackSink::write(const std::string& name, const uint8_t* data, size_t size)
+{
+    uint64_t offset = mOffset;
+    if (!put(data, size)) {
+        return false;
+    }
+    if (fprintf(mIndex, "%s %llu %llu\n", name.c_str(), static_cast<unsigned long long>(offset), static_cast<unsigned long long>(size)) < 0) {
+        mFailed = true;
+        return false;
+    }
+
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* close packed file
+* @par DESCRIPTION
+*   the data is flushed before the index.
+*
+* @retval false  the data or the index is broken
+**/
+/**************************************************************************{{{*/
+bool
+PackSink::close()
+{
+    bool res = StreamSink::close();
+    if (mIndex != nullptr) {
+        res = (fclose(mIndex) == 0) && res;
+        mIndex = nullptr;
+    }
+    return res;
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* constructor
+* @par DESCRIPTION
+*   switch stdout to binary mode with a large buffer.
+**/
+/**************************************************************************{{{*/
+StdoutSink::StdoutSink()
+{
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    // stdout may be flushed at exit, so the buffer must live until then.
+    static char buffer[SINK_BUFFER_SIZE];
+    setvbuf(stdout, buffer, _IOFBF, sizeof(buffer));
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* write image
+* @par DESCRIPTION
+*   the images are concatenated on stdout, so the name is not used.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+bool
+StdoutSink::write(const std::string& /*name*/, const uint8_t* data, size_t size)
+{
+    return fwrite(data, 1, size, stdout) == size;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* close
+* @par DESCRIPTION
+*   flush the buffer, the reader may have gone away.
+*
+* @retval false  a write or the flush failed
+**/
+/**************************************************************************{{{*/
+bool
+StdoutSink::close()
+{
+    return fflush(stdout) == 0 && !ferror(stdout);
+}
+
+/*** output_sink.cpp ******************************************************}}}*/
@@ -0,0 +1,159 @@
+/***  File Header  ************************************************************/
+/**
+* @file output_sink.h
+*
+* Destinations of the encoded images.
+* @author   Shozo Fukuda
+* @date     create Fri Jul 14 16:48:02 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+#ifndef _OUTPUT_SINK_H
+#define _OUTPUT_SINK_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+/*--- CONSTANT ---*/
+#define SINK_BUFFER_SIZE    (4*1024*1024)   // stdio buffer of the stream sinks
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Output sink
+* @par DESCRIPTION
+*   receives the encoded images one by one. write() is called by one
+*   thread at a time. write() and close() return false when the data
+*   didn't reach the destination.
+**/
+/**************************************************************************{{{*/
+class OutputSink {
+//LIFECYCLE:
+public:
+    virtual ~OutputSink() {}
+
+    static OutputSink* create(const std::string& path, bool resume);
+
+//ACTION:
+public:
+    virtual bool write(const std::string& name, const uint8_t* data, size_t size) = 0;
+    virtual bool close() { return true; }
+
+//INQUIRY:
+public:
+    virtual bool good() const { return true; }
+
+    /* the image has been written by the previous (interrupted) run */
+    virtual bool exists(const std::string& name) { return mDone.count(name) != 0; }
+
+//ATTRIBUTE:
+protected:
+    std::set<std::string> mDone;
+};
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Directory sink
+* @par DESCRIPTION
+*   one file per image, written to "<name>.tmp" and renamed, so a file
+*   of the name is always complete.
+**/
+/**************************************************************************{{{*/
+class DirSink : public OutputSink {
+public:
+    DirSink(const fs::path& outdir, bool resume);
+
+    bool write(const std::string& name, const uint8_t* data, size_t size) override;
+    bool exists(const std::string& name) override;
+
+private:
+    fs::path mOutdir;
+    bool     mResume;
+};
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Stream sink
+* @par DESCRIPTION
+*   base of the sinks writing one sequential stream with a large buffer.
+**/
+/**************************************************************************{{{*/
+class StreamSink : public OutputSink {
+public:
+    StreamSink() : mFile(nullptr), mOffset(0), mFailed(false) {}
+    ~StreamSink();
+
+    bool close() override;
+    bool good() const override { return mFile != nullptr; }
+
+protected:
+    bool open(const fs::path& path, uint64_t offset);
+    bool put(const void* data, size_t size);
+
+    FILE*             mFile;
+    uint64_t          mOffset;      // current end of the stream
+    bool              mFailed;      // a write failed, the tail of the stream is broken
+    std::vector<char> mBuffer;
+};
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Tar sink
+* @par DESCRIPTION
+*   ustar archive. on resume, the complete entries are kept and the
+*   broken tail is cut off.
+**/
+/**************************************************************************{{{*/
+class TarSink : public StreamSink {
+public:
+    TarSink(const fs::path& path, bool resume);
+    ~TarSink();
+
+    bool write(const std::string& name, const uint8_t* data, size_t size) override;
+    bool close() override;
+};
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Pack sink
+* @par DESCRIPTION
+*   images are concatenated in <path>, and "<name> <offset> <size>" lines
+*   are appended to <path>.idx. on resume, the entries listed in the index
+*   are kept and the data file is cut after the last of them.
+**/
+/**************************************************************************{{{*/
+class PackSink : public StreamSink {
+public:
+    PackSink(const fs::path& path, bool resume);
+    ~PackSink();
+
+    bool write(const std::string& name, const uint8_t* data, size_t size) override;
+    bool close() override;
+
+private:
+    FILE* mIndex;
+};
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Stdout sink
+* @par DESCRIPTION
+*   images are concatenated to the standard output, e.g. raw/ppm frames
+*   for a downstream tool.
+**/
+/**************************************************************************{{{*/
+class StdoutSink : public OutputSink {
+public:
+    StdoutSink();
+
+    bool write(const std::string& name, const uint8_t* data, size_t size) override;
+    bool close() override;
+};
+
+#endif /* _OUTPUT_SINK_H */
+/*** output_sink.h ********************************************************}}}*/
@@ -0,0 +1,125 @@
+/***  File Header  ************************************************************/
+/**
+* @file seeds.cpp
+*
+* Seed list given by ranges.
+* @author   Shozo Fukuda
+* @date     create Tue Aug 15 11:02:19 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+
+#include <algorithm>
+
+#include "seeds.h"
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* add seeds
+* @par DESCRIPTION
+*   append the seeds 'first' to 'last'. nothing for 'first' > 'last'.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+Seeds::add(int first, int last)
+{
+    if (first > last) {
+        return;
+    }
+    mRanges.push_back({mSize, first, last});
+    mSize += size_t(int64_t(last) - first + 1);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* i-th seed
+* @par DESCRIPTION
+*   binary search of the range holding 'index'.
+*
+* @retval seed
+**/
+/**************************************************************************{{{*/
+int
+Seeds::operator[](size_t index) const
+{
+    auto range = std::upper_bound(mRanges.begin(), mRanges.end(), index,
+        [](size_t i, const Range& r) { return i < r.mPos; });
+    --range;
+    return int(range->mFirst + int64_t(index - range->mPos));
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* seed list
+* @par DESCRIPTION
+*   all the seeds one by one, for the short lists.
+*
+* @retval seeds
+**/
+/**************************************************************************{{{*/
+std::vector<int>
+Seeds::to_vector() const
+{
+    std::vector<int> seeds;
+    seeds.reserve(mSize);
+    for (const auto& range : mRanges) {
+        for (int64_t seed = range.mFirst; seed <= range.mLast; seed++) {
+            seeds.push_back(int(seed));
+        }
+    }
+    return seeds;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* parse seeds
+* @par DESCRIPTION
+*   comma separated seeds and ranges: "1,3,224-300".
+*
+* @retval seeds (throw std::invalid_argument on a bad number)
+**/
+/**************************************************************************{{{*/
+Seeds
+parse_seeds(const std::string& str)
+{
+    Seeds seeds;
+
+    if (str.empty()) {
+        return seeds;
+    }
+
+    size_t pos = std::string::size_type(0);
+    do {
+        std::string chunk;
+
+        // split to chunk
+        size_t end = str.find(',', pos);
+        if (end != std::string::npos) {
+            chunk = str.substr(pos, end - pos);
+            pos = end + 1;
+        }
+        else {
+            chunk = str.substr(pos);
+            pos = std::string::npos;
+        }
+
+        // translate seeds
+        size_t dash = chunk.find('-');
+        if (dash != std::string::npos) {
+            // range seeds
+            seeds.add(std::stoi(chunk.substr(0, dash)), std::stoi(chunk.substr(dash + 1)));
+        }
+        else {
+            // single seed
+            int seed = std::stoi(chunk);
+            seeds.add(seed, seed);
+        }
+    } while (pos != std::string::npos);
+
+    return seeds;
+}
+
+/*** seeds.cpp ************************************************************}}}*/
@@ -0,0 +1,62 @@
+/***  File Header  ************************************************************/
+/**
+* @file seeds.h
+*
+* Seed list given by ranges.
+* @author   Shozo Fukuda
+* @date     create Tue Aug 15 11:02:19 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+#ifndef _SEEDS_H
+#define _SEEDS_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Seeds
+* @par DESCRIPTION
+*   the seeds of "1,3,224-300" kept as the ranges, not one by one, so
+*   "0-9999999" costs the same as "0". the i-th seed is looked up from the
+*   ranges as it is consumed.
+**/
+/**************************************************************************{{{*/
+class Seeds {
+//LIFECYCLE:
+public:
+    Seeds() : mSize(0) {}
+
+//ACTION:
+public:
+    void add(int first, int last);
+
+//ACCESSOR:
+public:
+    int operator[](size_t index) const;
+    std::vector<int> to_vector() const;
+
+//INQUIRY:
+public:
+    size_t size() const { return mSize; }
+    bool   empty() const { return mSize == 0; }
+
+//ATTRIBUTE:
+private:
+    struct Range {
+        size_t mPos;        // index of the first seed
+        int    mFirst;
+        int    mLast;
+    };
+    std::vector<Range> mRanges;
+    size_t mSize;
+};
+
+/*--- EXTERNAL MODULE ---*/
+Seeds parse_seeds(const std::string& str);
+
+#endif /* _SEEDS_H */
+/*** seeds.h **************************************************************}}}*/
@@ -0,0 +1,763 @@
+/***  File Header  ************************************************************/
+/**
+* @file server.cpp
+*
+* Inference server with dynamic batching.
+* @author   Shozo Fukuda
+* @date     create Wed Jul 26 17:40:12 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+
+#pragma warning(disable : 4996)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <ctype.h>
+#include <errno.h>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <afunix.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET socket_t;
+#define close_socket closesocket
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <signal.h>
+typedef int socket_t;
+#define INVALID_SOCKET  (-1)
+#define close_socket    close
+#endif
+
+#include "image_conv.h"
+#include "server.h"
+
+/*--- CONSTANT ---*/
+#define HTTP_MAX_HEADER     (16*1024)
+#define HTTP_MAX_BODY       (64*1024*1024)
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* send all
+* @par DESCRIPTION
+*
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+static bool
+send_all(socket_t sock, const void* data, size_t size)
+{
+    const char* ptr = reinterpret_cast<const char*>(data);
+    while (size > 0) {
+        int n = send(sock, ptr, static_cast<int>(std::min<size_t>(size, 1 << 30)), 0);
+        if (n <= 0) {
+            return false;
+        }
+        ptr  += n;
+        size -= n;
+    }
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* send HTTP response
+* @par DESCRIPTION
+*
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+static bool
+send_response(socket_t sock, int status, const char* content_type, const void* body, size_t size, bool keep_alive)
+{
+    const char* reason;
+    switch (status) {
+    case 200: reason = "OK";                    break;
+    case 400: reason = "Bad Request";           break;
+    case 404: reason = "Not Found";             break;
+    case 413: reason = "Payload Too Large";     break;
+    default:  reason = "Internal Server Error"; break;
+    }
+
+    char header[256];
+    int len = snprintf(header, sizeof(header),
+        "HTTP/1.1 %d %s\r\n"
+        "Content-Type: %s\r\n"
+        "Content-Length: %llu\r\n"
+        "Connection: %s\r\n"
+        "\r\n",
+        status, reason, content_type, static_cast<unsigned long long>(size), keep_alive ? "keep-alive" : "close");
+
+    return send_all(sock, header, len) && send_all(sock, body, size);
+}
+
+static bool
+send_error(socket_t sock, int status, const std::string& message, bool keep_alive)
+{
+    std::string body = message + "\n";
+    return send_response(sock, status, "text/plain", body.data(), body.size(), keep_alive);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* query parameter
+* @par DESCRIPTION
+*   value of 'key' in "a=1&b=2". no percent-decoding, the values are
+*   numbers and names.
+*
+* @retval true  found
+**/
+/**************************************************************************{{{*/
+static bool
+query_param(const std::string& query, const std::string& key, std::string& value)
+{
+    size_t pos = 0;
+    while (pos < query.size()) {
+        size_t end = query.find('&', pos);
+        if (end == std::string::npos) {
+            end = query.size();
+        }
+        size_t eq = query.find('=', pos);
+        if (eq != std::string::npos && eq < end && query.compare(pos, eq - pos, key) == 0 && eq - pos == key.size()) {
+            value = query.substr(eq + 1, end - eq - 1);
+            return true;
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* parse number
+* @par DESCRIPTION
+*   decimal of "Content-Length" or the port, blanks around allowed. the
+*   sign, the junk and the values over 'max' are rejected, not thrown.
+*
+* @retval true  success
+* @retval false not a number in 0..max
+**/
+/**************************************************************************{{{*/
+static bool
+parse_number(const std::string& str, unsigned long long max, unsigned long long& n)
+{
+    const char* p = str.c_str();
+    while (isspace((unsigned char)*p)) {
+        p++;
+    }
+    if (!isdigit((unsigned char)*p)) {
+        return false;
+    }
+    char* tail;
+    errno = 0;
+    n = strtoull(p, &tail, 10);
+    while (isspace((unsigned char)*tail)) {
+        tail++;
+    }
+    return errno == 0 && *tail == '\0' && n <= max;
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* constructor
+* @par DESCRIPTION
+*   inspect the model: the mapping/synthesis split and the W average.
+**/
+/**************************************************************************{{{*/
+GenServer::GenServer(Tf2Interp& interp, const ServerOptions& options)
+    : mInterp(interp), mOptions(options), mDlatentSize(0), mLayers(0), mStop(false),
+      mRequests(0), mErrors(0), mBatches(0), mBatched(0)
+{
+    mOptions.mMaxBatch = std::max(1, mOptions.mMaxBatch);
+    mOptions.mMaxWait  = std::max(0, mOptions.mMaxWait);
+
+    mSplit = mInterp.has_signature("mapping") && mInterp.has_signature("synthesis");
+    if (mSplit) {
+        mInterp.select("synthesis");
+        const std::vector<int64_t>& shape = mInterp.input_shape(0);
+        mDlatentSize = 1;
+        for (size_t i = 1; i < shape.size(); i++) {
+            mDlatentSize *= shape[i];
+        }
+        mLayers = (shape.size() == 3) ? shape[1] : 1;
+        mCache.reset(new DlatentCache(mDlatentSize));
+
+        mWSpace = WSpace(mLayers, mDlatentSize/mLayers);
+        if (!WSpace::truncated_in_graph(mInterp)) {
+            mWSpace.load_avg(mInterp);
+        }
+    }
+    else {
+        mInterp.select(SIGNATURE_SERVING_DEFAULT);
+    }
+
+    mLatency.reserve(SERVER_LATENCY_SAMPLES);
+    mStart = std::chrono::steady_clock::now();
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* destructor
+* @par DESCRIPTION
+*   stop the batcher.
+**/
+/**************************************************************************{{{*/
+GenServer::~GenServer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mArrived.notify_all();
+    if (mBatcher.joinable()) {
+        mBatcher.join();
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* run server
+* @par DESCRIPTION
+*   listen on the endpoint and serve until the listener fails.
+*
+* @retval exit status
+**/
+/**************************************************************************{{{*/
+int
+GenServer::run()
+{
+#ifdef _WIN32
+    WSADATA wsa;
+    WSAStartup(MAKEWORD(2, 2), &wsa);
+#else
+    signal(SIGPIPE, SIG_IGN);   // a client may go away while we are sending
+#endif
+
+    // psi 1 must be the raw W, the psi of a request is the only truncation
+    if (mSplit && WSpace::truncated_in_graph(mInterp)) {
+        fprintf(stderr, "Error: the mapping signature of the model truncates W already, convert it again by pkl2savedmodel.py to serve.\n");
+        return 1;
+    }
+    if (!mSplit && mOptions.mPsi != PSI_NONE) {
+        fprintf(stderr, "Error: the model has no mapping and synthesis signatures for truncation.\n");
+        return 1;
+    }
+    // the seeds take DEFAULT_PSI without psi
+    if (mSplit && !mWSpace.has_avg()) {
+        fprintf(stderr, "Error: truncation is not available on this model\n");
+        return 1;
+    }
+
+    socket_t listener;
+    const std::string& endpoint = mOptions.mEndpoint;
+    if (endpoint.compare(0, 5, "unix:") == 0) {
+        std::string path = endpoint.substr(5);
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+            fprintf(stderr, "Error: bad socket path: %s\n", path.c_str());
+            return 1;
+        }
+        strcpy(addr.sun_path, path.c_str());
+        remove(path.c_str());
+
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener == INVALID_SOCKET || bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            fprintf(stderr, "Error: can't bind %s\n", endpoint.c_str());
+            if (listener != INVALID_SOCKET) {
+                close_socket(listener);
+            }
+            return 1;
+        }
+    }
+    else {
+        // "<port>" listens on the loopback only
+        size_t colon = endpoint.rfind(':');
+        std::string host = (colon == std::string::npos) ? "127.0.0.1" : endpoint.substr(0, colon);
+        unsigned long long port;
+        if (!parse_number((colon == std::string::npos) ? endpoint : endpoint.substr(colon + 1), 65535, port)) {
+            fprintf(stderr, "Error: bad port: %s\n", endpoint.c_str());
+            return 1;
+        }
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port   = htons(port);
+        if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+            fprintf(stderr, "Error: bad address: %s\n", host.c_str());
+            return 1;
+        }
+
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&on), sizeof(on));
+        if (listener == INVALID_SOCKET || bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            fprintf(stderr, "Error: can't bind %s\n", endpoint.c_str());
+            if (listener != INVALID_SOCKET) {
+                close_socket(listener);
+            }
+            return 1;
+        }
+    }
+    if (listen(listener, 64) != 0) {
+        fprintf(stderr, "Error: can't listen %s\n", endpoint.c_str());
+        close_socket(listener);
+        return 1;
+    }
+
+    mBatcher = std::thread(&GenServer::batcher, this);
+    fprintf(stderr, "serving on %s (max batch %d, max wait %d ms%s)\n",
+        endpoint.c_str(), mOptions.mMaxBatch, mOptions.mMaxWait, mWSpace.has_avg() ? ", truncation" : "");
+
+    // a failed accept is retried after a pause (e.g. out of descriptors),
+    // the listener failing again and again is given up
+    int failures = 0;
+    while (failures < SERVER_ACCEPT_RETRIES) {
+        socket_t sock = accept(listener, nullptr, nullptr);
+        if (sock == INVALID_SOCKET) {
+            failures++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        failures = 0;
+        std::thread(&GenServer::connection, this, static_cast<intptr_t>(sock)).detach();
+    }
+    fprintf(stderr, "Error: can't accept on %s\n", endpoint.c_str());
+
+    close_socket(listener);
+    return 1;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* connection thread
+* @par DESCRIPTION
+*   read the HTTP requests on the connection one after another.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+GenServer::connection(intptr_t client)
+{
+    socket_t sock = static_cast<socket_t>(client);
+    int on = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&on), sizeof(on));
+
+    std::string buff;
+    char chunk[16*1024];
+    for (;;) {
+        // header
+        size_t end;
+        while ((end = buff.find("\r\n\r\n")) == std::string::npos) {
+            if (buff.size() > HTTP_MAX_HEADER) {
+                send_error(sock, 400, "header too large", false);
+                close_socket(sock);
+                return;
+            }
+            int n = recv(sock, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                close_socket(sock);
+                return;
+            }
+            buff.append(chunk, n);
+        }
+        std::string header = buff.substr(0, end);
+        buff.erase(0, end + 4);
+
+        std::istringstream lines(header);
+        std::string method, target, version;
+        lines >> method >> target >> version;
+
+        unsigned long long content_length = 0;
+        bool keep_alive = (version == "HTTP/1.1");
+        std::string line;
+        std::getline(lines, line);
+        while (std::getline(lines, line)) {
+            std::string name = line.substr(0, line.find(':'));
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            std::string value = (line.find(':') == std::string::npos) ? "" : line.substr(line.find(':') + 1);
+            if (name == "content-length") {
+                if (!parse_number(value, ULLONG_MAX, content_length)) {
+                    send_error(sock, 400, "bad content-length", false);
+                    close_socket(sock);
+                    return;
+                }
+            }
+            else if (name == "connection") {
+                std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+                keep_alive = value.find("close") == std::string::npos && (keep_alive || value.find("keep-alive") != std::string::npos);
+            }
+        }
+        if (content_length > HTTP_MAX_BODY) {
+            send_error(sock, 413, "body too large", false);
+            break;
+        }
+
+        // body
+        while (buff.size() < content_length) {
+            int n = recv(sock, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                close_socket(sock);
+                return;
+            }
+            buff.append(chunk, n);
+        }
+        std::string body = buff.substr(0, content_length);
+        buff.erase(0, content_length);
+
+        if (!handle(sock, method, target, body, keep_alive) || !keep_alive) {
+            break;
+        }
+    }
+    close_socket(sock);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* handle request
+* @par DESCRIPTION
+*   queue the generation to the batcher, wait for the images and encode
+*   the response on this thread.
+*
+* @retval true  the connection can be kept
+**/
+/**************************************************************************{{{*/
+bool
+GenServer::handle(intptr_t client, const std::string& method, const std::string& target, const std::string& body, bool keep_alive)
+{
+    socket_t sock = static_cast<socket_t>(client);
+
+    size_t qmark = target.find('?');
+    std::string path  = target.substr(0, qmark);
+    std::string query = (qmark == std::string::npos) ? "" : target.substr(qmark + 1);
+
+    if (path == "/stats" && method == "GET") {
+        std::string json = stats();
+        return send_response(sock, 200, "application/json", json.data(), json.size(), keep_alive);
+    }
+    if (path != "/generate" || (method != "GET" && method != "POST")) {
+        return send_error(sock, 404, "no such endpoint", keep_alive);
+    }
+
+    auto request = std::make_shared<Request>();
+    request->arrival = std::chrono::steady_clock::now();
+    request->seed = 0;
+    request->psi  = mOptions.mPsi;
+    request->cutoff = mOptions.mTruncCutoff;
+
+    ImageFormat format = mOptions.mFormat;
+    std::string value;
+    try {
+        if (query_param(query, "format", value) && !format.parse(value)) {
+            return send_error(sock, 400, "unknown format: " + value, keep_alive);
+        }
+        if (query_param(query, "quality", value)) {
+            format.mQuality = std::min(std::max(std::stoi(value), 1), 100);
+        }
+        if (query_param(query, "psi", value)) {
+            request->psi = std::stof(value);
+            if (!(request->psi >= 0.0f)) {
+                return send_error(sock, 400, "bad psi", keep_alive);
+            }
+        }
+        if (query_param(query, "cutoff", value)) {
+            request->cutoff = std::max(0, std::stoi(value));
+        }
+        if (request->psi != PSI_NONE && !mSplit) {
+            return send_error(sock, 400, "the model has no mapping and synthesis signatures for truncation", keep_alive);
+        }
+
+        if (method == "POST") {
+            if (!mSplit) {
+                return send_error(sock, 400, "the model has no synthesis signature", keep_alive);
+            }
+            if (body.size() != mDlatentSize*sizeof(float)) {
+                return send_error(sock, 400, "dlatent must be " + std::to_string(mDlatentSize) + " float32", keep_alive);
+            }
+            request->dlatent.resize(mDlatentSize);
+            memcpy(request->dlatent.data(), body.data(), body.size());
+            if (request->psi == PSI_NONE) {
+                request->psi = 1.0f;
+            }
+        }
+        else if (query_param(query, "seed", value)) {
+            request->seed = std::stoi(value);
+            if (request->psi == PSI_NONE) {
+                request->psi = mSplit ? DEFAULT_PSI : 1.0f;
+            }
+        }
+        else {
+            return send_error(sock, 400, "needs seed", keep_alive);
+        }
+    }
+    catch (std::exception&) {
+        return send_error(sock, 400, "bad parameter", keep_alive);
+    }
+
+    std::future<Result> future = request->result.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQueue.push_back(request);
+    }
+    mArrived.notify_one();
+
+    Result result = future.get();
+    if (!result.images) {
+        record(0.0, true);
+        return send_error(sock, 500, result.error, keep_alive);
+    }
+
+    TensorView images(result.images.get());
+    int height = images.dim(2);
+    int width  = images.dim(3);
+    std::vector<uint8_t> rgb(size_t(3)*height*width);
+    nchw_to_hwc_u8(images.data<float>(result.batch_index), rgb.data(), 3, height, width);
+    result.images.reset();
+
+    std::vector<uint8_t> encoded;
+    format.encode(rgb.data(), height, width, encoded);
+
+    std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - request->arrival;
+    record(latency.count(), false);
+
+    const char* content_type;
+    switch (format.mType) {
+    case ImageFormat::FORMAT_PNG: content_type = "image/png";                 break;
+    case ImageFormat::FORMAT_PPM: content_type = "image/x-portable-pixmap";   break;
+    case ImageFormat::FORMAT_RAW: content_type = "application/octet-stream";  break;
+    default:                      content_type = "image/jpeg";                break;
+    }
+    return send_response(sock, 200, content_type, encoded.data(), encoded.size(), keep_alive);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* batcher thread
+* @par DESCRIPTION
+*   wait for a request, then gather the others up to max batch until the
+*   first one has waited max wait. under load the batches fill up at once,
+*   when idle a single request waits max wait at most.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+GenServer::batcher()
+{
+    std::vector<std::shared_ptr<Request>> batch;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mArrived.wait(lock, [&]{ return !mQueue.empty() || mStop; });
+            if (mStop) {
+                break;
+            }
+
+            auto deadline = mQueue.front()->arrival + std::chrono::milliseconds(mOptions.mMaxWait);
+            mArrived.wait_until(lock, deadline, [&]{ return mQueue.size() >= size_t(mOptions.mMaxBatch) || mStop; });
+
+            size_t count = std::min(mQueue.size(), size_t(mOptions.mMaxBatch));
+            batch.assign(mQueue.begin(), mQueue.begin() + count);
+            mQueue.erase(mQueue.begin(), mQueue.begin() + count);
+        }
+
+        process(batch);
+        batch.clear();
+    }
+
+    // let the waiting connections go
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto& request : mQueue) {
+        request->result.set_value(Result{ nullptr, 0, "server stopped" });
+    }
+    mQueue.clear();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* process batch
+* @par DESCRIPTION
+*   seeds -> (mapping, cached) -> W -> truncation -> synthesis.
+*   without the split signatures, the seeds go through serving_default.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+GenServer::process(std::vector<std::shared_ptr<Request>>& batch)
+{
+    int count = batch.size();
+
+    /*SUBROUTINE*/
+    auto latent_size = [&]() -> size_t {
+        const std::vector<int64_t>& shape = mInterp.input_shape(0);
+        return (shape.size() == 2) ? shape[1] : 512;
+    };
+    /**/
+
+    try {
+        std::vector<float> input;
+        if (mSplit) {
+            input.resize(count*mDlatentSize);
+
+            std::vector<int> miss;
+            for (int k = 0; k < count; k++) {
+                float* w = &input[k*mDlatentSize];
+                if (!batch[k]->dlatent.empty()) {
+                    std::copy(batch[k]->dlatent.begin(), batch[k]->dlatent.end(), w);
+                }
+                else if (!mCache->find(batch[k]->seed, w)) {
+                    miss.push_back(k);
+                }
+            }
+
+            if (!miss.empty()) {
+                mInterp.select("mapping");
+                mInterp.set_batch_size(miss.size());
+
+                size_t z_size = latent_size();
+                std::vector<float> z(miss.size()*z_size);
+                for (size_t m = 0; m < miss.size(); m++) {
+                    mOptions.mSampler(batch[miss[m]]->seed, &z[m*z_size], z_size);
+                }
+                mInterp.set_input_tensor(0, reinterpret_cast<uint8_t*>(z.data()), z.size()*sizeof(float));
+                if (!mInterp.invoke() || mInterp.output_view(0).empty()) {
+                    throw std::runtime_error("mapping failed");
+                }
+
+                TensorView dlatents = mInterp.output_view(0);
+                for (size_t m = 0; m < miss.size(); m++) {
+                    float* w = &input[miss[m]*mDlatentSize];
+                    std::copy_n(dlatents.data<float>(m), mDlatentSize, w);
+                    mCache->insert(batch[miss[m]]->seed, w);
+                }
+            }
+
+            // truncation toward the average W
+            for (int k = 0; k < count; k++) {
+                mWSpace.truncate(&input[k*mDlatentSize], 1, batch[k]->psi, batch[k]->cutoff);
+            }
+
+            mInterp.select("synthesis");
+        }
+        else {
+            size_t z_size = latent_size();
+            input.resize(count*z_size);
+            for (int k = 0; k < count; k++) {
+                mOptions.mSampler(batch[k]->seed, &input[k*z_size], z_size);
+            }
+        }
+
+        mInterp.set_batch_size(count);
+        mInterp.set_input_tensor(0, reinterpret_cast<uint8_t*>(input.data()), input.size()*sizeof(float));
+        if (!mInterp.invoke()) {
+            throw std::runtime_error("synthesis failed");
+        }
+
+        std::shared_ptr<TF_Tensor> images = mInterp.take_output_tensor(0);
+        if (!images) {
+            throw std::runtime_error("synthesis failed");
+        }
+        for (int k = 0; k < count; k++) {
+            batch[k]->result.set_value(Result{ images, k, "" });
+        }
+    }
+    catch (std::exception& e) {
+        for (auto& request : batch) {
+            request->result.set_value(Result{ nullptr, 0, e.what() });
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mStatMutex);
+    mBatches++;
+    mBatched += count;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* record latency
+* @par DESCRIPTION
+*   keep the last SERVER_LATENCY_SAMPLES latencies.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+GenServer::record(double latency_ms, bool error)
+{
+    std::lock_guard<std::mutex> lock(mStatMutex);
+    if (error) {
+        mErrors++;
+        return;
+    }
+    if (mLatency.size() < SERVER_LATENCY_SAMPLES) {
+        mLatency.push_back(latency_ms);
+    }
+    else {
+        mLatency[mRequests % SERVER_LATENCY_SAMPLES] = latency_ms;
+    }
+    mRequests++;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* statistics
+* @par DESCRIPTION
+*   latency in msec from the arrival to the encoded response.
+*
+* @retval json text
+**/
+/**************************************************************************{{{*/
+std::string
+GenServer::stats()
+{
+    size_t depth;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        depth = mQueue.size();
+    }
+
+    std::lock_guard<std::mutex> lock(mStatMutex);
+
+    std::vector<double> latency = mLatency;
+    std::sort(latency.begin(), latency.end());
+    auto percentile = [&](double p) {
+        return latency.empty() ? 0.0 : latency[size_t(p*(latency.size() - 1) + 0.5)];
+    };
+
+    std::chrono::duration<double> uptime = std::chrono::steady_clock::now() - mStart;
+
+    json res;
+    res["uptime_s"]    = uptime.count();
+    res["requests"]    = mRequests;
+    res["errors"]      = mErrors;
+    res["queue_depth"] = depth;
+    res["batches"]     = mBatches;
+    res["mean_batch"]  = mBatches ? double(mBatched)/mBatches : 0.0;
+    res["latency_ms"]["samples"] = latency.size();
+    res["latency_ms"]["p50"] = percentile(0.50);
+    res["latency_ms"]["p99"] = percentile(0.99);
+    res["latency_ms"]["max"] = latency.empty() ? 0.0 : latency.back();
+
+    return res.dump() + "\n";
+}
+
+/*** server.cpp ***********************************************************}}}*/
@@ -0,0 +1,130 @@
+/***  File Header  ************************************************************/
+/**
+* @file server.h
+*
+* Inference server with dynamic batching.
+* @author   Shozo Fukuda
+* @date     create Wed Jul 26 17:40:12 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+#ifndef _SERVER_H
+#define _SERVER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
+#include "tf2/tf2_interp.h"
+#include "image_writer.h"
+#include "dlatent_cache.h"
+#include "wspace.h"
+
+/*--- CONSTANT ---*/
+#define SERVER_LATENCY_SAMPLES  4096    // latencies kept for the percentiles
+#define SERVER_ACCEPT_RETRIES   100     // accept failures in a row before giving up
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Server options
+* @par DESCRIPTION
+*
+**/
+/**************************************************************************{{{*/
+struct ServerOptions {
+    ServerOptions() : mMaxBatch(8), mMaxWait(5), mPsi(PSI_NONE), mTruncCutoff(0) {}
+
+    std::string mEndpoint;      // "<host>:<port>", "<port>" or "unix:<path>"
+    int         mMaxBatch;      // requests in a batch
+    int         mMaxWait;       // msec the first request of a batch waits for others
+    ImageFormat mFormat;        // default of the response
+    float       mPsi;           // truncation, PSI_NONE for DEFAULT_PSI on the seeds
+    int         mTruncCutoff;   // default layers to truncate, 0 for all
+    std::function<void(int, float*, size_t)> mSampler;   // seed -> latent of the size
+};
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Generator server
+* @par DESCRIPTION
+*   serves the generator over HTTP/1.1 on localhost TCP or a Unix socket:
+*     GET  /generate?seed=<n>[&psi=<f>][&cutoff=<n>][&format=jpg|png|ppm|raw]
+*     POST /generate[?psi=<f>][&cutoff=<n>][&format=...]   body: float32 W [layers,components]
+*     GET  /stats    latency percentiles, queue depth and batch statistics
+*   a thread per connection parses the requests and encodes the responses,
+*   and one batcher thread owns the session. the batcher groups the queued
+*   requests up to max batch, or as many as have come within max wait.
+**/
+/**************************************************************************{{{*/
+class GenServer {
+//LIFECYCLE:
+public:
+    GenServer(Tf2Interp& interp, const ServerOptions& options);
+    virtual ~GenServer();
+
+//ACTION:
+public:
+    int run();
+
+private:
+    struct Result {
+        std::shared_ptr<TF_Tensor> images;
+        int         batch_index;
+        std::string error;
+    };
+
+    struct Request {
+        int                seed;        // used without dlatent
+        std::vector<float> dlatent;
+        float              psi;         // truncation, PSI_NONE for the default
+        int                cutoff;      // layers to truncate, 0 for all
+        std::chrono::steady_clock::time_point arrival;
+        std::promise<Result> result;
+    };
+
+    void batcher();
+    void process(std::vector<std::shared_ptr<Request>>& batch);
+    void connection(intptr_t client);
+    bool handle(intptr_t client, const std::string& method, const std::string& target, const std::string& body, bool keep_alive);
+    void record(double latency_ms, bool error);
+    std::string stats();
+
+//ATTRIBUTE:
+private:
+    Tf2Interp&    mInterp;
+    ServerOptions mOptions;
+
+    bool   mSplit;              // mapping and synthesis signatures
+    size_t mDlatentSize;
+    int    mLayers;
+    WSpace mWSpace;             // no average: truncation not available
+    std::unique_ptr<DlatentCache> mCache;
+
+    // requests waiting for the batcher
+    std::mutex              mMutex;
+    std::condition_variable mArrived;
+    std::deque<std::shared_ptr<Request>> mQueue;
+    bool                    mStop;
+    std::thread             mBatcher;
+
+    // statistics
+    std::mutex          mStatMutex;
+    std::vector<double> mLatency;       // ring buffer in msec
+    uint64_t            mRequests;
+    uint64_t            mErrors;
+    uint64_t            mBatches;
+    uint64_t            mBatched;       // requests processed in batches
+    std::chrono::steady_clock::time_point mStart;
+};
+
+#endif /* _SERVER_H */
+/*** server.h *************************************************************}}}*/
@@ -0,0 +1,238 @@
+/***  File Header  ************************************************************/
+/**
+* @file stylemix.cpp
+*
+* Style mixing grid renderer.
+* @author   Shozo Fukuda
+* @date     create Mon Aug 21 09:37:05 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+
+#pragma warning(disable : 4996)
+
+#include <stdio.h>
+#include <limits.h>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+#include "stb_image_write.h"
+
+#include "image_conv.h"
+#include "dlatent_cache.h"
+#include "stylemix.h"
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* constructor
+* @par DESCRIPTION
+*
+**/
+/**************************************************************************{{{*/
+StyleMix::StyleMix(Tf2Interp& interp, const StyleMixOptions& options)
+    : mInterp(interp), mOptions(options)
+{
+    mOptions.mBatch = std::max(1, mOptions.mBatch);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* render grid
+* @par DESCRIPTION
+*   map the seeds, synthesize the cells into the canvas and write it to
+*   'sink'. the conversion of a batch to the canvas runs while the next
+*   batch is synthesized.
+*
+* @retval exit status
+**/
+/**************************************************************************{{{*/
+int
+StyleMix::run(const ImageFormat& format, OutputSink* sink)
+{
+    if (!mInterp.has_signature("mapping") || !mInterp.has_signature("synthesis")) {
+        fprintf(stderr, "Error: the model has no mapping and synthesis signatures for style mixing.\n");
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    mInterp.select("synthesis");
+    std::vector<int64_t> wshape = mInterp.input_shape(0);
+    int layers = (wshape.size() == 3) ? wshape[1] : 1;
+    size_t dlatent_size = 1;
+    for (size_t i = 1; i < wshape.size(); i++) {
+        dlatent_size *= wshape[i];
+    }
+    size_t components = dlatent_size/layers;
+
+    mWSpace = WSpace(layers, components);
+    float psi = mapping_psi(mInterp, mOptions.mPsi);
+    if (psi == PSI_NONE) {
+        return 1;
+    }
+    if (psi != 1.0f && !mWSpace.load_avg(mInterp)) {
+        fprintf(stderr, "Error: truncation is not available on this model.\n");
+        return 1;
+    }
+    for (int layer : mOptions.mStyles) {
+        if (layer < 0 || layer >= layers) {
+            fprintf(stderr, "Error: no style layer %d, the model has %d.\n", layer, layers);
+            return 1;
+        }
+    }
+
+    // the seeds of the rows and the columns are mapped once
+    std::vector<int> seeds(mOptions.mRows);
+    seeds.insert(seeds.end(), mOptions.mCols.begin(), mOptions.mCols.end());
+    std::sort(seeds.begin(), seeds.end());
+    seeds.erase(std::unique(seeds.begin(), seeds.end()), seeds.end());
+
+    std::vector<float> w(seeds.size()*dlatent_size);
+    DlatentCache cache(dlatent_size, mOptions.mWCacheDir);
+    if (!mWSpace.map_seeds(mInterp, mPool, cache, mOptions.mSampler, seeds, w.data(), mOptions.mBatch)) {
+        fprintf(stderr, "Error: mapping failed.\n");
+        return 1;
+    }
+    mWSpace.truncate(w.data(), seeds.size(), psi, mOptions.mTruncCutoff);
+
+    /*SUBROUTINE*/
+    auto w_of = [&](int seed) {
+        return &w[(std::lower_bound(seeds.begin(), seeds.end(), seed) - seeds.begin())*dlatent_size];
+    };
+    /**/
+
+    // the cells: the top row and the left column are the seeds alone
+    struct Cell {
+        int          row, col;      // tile on the canvas
+        const float* w;
+        const float* styles;        // W of the column seed, nullptr for none
+    };
+    int rows = mOptions.mRows.size();
+    int cols = mOptions.mCols.size();
+    std::vector<Cell> cells;
+    cells.reserve(size_t(rows + 1)*(cols + 1));
+    for (int j = 0; j < cols; j++) {
+        cells.push_back({0, j + 1, w_of(mOptions.mCols[j]), nullptr});
+    }
+    for (int i = 0; i < rows; i++) {
+        cells.push_back({i + 1, 0, w_of(mOptions.mRows[i]), nullptr});
+        for (int j = 0; j < cols; j++) {
+            cells.push_back({i + 1, j + 1, w_of(mOptions.mRows[i]), w_of(mOptions.mCols[j])});
+        }
+    }
+
+    std::vector<uint8_t> canvas;    // header + [rows+1, cols+1] tiles of RGB
+    size_t header_size = 0;
+    int tile_h = 0, tile_w = 0;
+    size_t stride = 0;
+
+    std::thread converter;
+    try {
+        mInterp.select("synthesis");
+        for (size_t first = 0; first < cells.size(); first += mOptions.mBatch) {
+            size_t count = std::min(cells.size() - first, size_t(mOptions.mBatch));
+
+            wshape[0] = count;
+            TensorPtr wbatch = mPool.acquire(TF_FLOAT, wshape);
+            if (!wbatch) {
+                throw std::bad_alloc();
+            }
+            float* wb = reinterpret_cast<float*>(TF_TensorData(wbatch.get()));
+            for (size_t k = 0; k < count; k++) {
+                const Cell& cell = cells[first + k];
+                float* wk = &wb[k*dlatent_size];
+                std::copy_n(cell.w, dlatent_size, wk);
+                if (cell.styles != nullptr) {
+                    for (int layer : mOptions.mStyles) {
+                        std::copy_n(&cell.styles[layer*components], components, &wk[layer*components]);
+                    }
+                }
+            }
+            if (mInterp.set_input_tensor(0, std::move(wbatch)) < 0 || !mInterp.invoke()) {
+                throw std::runtime_error("synthesis failed");
+            }
+            std::shared_ptr<TF_Tensor> images = mInterp.take_output_tensor(0);
+            if (!images) {
+                throw std::runtime_error("synthesis failed");
+            }
+
+            if (canvas.empty()) {
+                TensorView view(images.get());
+                tile_h = view.dim(2);
+                tile_w = view.dim(3);
+                int height = tile_h*(rows + 1);
+                int width  = tile_w*(cols + 1);
+                std::string header = format.header(height, width);
+                header_size = header.size();
+                stride = size_t(3)*width;
+                canvas.resize(header_size + stride*height);
+                std::copy(header.begin(), header.end(), canvas.begin());
+            }
+
+            if (converter.joinable()) {
+                converter.join();
+            }
+            converter = std::thread([&, images, first, count]() {
+                TensorView view(images.get());
+                for (size_t k = 0; k < count; k++) {
+                    const Cell& cell = cells[first + k];
+                    uint8_t* tile = &canvas[header_size + size_t(cell.row)*tile_h*stride + size_t(cell.col)*tile_w*3];
+                    nchw_to_hwc_u8_tile(view.data<float>(k), tile, stride, 3, tile_h, tile_w);
+                }
+            });
+        }
+        if (converter.joinable()) {
+            converter.join();
+        }
+    }
+    catch (std::bad_alloc&) {
+        if (converter.joinable()) {
+            converter.join();
+        }
+        fprintf(stderr, "Error: out of memory for the grid.\n");
+        return 1;
+    }
+    catch (std::exception& e) {
+        if (converter.joinable()) {
+            converter.join();
+        }
+        fprintf(stderr, "Error: %s\n", e.what());
+        return 1;
+    }
+
+    int height = tile_h*(rows + 1);
+    int width  = tile_w*(cols + 1);
+    std::string name = std::string("grid") + format.ext();
+    bool written;
+    if (format.mType == ImageFormat::FORMAT_PPM || format.mType == ImageFormat::FORMAT_RAW) {
+        // the canvas is the file
+        written = sink->write(name, canvas.data(), canvas.size());
+    }
+    else {
+        if (format.mType == ImageFormat::FORMAT_JPEG && (height > 65535 || width > 65535)) {
+            fprintf(stderr, "Error: the grid of %dx%d is too large for JPEG, use -f png, ppm or raw.\n", width, height);
+            return 1;
+        }
+        if (format.mType == ImageFormat::FORMAT_PNG && stride*height > size_t(INT_MAX)) {
+            fprintf(stderr, "Error: the grid of %dx%d is too large for PNG, use -f ppm or raw.\n", width, height);
+            return 1;
+        }
+        stbi_write_png_compression_level = format.mPngLevel;
+
+        std::vector<uint8_t> encoded;
+        format.encode(canvas.data(), height, width, encoded);
+        written = sink->write(name, encoded.data(), encoded.size());
+    }
+    if (!written) {
+        fprintf(stderr, "Error: can't write %s\n", name.c_str());
+        return 1;
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "stylemix: %dx%d grid, %zu images, %dx%d pixels, %.2f s\n",
+        rows, cols, cells.size(), width, height, elapsed);
+    return 0;
+}
+
+/*** stylemix.cpp *********************************************************}}}*/
@@ -0,0 +1,78 @@
+/***  File Header  ************************************************************/
+/**
+* @file stylemix.h
+*
+* Style mixing grid renderer.
+* @author   Shozo Fukuda
+* @date     create Mon Aug 21 09:37:05 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+#ifndef _STYLEMIX_H
+#define _STYLEMIX_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <functional>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+#include "tf2/tf2_interp.h"
+#include "tf2/tensor_pool.h"
+#include "image_writer.h"
+#include "output_sink.h"
+#include "wspace.h"
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Style mixing options
+* @par DESCRIPTION
+*
+**/
+/**************************************************************************{{{*/
+struct StyleMixOptions {
+    StyleMixOptions() : mBatch(4), mPsi(PSI_NONE), mTruncCutoff(0) {}
+
+    std::vector<int> mRows;         // seeds of the rows
+    std::vector<int> mCols;         // seeds of the columns
+    std::vector<int> mStyles;       // layers taken from the column seeds
+    int         mBatch;             // images per synthesis run
+    float       mPsi;               // truncation, PSI_NONE for DEFAULT_PSI
+    int         mTruncCutoff;       // layers to truncate, 0 for all
+    fs::path    mWCacheDir;         // W of the seeds, empty for none
+    std::function<void(int, float*, size_t)> mSampler;   // seed -> latent of the size
+};
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* Style mixing grid
+* @par DESCRIPTION
+*   renders the grid of style_mixing.py: the column seeds on the top row,
+*   the row seeds on the left column and, in the cell, the W of the row
+*   seed with the style layers of the column seed. the seeds are mapped
+*   once, the cells are synthesized in batches and each image is converted
+*   straight into its tile of one canvas, which is encoded as "grid". the
+*   canvas of PPM/raw has the header in front, so it is written as it is.
+**/
+/**************************************************************************{{{*/
+class StyleMix {
+//LIFECYCLE:
+public:
+    StyleMix(Tf2Interp& interp, const StyleMixOptions& options);
+
+//ACTION:
+public:
+    int run(const ImageFormat& format, OutputSink* sink);
+
+//ATTRIBUTE:
+private:
+    Tf2Interp&      mInterp;
+    StyleMixOptions mOptions;
+    TensorPool      mPool;
+    WSpace          mWSpace;
+};
+
+#endif /* _STYLEMIX_H */
+/*** stylemix.h ***********************************************************}}}*/
@@ -0,0 +1,375 @@
+/***  File Header  ************************************************************/
+/**
+* @file wspace.cpp
+*
+* Operations on the intermediate latents W (dlatents).
+* @author   Shozo Fukuda
+* @date     create Fri Aug 18 10:14:52 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+* The truncation and the lerp run over the components with AVX2 or SSE2 if
+* they are enabled at compile time; the others fall back to the scalar
+* loop, which gives the same results.
+**/
+/**************************************************************************{{{*/
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include "tf2/tf2_interp.h"
+#include "wspace.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define WSPACE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WSPACE_SSE2
+#endif
+
+/* avg + psi*(w - avg) must not be fused into FMA: it is rounded as the
+*  NumPy of style_mixing.py and the lerp of the graph do.
+*/
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+/* the variable of W average: resource variable or reference variable */
+static const char* DLATENT_AVG_TENSORS[] = {
+    "Gs/dlatent_avg/Read/ReadVariableOp:0",
+    "Gs/dlatent_avg:0",
+};
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* lerp toward average
+* @par DESCRIPTION
+*   w[i] = avg[i] + psi*(w[i] - avg[i]) for the 'n' components of a layer.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+static void
+lerp_avg(float* w, const float* avg, float psi, size_t n)
+{
+    size_t i = 0;
+#if defined(WSPACE_AVX2)
+    __m256 vpsi = _mm256_set1_ps(psi);
+    for (; i + 8 <= n; i += 8) {
+        __m256 a = _mm256_loadu_ps(&avg[i]);
+        __m256 d = _mm256_sub_ps(_mm256_loadu_ps(&w[i]), a);
+        _mm256_storeu_ps(&w[i], _mm256_add_ps(a, _mm256_mul_ps(vpsi, d)));
+    }
+#elif defined(WSPACE_SSE2)
+    __m128 vpsi = _mm_set1_ps(psi);
+    for (; i + 4 <= n; i += 4) {
+        __m128 a = _mm_loadu_ps(&avg[i]);
+        __m128 d = _mm_sub_ps(_mm_loadu_ps(&w[i]), a);
+        _mm_storeu_ps(&w[i], _mm_add_ps(a, _mm_mul_ps(vpsi, d)));
+    }
+#endif
+    for (; i < n; i++) {
+        w[i] = avg[i] + psi*(w[i] - avg[i]);
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* lerp
+* @par DESCRIPTION
+*   out[i] = a[i] + t*(b[i] - a[i]) for 'n' elements, as tflib.lerp.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+static void
+lerp_span(const float* a, const float* b, float t, float* out, size_t n)
+{
+    size_t i = 0;
+#if defined(WSPACE_AVX2)
+    __m256 vt = _mm256_set1_ps(t);
+    for (; i + 8 <= n; i += 8) {
+        __m256 va = _mm256_loadu_ps(&a[i]);
+        __m256 d  = _mm256_sub_ps(_mm256_loadu_ps(&b[i]), va);
+        _mm256_storeu_ps(&out[i], _mm256_add_ps(va, _mm256_mul_ps(vt, d)));
+    }
+#elif defined(WSPACE_SSE2)
+    __m128 vt = _mm_set1_ps(t);
+    for (; i + 4 <= n; i += 4) {
+        __m128 va = _mm_loadu_ps(&a[i]);
+        __m128 d  = _mm_sub_ps(_mm_loadu_ps(&b[i]), va);
+        _mm_storeu_ps(&out[i], _mm_add_ps(va, _mm_mul_ps(vt, d)));
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = a[i] + t*(b[i] - a[i]);
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* load W average
+* @par DESCRIPTION
+*   fetch dlatent_avg, the moving average of W tracked in the training,
+*   from the model. the model whose mapping signature outputs the W
+*   truncated in the graph has none, a psi on it would be compounded.
+*
+* @retval true  success
+* @retval false the model has no average of this shape, or truncates W
+**/
+/**************************************************************************{{{*/
+bool
+WSpace::load_avg(Tf2Interp& interp)
+{
+    if (truncated_in_graph(interp)) {
+        fprintf(stderr, "Warning: the mapping signature of the model truncates W already, convert it again by pkl2savedmodel.py to use psi.\n");
+        return false;
+    }
+
+    for (auto name : DLATENT_AVG_TENSORS) {
+        TensorPtr avg = interp.fetch(name);
+        if (avg && TF_TensorType(avg.get()) == TF_FLOAT && TensorView(avg.get()).count() == mComponents) {
+            const float* data = TensorView(avg.get()).data<float>();
+            mAvg.assign(data, data + mComponents);
+            return true;
+        }
+    }
+    return false;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* W truncated in the graph
+* @par DESCRIPTION
+*   the former pkl2savedmodel.py exported the mapping signature with the
+*   truncation_psi 0.5 of G_main in it, its W is not the raw W.
+*
+* @retval true  the mapping outputs the truncated W
+* @retval false otherwise
+**/
+/**************************************************************************{{{*/
+bool
+WSpace::truncated_in_graph(const Tf2Interp& interp)
+{
+    return interp.output_name("mapping", 0).find("/Truncation/") != std::string::npos;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* map latents
+* @par DESCRIPTION
+*   run the mapping signature on the latents 'z' [count, latent] and copy
+*   the W to 'w' [count, layers, components].
+*
+* @retval true  success
+* @retval false mapping failed
+**/
+/**************************************************************************{{{*/
+bool
+WSpace::map(Tf2Interp& interp, TensorPtr z, float* w) const
+{
+    size_t count = TF_Dim(z.get(), 0);
+
+    interp.select("mapping");
+    if (interp.set_input_tensor(0, std::move(z)) < 0 || !interp.invoke()) {
+        return false;
+    }
+    TensorView dlatents = interp.output_view(0);
+    if (dlatents.empty() || dlatents.count() != count*dlatent_size()) {
+        return false;
+    }
+    std::copy_n(dlatents.data<float>(), count*dlatent_size(), w);
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* map seeds
+* @par DESCRIPTION
+*   W of the 'seeds' into 'w' [seeds, layers, components]. the mapping
+*   network runs in batches of 'batch' on the seeds missing in the cache.
+*
+* @retval true  success
+* @retval false mapping failed
+**/
+/**************************************************************************{{{*/
+bool
+WSpace::map_seeds(Tf2Interp& interp, TensorPool& pool, DlatentCache& cache, const std::function<void(int, float*, size_t)>& sampler,
+                  const std::vector<int>& seeds, float* w, int batch) const
+{
+    size_t size = dlatent_size();
+
+    std::vector<size_t> miss;
+    for (size_t i = 0; i < seeds.size(); i++) {
+        if (!cache.find(seeds[i], &w[i*size])) {
+            miss.push_back(i);
+        }
+    }
+
+    interp.select("mapping");
+    std::vector<int64_t> zshape = interp.input_shape(0);
+    size_t latent_size = 1;
+    for (size_t i = 1; i < zshape.size(); i++) {
+        latent_size *= zshape[i];
+    }
+
+    std::vector<float> wmiss;
+    for (size_t first = 0; first < miss.size(); first += batch) {
+        size_t count = std::min(miss.size() - first, size_t(std::max(1, batch)));
+
+        zshape[0] = count;
+        TensorPtr z = pool.acquire(TF_FLOAT, zshape);
+        if (!z) {
+            return false;
+        }
+        float* latents = reinterpret_cast<float*>(TF_TensorData(z.get()));
+        for (size_t k = 0; k < count; k++) {
+            sampler(seeds[miss[first + k]], &latents[k*latent_size], latent_size);
+        }
+
+        wmiss.resize(count*size);
+        if (!map(interp, std::move(z), wmiss.data())) {
+            return false;
+        }
+        for (size_t k = 0; k < count; k++) {
+            float* wk = &w[miss[first + k]*size];
+            std::copy_n(&wmiss[k*size], size, wk);
+            cache.insert(seeds[miss[first + k]], wk);
+        }
+    }
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* truncation trick
+* @par DESCRIPTION
+*   pull the 'count' W of 'w' toward the average by 'psi' in place. only
+*   the first 'cutoff' layers are truncated, all of them for 0.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+WSpace::truncate(float* w, size_t count, float psi, int cutoff) const
+{
+    if (psi == 1.0f || mAvg.empty()) {
+        return;
+    }
+    int layers = (cutoff > 0) ? std::min(cutoff, mLayers) : mLayers;
+    for (size_t k = 0; k < count; k++) {
+        float* row = &w[k*dlatent_size()];
+        for (int l = 0; l < layers; l++) {
+            lerp_avg(&row[l*mComponents], mAvg.data(), psi, mComponents);
+        }
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* lerp W
+* @par DESCRIPTION
+*   the W at 't' from 'a' (0.0) to 'b' (1.0).
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+WSpace::lerp(const float* a, const float* b, float t, float* out) const
+{
+    lerp_span(a, b, t, out, dlatent_size());
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* slerp
+* @par DESCRIPTION
+*   spherical interpolation of the 'n' latents at 't' from 'a' to 'b'. the
+*   Gaussian latents keep their norm on the way, which the lerp loses in
+*   the middle. the nearly parallel ones fall back to the lerp.
+*
+* @retval none
+**/
+/**************************************************************************{{{*/
+void
+slerp(const float* a, const float* b, float t, float* out, size_t n)
+{
+    double dot = 0.0, norm_a = 0.0, norm_b = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        dot    += double(a[i])*b[i];
+        norm_a += double(a[i])*a[i];
+        norm_b += double(b[i])*b[i];
+    }
+    double cos_omega = (norm_a > 0.0 && norm_b > 0.0) ? dot/sqrt(norm_a*norm_b) : 1.0;
+    cos_omega = std::min(std::max(cos_omega, -1.0), 1.0);
+    double omega = acos(cos_omega);
+    double sin_omega = sin(omega);
+    if (sin_omega < 1e-6) {
+        lerp_span(a, b, t, out, n);
+        return;
+    }
+
+    float ka = float(sin((1.0 - t)*omega)/sin_omega);
+    float kb = float(sin(t*omega)/sin_omega);
+    for (size_t i = 0; i < n; i++) {
+        out[i] = ka*a[i] + kb*b[i];
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* psi on the mapped W
+* @par DESCRIPTION
+*   the psi to apply on the W of the mapping signature for the 'psi'
+*   given, DEFAULT_PSI for PSI_NONE. the model truncating W in the graph
+*   has applied DEFAULT_PSI already, so it takes no other psi.
+*
+* @retval psi to apply, 1.0 for none
+* @retval PSI_NONE  the model can't render the psi
+**/
+/**************************************************************************{{{*/
+float
+mapping_psi(const Tf2Interp& interp, float psi)
+{
+    if (!WSpace::truncated_in_graph(interp)) {
+        return (psi == PSI_NONE) ? DEFAULT_PSI : psi;
+    }
+    if (psi != PSI_NONE) {
+        fprintf(stderr, "Error: the mapping signature of the model truncates W by psi %g already, convert it again by pkl2savedmodel.py to use psi.\n", DEFAULT_PSI);
+        return PSI_NONE;
+    }
+    return 1.0f;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* parse psi
+* @par DESCRIPTION
+*   comma separated psi: "0.5" or "0.3,0.5,0.7,1". psi is 0 or more.
+*
+* @retval psi list (throw std::invalid_argument on a bad number)
+**/
+/**************************************************************************{{{*/
+std::vector<float>
+parse_psi(const std::string& str)
+{
+    std::vector<float> psi;
+
+    size_t pos = 0;
+    while (pos <= str.size()) {
+        size_t end = str.find(',', pos);
+        if (end == std::string::npos) {
+            end = str.size();
+        }
+        psi.push_back(std::stof(str.substr(pos, end - pos)));
+        if (!(psi.back() >= 0.0f)) {
+            throw std::invalid_argument("psi");
+        }
+        pos = end + 1;
+    }
+    return psi;
+}
+
+/*** wspace.cpp ***********************************************************}}}*/
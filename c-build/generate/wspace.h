@@ -0,0 +1,74 @@
+/***  File Header  ************************************************************/
+/**
+* @file wspace.h
+*
+* Operations on the intermediate latents W (dlatents).
+* @author   Shozo Fukuda
+* @date     create Fri Aug 18 10:14:52 JST 2023
+* System    Windows10, WSL2/Ubuntu 20.04.2<br>
+*
+**/
+/**************************************************************************{{{*/
+#ifndef _WSPACE_H
+#define _WSPACE_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "tf2/tf2_interp.h"
+#include "tf2/tensor_pool.h"
+#include "dlatent_cache.h"
+
+/*--- CONSTANT ---*/
+#define PSI_NONE        (-1.0f)     // no psi given
+#define DEFAULT_PSI     0.5f        // on the W of the seeds without psi, as generate.py and style_mixing.py
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* W space
+* @par DESCRIPTION
+*   the W of [N, layers, components] between the mapping and the synthesis
+*   network. the truncation trick pulls W toward the average W of the model
+*   layer by layer, as the Truncation scope of G_mapping does, so a psi is
+*   applied to the W from the cache without running the mapping again.
+*   W is interpolated linearly, the latents Z on the sphere (slerp).
+**/
+/**************************************************************************{{{*/
+class WSpace {
+//LIFECYCLE:
+public:
+    WSpace(int layers = 1, size_t components = 0) : mLayers(layers), mComponents(components) {}
+
+//ACTION:
+public:
+    bool load_avg(Tf2Interp& interp);
+    bool map(Tf2Interp& interp, TensorPtr z, float* w) const;
+    bool map_seeds(Tf2Interp& interp, TensorPool& pool, DlatentCache& cache, const std::function<void(int, float*, size_t)>& sampler,
+                   const std::vector<int>& seeds, float* w, int batch) const;
+    void truncate(float* w, size_t count, float psi, int cutoff = 0) const;
+    void lerp(const float* a, const float* b, float t, float* out) const;
+
+//INQUIRY:
+public:
+    int    layers() const { return mLayers; }
+    size_t components() const { return mComponents; }
+    size_t dlatent_size() const { return mLayers*mComponents; }
+    bool   has_avg() const { return !mAvg.empty(); }
+    static bool truncated_in_graph(const Tf2Interp& interp);
+
+//ATTRIBUTE:
+private:
+    int    mLayers;
+    size_t mComponents;
+    std::vector<float> mAvg;    // [components], shared by the layers
+};
+
+/*--- EXTERNAL MODULE ---*/
+std::vector<float> parse_psi(const std::string& str);
+float mapping_psi(const Tf2Interp& interp, float psi);
+void slerp(const float* a, const float* b, float t, float* out, size_t n);
+
+#endif /* _WSPACE_H */
+/*** wspace.h *************************************************************}}}*/
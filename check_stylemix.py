@@ -0,0 +1,94 @@
+#!/usr/local/bin/python
+# -*- coding: utf-8 -*-
+################################################################################
+# check_stylemix.py
+# Description:  parity of the C++ style mixing grid with style_mixing.py
+#
+# Author:       shozo fukuda
+# Date:         Tue Aug 29 10:21:36 2023
+# Last revised: $Date$
+# Application:  Python 3
+################################################################################
+
+#<IMPORT>
+import os
+import subprocess
+import argparse
+
+#<SUBROUTINE>###################################################################
+# Function:     read PPM
+# Description:  binary PPM (P6) of 8bit RGB to [height, width, 3] array
+# Dependencies:
+################################################################################
+def read_ppm(path):
+    with open(path, "rb") as fp:
+        data = fp.read()
+    fields = []
+    pos = 0
+    while len(fields) < 4:
+        while data[pos:pos+1].isspace():
+            pos += 1
+        end = pos
+        while not data[end:end+1].isspace():
+            end += 1
+        fields.append(data[pos:end])
+        pos = end
+    if fields[0] != b"P6" or int(fields[3]) != 255:
+        raise ValueError("not 8bit P6 PPM: %s" %(path))
+    width, height = int(fields[1]), int(fields[2])
+    return np.frombuffer(data, np.uint8, height*width*3, pos + 1).reshape(height, width, 3)
+
+#<SUBROUTINE>###################################################################
+# Function:     compare grids
+# Description:  per pixel difference of the C++ grid 'out' to the grid 'ref'
+#               of style_mixing.py, both [height, width, 3]
+# Dependencies:
+################################################################################
+def compare(ref, out, tolerance):
+    if ref.shape != out.shape:
+        print("Error: the grid is %s, style_mixing.py %s." %(out.shape, ref.shape))
+        return False
+    diff = np.abs(ref.astype(np.int32) - out.astype(np.int32))
+    over = np.count_nonzero(diff > tolerance)
+    print("max diff: %d, mean diff: %.4f, pixels over %d: %d" %(diff.max(), diff.mean(), tolerance, over))
+    return over == 0
+
+#<TEST>#########################################################################
+# Function:     command line
+# Description:  one seed pair by both, the grids must match within 'tolerance'
+# Dependencies:
+################################################################################
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description="Compare the style mixing grid of c-build/generate with style_mixing.py")
+    parser.add_argument('--network', required=True, help="network pickle")
+    parser.add_argument('--model', required=True, help="saved_model converted from it by pkl2savedmodel.py")
+    parser.add_argument('--generate', default="c-build/generate/generate", help="C++ generator (default: %(default)s)")
+    parser.add_argument('--row', type=int, default=85, help="seed of the row (default: %(default)s)")
+    parser.add_argument('--col', type=int, default=55, help="seed of the column (default: %(default)s)")
+    parser.add_argument('--styles', default="0-6", help="style layers (default: %(default)s)")
+    parser.add_argument('--trunc', type=float, default=0.5, help="truncation psi (default: %(default)s)")
+    parser.add_argument('--tolerance', type=int, default=1, help="allowed difference per pixel (default: %(default)s)")
+    parser.add_argument('--outdir', default="out_check_stylemix", help="work directory (default: %(default)s)")
+    args = parser.parse_args()
+
+    import numpy as np
+    import PIL.Image
+    import style_mixing
+
+    # Reference by the pickle
+    ref_dir = os.path.join(args.outdir, "py")
+    style_mixing.style_mixing_example(args.network, [args.row], [args.col], args.trunc,
+        style_mixing._parse_num_range(args.styles), ref_dir)
+    ref = np.asarray(PIL.Image.open(os.path.join(ref_dir, "grid.png")).convert("RGB"))
+
+    # C++ by the saved_model, PPM to skip the PNG codec
+    out_dir = os.path.join(args.outdir, "cpp")
+    subprocess.run([args.generate, "--rows", str(args.row), "--cols", str(args.col), "--styles", args.styles,
+        "--trunc", str(args.trunc), "-f", "ppm", args.model, out_dir], check=True)
+    out = read_ppm(os.path.join(out_dir, "grid.ppm"))
+
+    if compare(ref, out, args.tolerance):
+        print("OK: the grids match.")
+    else:
+        print("NG: the grids differ.")
+        exit(1)
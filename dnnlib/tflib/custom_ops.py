@@ -28,6 +28,7 @@ cuda_cache_path = None
 cuda_cache_version_tag = 'v1'
 do_not_hash_included_headers = True # Speed up compilation by assuming that headers included by the CUDA code never change.
 verbose = True # Print status messages to stdout.
+cpu_arch_options = '-march=native' # Instruction set of the CPU plugins; e.g. '-mavx2 -mfma' for a plugin shared by several CPU types.
 
 #----------------------------------------------------------------------------
 # Internal helper funcs.
@@ -87,10 +88,23 @@ def _prepare_nvcc_cli(opts):
     cmd += ' 2>&1'
     return cmd
 
+def _prepare_cxx_cli(opts):
+    if os.name == 'nt':
+        compiler_bindir = _find_compiler_bindir()
+        if compiler_bindir is None:
+            raise RuntimeError('Could not find MSVC installation on this computer. Check compiler_bindir_search_path list in "%s".' % __file__)
+        cmd = '"%s" /nologo /LD /O2 /EHsc /std:c++17 /DNOMINMAX ' % os.path.join(compiler_bindir, 'cl.exe') + opts.strip()
+        cmd += ' /I"%s"' % tf.sysconfig.get_include()
+    else:
+        cmd = 'g++ -std=c++17 -shared -fPIC -O3 ' + opts.strip()
+    cmd += ' 2>&1'
+    return cmd
+
 #----------------------------------------------------------------------------
 # Main entry point.
 
 _plugin_cache = dict()
+_plugin_path = dict()
 
 def get_plugin(cuda_file, extra_nvcc_options=[]):
     cuda_file_base = os.path.basename(cuda_file)
@@ -169,6 +183,82 @@ def get_plugin(cuda_file, extra_nvcc_options=[]):
 
         # Add to cache.
         _plugin_cache[cuda_file] = plugin
+        _plugin_path[cuda_file] = bin_file
+        if verbose:
+            print('Done.', flush=True)
+        return plugin
+
+    except:
+        if verbose:
+            print('Failed!', flush=True)
+        raise
+
+#----------------------------------------------------------------------------
+# CPU plugins: the same caching as the CUDA ones, built by the host compiler.
+
+def get_cpu_plugin(cpp_file, extra_cxx_options=[]):
+    cpp_file_base = os.path.basename(cpp_file)
+    cpp_file_name, _cpp_file_ext = os.path.splitext(cpp_file_base)
+
+    # Already in cache?
+    if cpp_file in _plugin_cache:
+        return _plugin_cache[cpp_file]
+
+    # Setup plugin.
+    if verbose:
+        print('Setting up TensorFlow CPU plugin "%s": ' % cpp_file_base, end='', flush=True)
+    try:
+        # Hash the source and the headers next to it (cpu_simd.h etc.).
+        md5 = hashlib.md5()
+        with open(cpp_file, 'rb') as f:
+            md5.update(f.read())
+        for header in sorted(glob.glob(os.path.join(os.path.dirname(cpp_file), '*.h'))):
+            with open(header, 'rb') as f:
+                md5.update(f.read())
+        md5.update(b'\n')
+
+        # Select compiler options.
+        if os.name == 'nt':
+            compile_opts = '/arch:AVX2 "%s"' % os.path.join(tf.sysconfig.get_lib(), 'python', '_pywrap_tensorflow_internal.lib')
+        elif os.name == 'posix':
+            compile_opts = cpu_arch_options + ' ' + ' '.join(tf.sysconfig.get_compile_flags())
+        else:
+            assert False # not Windows or Linux, w00t?
+        for opt in extra_cxx_options:
+            compile_opts += ' ' + opt
+        cxx_cmd = _prepare_cxx_cli(compile_opts)
+
+        # Hash build configuration.
+        md5.update(('cxx_cmd: ' + cxx_cmd).encode('utf-8') + b'\n')
+        md5.update(('tf.VERSION: ' + tf.version.VERSION).encode('utf-8') + b'\n')
+        md5.update(('cuda_cache_version_tag: ' + cuda_cache_version_tag).encode('utf-8') + b'\n')
+
+        # Compile if not already compiled.
+        cache_dir = util.make_cache_dir_path('tflib-cudacache') if cuda_cache_path is None else cuda_cache_path
+        bin_file_ext = '.dll' if os.name == 'nt' else '.so'
+        bin_file = os.path.join(cache_dir, cpp_file_name + '_' + md5.hexdigest() + bin_file_ext)
+        if not os.path.isfile(bin_file):
+            if verbose:
+                print('Compiling... ', end='', flush=True)
+            with tempfile.TemporaryDirectory() as tmp_dir:
+                tmp_file = os.path.join(tmp_dir, cpp_file_name + '_tmp' + bin_file_ext)
+                if os.name == 'nt':
+                    _run_cmd(cxx_cmd + ' "%s" /Fe"%s" /Fo"%s\\"' % (cpp_file, tmp_file, tmp_dir))
+                else:
+                    _run_cmd(cxx_cmd + ' "%s" -o "%s" %s' % (cpp_file, tmp_file, ' '.join(tf.sysconfig.get_link_flags())))
+                os.makedirs(cache_dir, exist_ok=True)
+                intermediate_file = os.path.join(cache_dir, cpp_file_name + '_' + uuid.uuid4().hex + '_tmp' + bin_file_ext)
+                shutil.copyfile(tmp_file, intermediate_file)
+                os.rename(intermediate_file, bin_file) # atomic
+
+        # Load.
+        if verbose:
+            print('Loading... ', end='', flush=True)
+        plugin = tf.load_op_library(bin_file)
+
+        # Add to cache.
+        _plugin_cache[cpp_file] = plugin
+        _plugin_path[cpp_file] = bin_file
         if verbose:
             print('Done.', flush=True)
         return plugin
@@ -179,3 +269,10 @@ def get_plugin(cuda_file, extra_nvcc_options=[]):
         raise
 
 #----------------------------------------------------------------------------
+# Binaries of the plugins loaded so far, e.g. to ship them with a SavedModel
+# for the C++ loader.
+
+def get_plugin_paths():
+    return list(_plugin_path.values())
+
+#----------------------------------------------------------------------------
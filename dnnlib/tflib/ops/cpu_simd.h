@@ -0,0 +1,116 @@
+// cpu_simd.h
+// Thin SIMD layer shared by the CPU kernels of the custom ops.
+//
+// One vector type per build: AVX-512 when the compiler targets it, else
+// AVX2+FMA, else a plain float. The kernels are written once against the
+// v*() functions and get the widest vector of the build. custom_ops
+// builds the CPU plugins with -march=native by default.
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+//------------------------------------------------------------------------
+// Vector type.
+
+#if defined(__AVX512F__)
+
+typedef __m512 vfloat;
+static const int VLEN = 16;
+
+static inline vfloat vset1(float a)                     { return _mm512_set1_ps(a); }
+static inline vfloat vload(const float* p)              { return _mm512_loadu_ps(p); }
+static inline void   vstore(float* p, vfloat a)         { _mm512_storeu_ps(p, a); }
+static inline vfloat vadd(vfloat a, vfloat b)           { return _mm512_add_ps(a, b); }
+static inline vfloat vsub(vfloat a, vfloat b)           { return _mm512_sub_ps(a, b); }
+static inline vfloat vmul(vfloat a, vfloat b)           { return _mm512_mul_ps(a, b); }
+static inline vfloat vdiv(vfloat a, vfloat b)           { return _mm512_div_ps(a, b); }
+static inline vfloat vfmadd(vfloat a, vfloat b, vfloat c) { return _mm512_fmadd_ps(a, b, c); }
+static inline vfloat vmax(vfloat a, vfloat b)           { return _mm512_max_ps(a, b); }
+static inline vfloat vmin(vfloat a, vfloat b)           { return _mm512_min_ps(a, b); }
+static inline vfloat vfloor(vfloat a)                   { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+static inline vfloat vgt(vfloat a, vfloat b, vfloat t, vfloat f) { return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(a, b, _CMP_GT_OQ), f, t); }
+static inline vfloat vge(vfloat a, vfloat b, vfloat t, vfloat f) { return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(a, b, _CMP_GE_OQ), f, t); }
+static inline vfloat vpow2i(vfloat n)   // 2^n for integral n in the normal range
+{
+    return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_add_epi32(_mm512_cvttps_epi32(n), _mm512_set1_epi32(127)), 23));
+}
+
+#elif defined(__AVX2__)
+
+typedef __m256 vfloat;
+static const int VLEN = 8;
+
+static inline vfloat vset1(float a)                     { return _mm256_set1_ps(a); }
+static inline vfloat vload(const float* p)              { return _mm256_loadu_ps(p); }
+static inline void   vstore(float* p, vfloat a)         { _mm256_storeu_ps(p, a); }
+static inline vfloat vadd(vfloat a, vfloat b)           { return _mm256_add_ps(a, b); }
+static inline vfloat vsub(vfloat a, vfloat b)           { return _mm256_sub_ps(a, b); }
+static inline vfloat vmul(vfloat a, vfloat b)           { return _mm256_mul_ps(a, b); }
+static inline vfloat vdiv(vfloat a, vfloat b)           { return _mm256_div_ps(a, b); }
+#if defined(__FMA__)
+static inline vfloat vfmadd(vfloat a, vfloat b, vfloat c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+static inline vfloat vfmadd(vfloat a, vfloat b, vfloat c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+static inline vfloat vmax(vfloat a, vfloat b)           { return _mm256_max_ps(a, b); }
+static inline vfloat vmin(vfloat a, vfloat b)           { return _mm256_min_ps(a, b); }
+static inline vfloat vfloor(vfloat a)                   { return _mm256_floor_ps(a); }
+static inline vfloat vgt(vfloat a, vfloat b, vfloat t, vfloat f) { return _mm256_blendv_ps(f, t, _mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+static inline vfloat vge(vfloat a, vfloat b, vfloat t, vfloat f) { return _mm256_blendv_ps(f, t, _mm256_cmp_ps(a, b, _CMP_GE_OQ)); }
+static inline vfloat vpow2i(vfloat n)
+{
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(127)), 23));
+}
+
+#else
+
+typedef float vfloat;
+static const int VLEN = 1;
+
+static inline vfloat vset1(float a)                     { return a; }
+static inline vfloat vload(const float* p)              { return *p; }
+static inline void   vstore(float* p, vfloat a)         { *p = a; }
+static inline vfloat vadd(vfloat a, vfloat b)           { return a + b; }
+static inline vfloat vsub(vfloat a, vfloat b)           { return a - b; }
+static inline vfloat vmul(vfloat a, vfloat b)           { return a * b; }
+static inline vfloat vdiv(vfloat a, vfloat b)           { return a / b; }
+static inline vfloat vfmadd(vfloat a, vfloat b, vfloat c) { return a * b + c; }
+static inline vfloat vmax(vfloat a, vfloat b)           { return (a > b) ? a : b; }
+static inline vfloat vmin(vfloat a, vfloat b)           { return (a < b) ? a : b; }
+static inline vfloat vfloor(vfloat a)                   { return floorf(a); }
+static inline vfloat vgt(vfloat a, vfloat b, vfloat t, vfloat f) { return (a > b) ? t : f; }
+static inline vfloat vge(vfloat a, vfloat b, vfloat t, vfloat f) { return (a >= b) ? t : f; }
+static inline vfloat vpow2i(vfloat n)                   { return ldexpf(1.0f, (int)n); }
+
+#endif
+
+//------------------------------------------------------------------------
+// exp(x), Cephes expf: range reduction by ln2 and a degree 5 polynomial.
+// Relative error about 2 ulp; the arguments are clamped to the float range.
+
+static inline vfloat vexp(vfloat x)
+{
+    x = vmin(vmax(x, vset1(-87.3365f)), vset1(88.0f));
+
+    vfloat n = vfloor(vfmadd(x, vset1(1.44269504088896341f), vset1(0.5f)));
+    x = vsub(x, vmul(n, vset1(0.693359375f)));
+    x = vsub(x, vmul(n, vset1(-2.12194440e-4f)));
+
+    vfloat y = vset1(1.9875691500e-4f);
+    y = vfmadd(y, x, vset1(1.3981999507e-3f));
+    y = vfmadd(y, x, vset1(8.3334519073e-3f));
+    y = vfmadd(y, x, vset1(4.1665795894e-2f));
+    y = vfmadd(y, x, vset1(1.6666665459e-1f));
+    y = vfmadd(y, x, vset1(5.0000001201e-1f));
+    y = vfmadd(y, vmul(x, x), vadd(x, vset1(1.0f)));
+
+    return vmul(y, vpow2i(n));
+}
+
+//------------------------------------------------------------------------
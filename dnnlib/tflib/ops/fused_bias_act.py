@@ -17,6 +17,9 @@ from ...util import EasyDict
 def _get_plugin():
     return custom_ops.get_plugin(os.path.splitext(__file__)[0] + '.cu')
 
+def _get_cpu_plugin():
+    return custom_ops.get_cpu_plugin(os.path.splitext(__file__)[0] + '_cpu.cc')
+
 #----------------------------------------------------------------------------
 
 activation_funcs = {
@@ -59,7 +62,8 @@ def fused_bias_act(x, b=None, axis=1, act='linear', alpha=None, gain=None, clamp
                 If unsure, consider specifying `1.0`.
         clamp:  Clamp the output values to `[-clamp, +clamp]`, or `None` to disable
                 the clamping (default).
-        impl:   Name of the implementation to use. Can be `"ref"` or `"cuda"` (default).
+        impl:   Name of the implementation to use. Can be `"ref"`, `"cuda"` (default)
+                or `"cpu"`, the same op built for the CPU.
 
     Returns:
         Tensor of the same shape and datatype as `x`.
@@ -68,6 +72,7 @@ def fused_bias_act(x, b=None, axis=1, act='linear', alpha=None, gain=None, clamp
     impl_dict = {
         'ref':  _fused_bias_act_ref,
         'cuda': _fused_bias_act_cuda,
+        'cpu':  _fused_bias_act_cpu,
     }
     impl = which_impl(impl)
     return impl_dict[impl](x=x, b=b, axis=axis, act=act, alpha=alpha, gain=gain, clamp=clamp)
@@ -108,7 +113,13 @@ def _fused_bias_act_ref(x, b, axis, act, alpha, gain, clamp):
 
 #----------------------------------------------------------------------------
 
-def _fused_bias_act_cuda(x, b, axis, act, alpha, gain, clamp):
+def _fused_bias_act_cpu(x, b, axis, act, alpha, gain, clamp):
+    """CPU implementation of `fused_bias_act()`, the CUDA op built for the CPU."""
+    return _fused_bias_act_cuda(x=x, b=b, axis=axis, act=act, alpha=alpha, gain=gain, clamp=clamp, get_plugin=_get_cpu_plugin)
+
+#----------------------------------------------------------------------------
+
+def _fused_bias_act_cuda(x, b, axis, act, alpha, gain, clamp, get_plugin=_get_plugin):
     """Fast CUDA implementation of `fused_bias_act()` using custom ops."""
 
     # Validate arguments.
@@ -130,7 +141,7 @@ def _fused_bias_act_cuda(x, b, axis, act, alpha, gain, clamp):
         return _fused_bias_act_ref(x=x, b=b, axis=axis, act=act, alpha=alpha, gain=gain, clamp=clamp)
 
     # CUDA op.
-    cuda_op = _get_plugin().fused_bias_act
+    cuda_op = get_plugin().fused_bias_act
     cuda_kwargs = dict(axis=int(axis), act=int(act_spec.cuda_idx), gain=float(gain))
     if alpha is not None:
         cuda_kwargs['alpha'] = float(alpha)
@@ -0,0 +1,351 @@
+// fused_bias_act_cpu.cc
+// CPU kernel of FusedBiasAct, the counterpart of fused_bias_act.cu.
+//
+// The op registration is the same as the CUDA one, so a graph built with
+// impl='cpu' and one built with impl='cuda' have the same nodes. Load
+// only one of the two plugins in a process: both register the op.
+
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "cpu_simd.h"
+
+using namespace tensorflow;
+using namespace tensorflow::shape_inference;
+
+//------------------------------------------------------------------------
+// CPU kernel.
+
+struct FusedBiasActKernelParams
+{
+    int         grad;
+    int         axis;
+    int         act;
+    float       alpha;
+    float       gain;
+    float       clamp;
+};
+
+// One element, the same as the CUDA kernel. For the cases without a
+// vector path: the gradients and softplus.
+static inline float fusedBiasActScalar(const FusedBiasActKernelParams& p, float x, float xref, float yref)
+{
+    const float expRange        = 80.0f;
+    const float halfExpRange    = 40.0f;
+    const float seluScale       = 1.0507009873554804934193349852946f;
+    const float seluAlpha       = 1.6732632423543772848170429916717f;
+
+    float yy = (p.gain != 0.0f) ? yref / p.gain : 0.0f;
+
+    // Evaluate activation func.
+    float y;
+    switch (p.act * 10 + p.grad)
+    {
+        // linear
+        default:
+        case 10: y = x; break;
+        case 11: y = x; break;
+        case 12: y = 0.0f; break;
+
+        // relu
+        case 20: y = (x > 0.0f) ? x : 0.0f; break;
+        case 21: y = (yy > 0.0f) ? x : 0.0f; break;
+        case 22: y = 0.0f; break;
+
+        // lrelu
+        case 30: y = (x > 0.0f) ? x : x * p.alpha; break;
+        case 31: y = (yy > 0.0f) ? x : x * p.alpha; break;
+        case 32: y = 0.0f; break;
+
+        // tanh
+        case 40: { float c = expf(x); float d = 1.0f / c; y = (x < -expRange) ? -1.0f : (x > expRange) ? 1.0f : (c - d) / (c + d); } break;
+        case 41: y = x * (1.0f - yy * yy); break;
+        case 42: y = x * (1.0f - yy * yy) * (-2.0f * yy); break;
+
+        // sigmoid
+        case 50: y = (x < -expRange) ? 0.0f : 1.0f / (expf(-x) + 1.0f); break;
+        case 51: y = x * yy * (1.0f - yy); break;
+        case 52: y = x * yy * (1.0f - yy) * (1.0f - 2.0f * yy); break;
+
+        // elu
+        case 60: y = (x >= 0.0f) ? x : expf(x) - 1.0f; break;
+        case 61: y = (yy >= 0.0f) ? x : x * (yy + 1.0f); break;
+        case 62: y = (yy >= 0.0f) ? 0.0f : x * (yy + 1.0f); break;
+
+        // selu
+        case 70: y = (x >= 0.0f) ? seluScale * x : (seluScale * seluAlpha) * (expf(x) - 1.0f); break;
+        case 71: y = (yy >= 0.0f) ? x * seluScale : x * (yy + seluScale * seluAlpha); break;
+        case 72: y = (yy >= 0.0f) ? 0.0f : x * (yy + seluScale * seluAlpha); break;
+
+        // softplus
+        case 80: y = (x > expRange) ? x : logf(expf(x) + 1.0f); break;
+        case 81: y = x * (1.0f - expf(-yy)); break;
+        case 82: { float c = expf(-yy); y = x * c * (1.0f - c); } break;
+
+        // swish
+        case 90: y = (x < -expRange) ? 0.0f : x / (expf(-x) + 1.0f); break;
+        case 91:
+        case 92:
+            {
+                float c = expf(xref);
+                float d = c + 1.0f;
+                if (p.grad == 1)
+                    y = (xref > halfExpRange) ? x : x * c * (xref + d) / (d * d);
+                else
+                    y = (xref > halfExpRange) ? 0.0f : x * c * (xref * (2.0f - d) + 2.0f * d) / (d * d * d);
+                yref = (xref < -expRange) ? 0.0f : xref / (expf(-xref) + 1.0f) * p.gain;
+            }
+            break;
+    }
+
+    // Apply gain.
+    y *= p.gain;
+
+    // Clamp.
+    if (p.clamp >= 0.0f)
+    {
+        if (p.grad == 0)
+            y = (fabsf(y) < p.clamp) ? y : (y >= 0.0f) ? p.clamp : -p.clamp;
+        else
+            y = (fabsf(yref) < p.clamp) ? y : 0.0f;
+    }
+    return y;
+}
+
+// Forward pass of a vector: bias, activation, gain and clamp in registers.
+template <int ACT>
+static inline vfloat fusedBiasActVector(const FusedBiasActKernelParams& p, vfloat x)
+{
+    const vfloat zero = vset1(0.0f);
+    const vfloat one  = vset1(1.0f);
+    const float seluScale = 1.0507009873554804934193349852946f;
+    const float seluAlpha = 1.6732632423543772848170429916717f;
+
+    vfloat y;
+    switch (ACT)
+    {
+        default:
+        case 1: y = x; break;                                                   // linear
+        case 2: y = vmax(x, zero); break;                                       // relu
+        case 3: y = vgt(x, zero, x, vmul(x, vset1(p.alpha))); break;            // lrelu
+        case 4: {                                                               // tanh
+                // tanh saturates to +-1 in float beyond |x| = 9
+                vfloat e = vexp(vmul(vmin(vmax(x, vset1(-9.0f)), vset1(9.0f)), vset1(2.0f)));
+                y = vdiv(vsub(e, one), vadd(e, one));
+            } break;
+        case 5:                                                                 // sigmoid
+            y = vgt(vset1(-80.0f), x, zero, vdiv(one, vadd(vexp(vsub(zero, x)), one)));
+            break;
+        case 6: y = vge(x, zero, x, vsub(vexp(x), one)); break;                 // elu
+        case 7:                                                                 // selu
+            y = vge(x, zero, vmul(x, vset1(seluScale)), vmul(vsub(vexp(x), one), vset1(seluScale * seluAlpha)));
+            break;
+        case 9:                                                                 // swish
+            y = vgt(vset1(-80.0f), x, zero, vdiv(x, vadd(vexp(vsub(zero, x)), one)));
+            break;
+    }
+
+    y = vmul(y, vset1(p.gain));
+    if (p.clamp >= 0.0f)
+        y = vmin(vmax(y, vset1(-p.clamp)), vset1(p.clamp));
+    return y;
+}
+
+// A run of elements sharing the bias pattern: bias stride 0 adds b[0] to
+// all elements (NCHW, axis 1), stride 1 adds b[i] to element i (dense).
+template <int ACT>
+static void fusedBiasActRunForward(const FusedBiasActKernelParams& p, const float* x, float* y, int64_t n, const float* b, int bStride)
+{
+    int64_t i = 0;
+    if (bStride == 0)
+    {
+        vfloat bias = vset1(b[0]);
+        for (; i + VLEN <= n; i += VLEN)
+            vstore(y + i, fusedBiasActVector<ACT>(p, vadd(vload(x + i), bias)));
+    }
+    else
+    {
+        for (; i + VLEN <= n; i += VLEN)
+            vstore(y + i, fusedBiasActVector<ACT>(p, vadd(vload(x + i), vload(b + i))));
+    }
+    for (; i < n; i++)
+        y[i] = fusedBiasActScalar(p, x[i] + b[i * bStride], 0.0f, 0.0f);
+}
+
+static void fusedBiasActRun(const FusedBiasActKernelParams& p, const float* x, const float* xref, const float* yref, float* y, int64_t n, const float* b, int bStride)
+{
+    if (p.grad == 0)
+    {
+        switch (p.act)
+        {
+            case 0:
+            case 1: fusedBiasActRunForward<1>(p, x, y, n, b, bStride); return;
+            case 2: fusedBiasActRunForward<2>(p, x, y, n, b, bStride); return;
+            case 3: fusedBiasActRunForward<3>(p, x, y, n, b, bStride); return;
+            case 4: fusedBiasActRunForward<4>(p, x, y, n, b, bStride); return;
+            case 5: fusedBiasActRunForward<5>(p, x, y, n, b, bStride); return;
+            case 6: fusedBiasActRunForward<6>(p, x, y, n, b, bStride); return;
+            case 7: fusedBiasActRunForward<7>(p, x, y, n, b, bStride); return;
+            case 9: fusedBiasActRunForward<9>(p, x, y, n, b, bStride); return;
+            default: break;
+        }
+    }
+    for (int64_t i = 0; i < n; i++)
+        y[i] = fusedBiasActScalar(p, x[i] + b[i * bStride], xref ? xref[i] : 0.0f, yref ? yref[i] : 0.0f);
+}
+
+// Elements [begin, end) of the flat tensor, split into runs of the same
+// bias pattern. x, xref, yref and y point to the element 'begin'.
+static void fusedBiasActRange(const FusedBiasActKernelParams& p, const float* x, const float* b, const float* xref, const float* yref, float* y,
+                              int64_t sizeB, int64_t stepB, int64_t begin, int64_t end)
+{
+    static const float noBias = 0.0f;
+    for (int64_t i = begin; i < end; )
+    {
+        int64_t k = i - begin;
+        int64_t run;
+        const float* bias;
+        int bStride;
+        if (sizeB == 0)
+        {
+            run = end - i;
+            bias = &noBias;
+            bStride = 0;
+        }
+        else if (stepB == 1)
+        {
+            int64_t c = i % sizeB;
+            run = std::min(end - i, sizeB - c);
+            bias = b + c;
+            bStride = 1;
+        }
+        else
+        {
+            run = std::min(end - i, stepB - i % stepB);
+            bias = b + (i / stepB) % sizeB;
+            bStride = 0;
+        }
+        fusedBiasActRun(p, x + k, xref ? xref + k : NULL, yref ? yref + k : NULL, y + k, run, bias, bStride);
+        i += run;
+    }
+}
+
+//------------------------------------------------------------------------
+// TensorFlow op.
+
+template <class T>
+struct FusedBiasActCpuOp : public OpKernel
+{
+    FusedBiasActKernelParams m_attribs;
+
+    FusedBiasActCpuOp(OpKernelConstruction* ctx) : OpKernel(ctx)
+    {
+        memset(&m_attribs, 0, sizeof(m_attribs));
+        OP_REQUIRES_OK(ctx, ctx->GetAttr("grad",    &m_attribs.grad));
+        OP_REQUIRES_OK(ctx, ctx->GetAttr("axis",    &m_attribs.axis));
+        OP_REQUIRES_OK(ctx, ctx->GetAttr("act",     &m_attribs.act));
+        OP_REQUIRES_OK(ctx, ctx->GetAttr("alpha",   &m_attribs.alpha));
+        OP_REQUIRES_OK(ctx, ctx->GetAttr("gain",    &m_attribs.gain));
+        OP_REQUIRES_OK(ctx, ctx->GetAttr("clamp",   &m_attribs.clamp));
+        OP_REQUIRES(ctx, m_attribs.grad >= 0, errors::InvalidArgument("grad must be non-negative"));
+        OP_REQUIRES(ctx, m_attribs.axis >= 0, errors::InvalidArgument("axis must be non-negative"));
+        OP_REQUIRES(ctx, m_attribs.act >= 0, errors::InvalidArgument("act must be non-negative"));
+    }
+
+    void Compute(OpKernelContext* ctx)
+    {
+        const FusedBiasActKernelParams p = m_attribs;
+
+        const Tensor& x     = ctx->input(0); // [...]
+        const Tensor& b     = ctx->input(1); // [sizeB] or [0]
+        const Tensor& xref  = ctx->input(2); // x.shape or [0]
+        const Tensor& yref  = ctx->input(3); // x.shape or [0]
+        OP_REQUIRES(ctx, b.NumElements() == 0 || m_attribs.axis < x.dims(), errors::InvalidArgument("axis out of bounds"));
+        OP_REQUIRES(ctx, b.dims() == 1, errors::InvalidArgument("b must have rank 1"));
+        OP_REQUIRES(ctx, b.NumElements() == 0 || b.NumElements() == x.dim_size(m_attribs.axis), errors::InvalidArgument("b has wrong number of elements"));
+        OP_REQUIRES(ctx, xref.NumElements() == 0 || xref.NumElements() == x.NumElements(), errors::InvalidArgument("xref has wrong number of elements"));
+        OP_REQUIRES(ctx, yref.NumElements() == 0 || yref.NumElements() == x.NumElements(), errors::InvalidArgument("yref has wrong number of elements"));
+
+        int64_t sizeX = x.NumElements();
+        int64_t sizeB = b.NumElements();
+        int64_t stepB = 1;
+        for (int i = m_attribs.axis + 1; i < x.dims(); i++)
+            stepB *= x.dim_size(i);
+
+        Tensor* y = NULL; // x.shape
+        OP_REQUIRES_OK(ctx, ctx->allocate_output(0, x.shape(), &y));
+
+        // The bias is small, take it as float once.
+        std::vector<float> bias(sizeB);
+        const T* pb = (sizeB) ? b.flat<T>().data() : NULL;
+        for (int64_t i = 0; i < sizeB; i++)
+            bias[i] = (float)pb[i];
+
+        const T* px     = x.flat<T>().data();
+        const T* pxref  = (xref.NumElements()) ? xref.flat<T>().data() : NULL;
+        const T* pyref  = (yref.NumElements()) ? yref.flat<T>().data() : NULL;
+        T*       py     = y->flat<T>().data();
+
+        // Blocks of elements on the intra-op thread pool.
+        const int64_t blockSize = 8192;
+        auto work = [&](int64_t start, int64_t limit)
+        {
+            int64_t begin = start * blockSize;
+            int64_t end = std::min(limit * blockSize, sizeX);
+            compute(p, px + begin, bias.data(), pxref ? pxref + begin : NULL, pyref ? pyref + begin : NULL, py + begin, sizeB, stepB, begin, end);
+        };
+        auto workers = ctx->device()->tensorflow_cpu_worker_threads();
+        Shard(workers->num_threads, workers->workers, (sizeX + blockSize - 1) / blockSize, blockSize * 8, work);
+    }
+
+    static void compute(const FusedBiasActKernelParams& p, const float* x, const float* b, const float* xref, const float* yref, float* y,
+                        int64_t sizeB, int64_t stepB, int64_t begin, int64_t end)
+    {
+        fusedBiasActRange(p, x, b, xref, yref, y, sizeB, stepB, begin, end);
+    }
+
+    // Half goes through float in chunks on the stack.
+    static void compute(const FusedBiasActKernelParams& p, const Eigen::half* x, const float* b, const Eigen::half* xref, const Eigen::half* yref, Eigen::half* y,
+                        int64_t sizeB, int64_t stepB, int64_t begin, int64_t end)
+    {
+        const int64_t chunk = 1024;
+        float fx[chunk], fxref[chunk], fyref[chunk], fy[chunk];
+        for (int64_t i = begin; i < end; i += chunk)
+        {
+            int64_t o = i - begin;
+            int64_t n = std::min(chunk, end - i);
+            for (int64_t k = 0; k < n; k++)
+            {
+                fx[k] = (float)x[o + k];
+                if (xref) fxref[k] = (float)xref[o + k];
+                if (yref) fyref[k] = (float)yref[o + k];
+            }
+            fusedBiasActRange(p, fx, b, xref ? fxref : NULL, yref ? fyref : NULL, fy, sizeB, stepB, i, i + n);
+            for (int64_t k = 0; k < n; k++)
+                y[o + k] = (Eigen::half)fy[k];
+        }
+    }
+};
+
+REGISTER_OP("FusedBiasAct")
+    .Input      ("x: T")
+    .Input      ("b: T")
+    .Input      ("xref: T")
+    .Input      ("yref: T")
+    .Output     ("y: T")
+    .Attr       ("T: {float, half}")
+    .Attr       ("grad: int = 0")
+    .Attr       ("axis: int = 1")
+    .Attr       ("act: int = 0")
+    .Attr       ("alpha: float = 0.0")
+    .Attr       ("gain: float = 1.0")
+    .Attr       ("clamp: float = -1.0");
+REGISTER_KERNEL_BUILDER(Name("FusedBiasAct").Device(DEVICE_CPU).TypeConstraint<float>("T"), FusedBiasActCpuOp<float>);
+REGISTER_KERNEL_BUILDER(Name("FusedBiasAct").Device(DEVICE_CPU).TypeConstraint<Eigen::half>("T"), FusedBiasActCpuOp<Eigen::half>);
+
+//------------------------------------------------------------------------
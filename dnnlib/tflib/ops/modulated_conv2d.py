@@ -0,0 +1,109 @@
+# Copyright (c) 2020, NVIDIA CORPORATION.  All rights reserved.
+#
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+"""Custom TensorFlow op for the modulated convolution of the synthesis network."""
+
+import os
+import numpy as np
+import tensorflow as tf
+from .. import custom_ops, which_impl
+from .upfirdn_2d import upsample_conv_2d, _FilterKernel
+
+def _get_cpu_plugin():
+    return custom_ops.get_cpu_plugin(os.path.splitext(__file__)[0] + '_cpu.cc')
+
+#----------------------------------------------------------------------------
+
+def modulated_conv2d(x, w, s, demodulate=True, up=False, resample_kernel=None, impl=None):
+    r"""Modulated 2D convolution with optional 2x upsampling.
+
+    Computes the same as `modulated_conv2d_layer()` in `training/networks.py`
+    with `fused_modconv=False`, given its weight and styles: the input feature
+    maps are scaled by `s`, convolved with `w` ('SAME' padding, or
+    `upsample_conv_2d()` when `up`), and the output feature maps are scaled
+    by the demodulation factors.
+
+    Args:
+        x:                Input tensor of the shape `[N, inC, H, W]`.
+        w:                Weight tensor of the shape `[k, k, inC, outC]`.
+        s:                Styles of the shape `[N, inC]`.
+        demodulate:       Scale the output feature maps to unit weight norm (default: True).
+        up:               Upsample by 2 with `resample_kernel` (default: False).
+        resample_kernel:  FIR filter of the upsampling, as in `upsample_conv_2d()`.
+        impl:             Name of the implementation to use. `"cpu"` is the fused op,
+                          `"ref"` and `"cuda"` are built from the other ops.
+
+    Returns:
+        Tensor of the shape `[N, outC, H, W]` (or `[N, outC, H * 2, W * 2]`) and
+        same datatype as `x`.
+    """
+
+    impl_dict = {
+        'ref':  _modulated_conv2d_ref,
+        'cuda': _modulated_conv2d_ref,    # no CUDA op
+        'cpu':  _modulated_conv2d_cpu,
+    }
+    impl = which_impl(impl)
+    return impl_dict[impl](x=x, w=w, s=s, demodulate=demodulate, up=up, resample_kernel=resample_kernel, impl=impl)
+
+#----------------------------------------------------------------------------
+
+def _modulated_conv2d_ref(x, w, s, demodulate, up, resample_kernel, impl):
+    """Reference implementation of `modulated_conv2d()` using the other ops."""
+
+    x = tf.convert_to_tensor(x)
+    w = tf.cast(w, x.dtype)
+    s = tf.cast(s, x.dtype)
+    kernel = w.shape[0].value
+    assert kernel >= 1 and kernel % 2 == 1
+
+    x *= s[:, :, np.newaxis, np.newaxis]
+    if up:
+        x = upsample_conv_2d(x, w, data_format='NCHW', k=resample_kernel, impl=impl)
+    else:
+        x = tf.transpose(x, [0, 2, 3, 1])
+        x = tf.nn.conv2d(x, filters=w, data_format='NHWC', strides=[1,1,1,1], padding='SAME')
+        x = tf.transpose(x, [0, 3, 1, 2])
+    if demodulate:
+        ww = w[np.newaxis] * s[:, np.newaxis, np.newaxis, :, np.newaxis]
+        d = tf.math.rsqrt(tf.reduce_sum(tf.square(ww), axis=[1,2,3]) + 1e-8)
+        x *= d[:, :, np.newaxis, np.newaxis]
+    return x
+
+#----------------------------------------------------------------------------
+
+def _modulated_conv2d_cpu(x, w, s, demodulate, up, resample_kernel, impl):
+    """Fused CPU implementation of `modulated_conv2d()`. Inference only, no gradient."""
+
+    x = tf.convert_to_tensor(x)
+    w = tf.cast(w, x.dtype)
+    s = tf.cast(s, x.dtype)
+    N, _inC, H, W = x.shape.as_list()
+    kernel = w.shape[0].value
+    outC = w.shape[3].value
+    assert kernel >= 1 and kernel % 2 == 1
+
+    # The FIR of upsample_conv_2d(), applied to the transposed convolution.
+    if up:
+        k = _FilterKernel(resample_kernel if resample_kernel is not None else [1] * 2, 2 ** 2)
+        kxy = k.kxy if k.kxy is not None else k.ky * k.kx
+        pad0 = (k.w + 2 - kernel) // 2
+        pad1 = (k.w - 2 - kernel + 3) // 2
+        outH = (H - 1) * 2 + kernel + pad0 + pad1 - k.h + 1
+        outW = (W - 1) * 2 + kernel + pad0 + pad1 - k.w + 1
+    else:
+        kxy = np.zeros([0, 0], dtype=np.float32)
+        pad0 = pad1 = 0
+        outH, outW = H, W
+
+    cpu_op = _get_cpu_plugin().modulated_conv2d
+    y = cpu_op(x=x, w=w, s=s, k=tf.constant(kxy, dtype=x.dtype), demodulate=bool(demodulate), up=(2 if up else 1), pad0=int(pad0), pad1=int(pad1))
+    y.set_shape([N, outC, outH, outW])
+    return y
+
+#----------------------------------------------------------------------------
@@ -0,0 +1,450 @@
+// modulated_conv2d_cpu.cc
+// CPU kernel of ModulatedConv2D, the modulated convolution of the
+// synthesis network (training/networks.py: modulated_conv2d_layer) in a
+// single op: modulate, demodulate, convolve and, with up=2, the transposed
+// convolution followed by the FIR filter of upsample_conv_2d().
+//
+// The convolution is a GEMM per sample, Y[O, pixels] = A[O, K] * B[K, pixels]
+// with K = inChannels * taps. A is the shared weight, packed once per call.
+// The style scales B while it is packed from the input, a panel at a time,
+// and the demodulation scales Y while it is stored, so no per-sample weight
+// is made at all. The transposed convolution is split into its four output
+// phases, each a plain convolution with its own subset of the taps.
+//
+// Inference only: the op has no gradient.
+
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include "cpu_simd.h"
+#include "upfirdn_2d_cpu.h"
+
+using namespace tensorflow;
+using namespace tensorflow::shape_inference;
+
+//------------------------------------------------------------------------
+// CPU kernel.
+
+// GEMM blocking: micro tile of MR outputs x NR pixels in registers, panels
+// of KC x PC for B, chunks of OC outputs per work unit. The panels of a
+// work unit (B, C and the A slice) stay in the L2 cache.
+static const int MR = 6;
+static const int NR = 2 * VLEN;
+static const int KC = 128;
+static const int PC = 128;
+static const int OC = 16 * MR;
+
+struct ModulatedConv2DKernelParams
+{
+    int         demodulate;
+    int         up;
+    int         pad0;
+    int         pad1;
+
+    int         batch;
+    int         inC;
+    int         inH;
+    int         inW;
+    int         outC;
+    int         kernelH;
+    int         kernelW;
+    int         convH;      // size of the convolution, before the FIR
+    int         convW;
+};
+
+struct ModulatedConv2DTap
+{
+    int         ty;         // weight row/column
+    int         tx;
+    int         dy;         // input offset from the phase pixel
+    int         dx;
+};
+
+// The output pixels (stride*a + py, stride*b + px) of the convolution.
+struct ModulatedConv2DPhase
+{
+    int         py;
+    int         px;
+    int         gridH;
+    int         gridW;
+    std::vector<ModulatedConv2DTap> taps;
+    std::vector<float> a;   // packed weight [outC/MR][K][MR], K = inC * taps
+};
+
+// Phases of the convolution. up=1: 'SAME' convolution, a single phase.
+// up=2: the stride 2 'VALID' transposed convolution of upsample_conv_2d(),
+// whose pixel Y takes the input a + dy by the weight row kernelH-1-(Y-2*yi).
+static std::vector<ModulatedConv2DPhase> modulatedConv2DPhases(const ModulatedConv2DKernelParams& p)
+{
+    std::vector<ModulatedConv2DPhase> phases;
+    int stride = p.up;
+    for (int py = 0; py < stride; py++)
+    for (int px = 0; px < stride; px++)
+    {
+        ModulatedConv2DPhase phase;
+        phase.py = py;
+        phase.px = px;
+        phase.gridH = (p.convH - py + stride - 1) / stride;
+        phase.gridW = (p.convW - px + stride - 1) / stride;
+        for (int ty = 0; ty < p.kernelH; ty++)
+        for (int tx = 0; tx < p.kernelW; tx++)
+        {
+            ModulatedConv2DTap tap = { ty, tx, ty - p.kernelH / 2, tx - p.kernelW / 2 };
+            if (stride == 2)
+            {
+                int ry = ty - p.kernelH + 1 + py;
+                int rx = tx - p.kernelW + 1 + px;
+                if ((ry & 1) || (rx & 1))
+                    continue;
+                tap.dy = ry / 2;
+                tap.dx = rx / 2;
+            }
+            phase.taps.push_back(tap);
+        }
+        if (phase.gridH > 0 && phase.gridW > 0 && !phase.taps.empty())
+            phases.push_back(phase);
+    }
+    return phases;
+}
+
+// A of a phase, w is [kernelH, kernelW, inC, outC].
+static void modulatedConv2DPackA(const ModulatedConv2DKernelParams& p, const float* w, ModulatedConv2DPhase& phase)
+{
+    int taps = (int)phase.taps.size();
+    int64_t K = (int64_t)p.inC * taps;
+    int oBlocks = (p.outC + MR - 1) / MR;
+    phase.a.assign((size_t)oBlocks * K * MR, 0.0f);
+    for (int ob = 0; ob < oBlocks; ob++)
+    for (int i = 0; i < p.inC; i++)
+    for (int t = 0; t < taps; t++)
+    {
+        const ModulatedConv2DTap& tap = phase.taps[t];
+        const float* wp = w + ((int64_t)(tap.ty * p.kernelW + tap.tx) * p.inC + i) * p.outC;
+        float* ap = &phase.a[((size_t)ob * K + (int64_t)i * taps + t) * MR];
+        for (int r = 0; r < MR && ob * MR + r < p.outC; r++)
+            ap[r] = wp[ob * MR + r];
+    }
+}
+
+// Panel of B: rows [k0, k0+kc) and the pixels [p0, p0+PC) of the phase
+// grid, the input scaled by the style. The pixels past the grid are zero.
+template <class T>
+static void modulatedConv2DPackB(const ModulatedConv2DKernelParams& p, const ModulatedConv2DPhase& phase, const T* x, const float* s,
+                                 int64_t k0, int kc, int p0, float* b)
+{
+    int taps = (int)phase.taps.size();
+    int pixels = phase.gridH * phase.gridW;
+    for (int kk = 0; kk < kc; kk++)
+    {
+        int i = (int)((k0 + kk) / taps);
+        const ModulatedConv2DTap& tap = phase.taps[(k0 + kk) - (int64_t)i * taps];
+        const T* xp = x + (int64_t)i * p.inH * p.inW;
+        float scale = s[i];
+        float* bp = b + kk * PC;
+
+        int pp = 0;
+        while (pp < PC)
+        {
+            int pix = p0 + pp;
+            if (pix >= pixels)
+            {
+                for (; pp < PC; pp++)
+                    bp[pp] = 0.0f;
+                break;
+            }
+
+            // A run of pixels on one row of the grid.
+            int ga = pix / phase.gridW;
+            int gb = pix - ga * phase.gridW;
+            int run = std::min(PC - pp, phase.gridW - gb);
+            int inY = ga + tap.dy;
+            int inX = gb + tap.dx;
+            if (inY < 0 || inY >= p.inH)
+            {
+                for (int j = 0; j < run; j++)
+                    bp[pp + j] = 0.0f;
+            }
+            else
+            {
+                const T* row = xp + (int64_t)inY * p.inW;
+                for (int j = 0; j < run; j++)
+                {
+                    int xx = inX + j;
+                    bp[pp + j] = (xx >= 0 && xx < p.inW) ? (float)row[xx] * scale : 0.0f;
+                }
+            }
+            pp += run;
+        }
+    }
+}
+
+// C[MR][PC] (+)= A[kc][MR] * B[kc][PC].
+static void modulatedConv2DMicro(const float* a, const float* b, int kc, float* c, bool first)
+{
+    for (int pp = 0; pp < PC; pp += NR)
+    {
+        vfloat acc[MR][2];
+        for (int r = 0; r < MR; r++)
+        {
+            acc[r][0] = first ? vset1(0.0f) : vload(c + r * PC + pp);
+            acc[r][1] = first ? vset1(0.0f) : vload(c + r * PC + pp + VLEN);
+        }
+        for (int kk = 0; kk < kc; kk++)
+        {
+            vfloat b0 = vload(b + kk * PC + pp);
+            vfloat b1 = vload(b + kk * PC + pp + VLEN);
+            const float* ak = a + kk * MR;
+            for (int r = 0; r < MR; r++)
+            {
+                vfloat av = vset1(ak[r]);
+                acc[r][0] = vfmadd(av, b0, acc[r][0]);
+                acc[r][1] = vfmadd(av, b1, acc[r][1]);
+            }
+        }
+        for (int r = 0; r < MR; r++)
+        {
+            vstore(c + r * PC + pp, acc[r][0]);
+            vstore(c + r * PC + pp + VLEN, acc[r][1]);
+        }
+    }
+}
+
+// Work unit: a sample, a phase, PC pixels of its grid and OC outputs.
+// y is the convolution output [batch, outC, convH, convW], scaled by d.
+template <class T>
+static void modulatedConv2DUnit(const ModulatedConv2DKernelParams& p, const ModulatedConv2DPhase& phase, const T* x, const float* s, const float* d,
+                                T* y, int n, int p0, int o0, float* b, float* c)
+{
+    int taps = (int)phase.taps.size();
+    int64_t K = (int64_t)p.inC * taps;
+    int oEnd = std::min(o0 + OC, p.outC);
+    int oBlocks = (oEnd - o0 + MR - 1) / MR;
+    const T* xn = x + (int64_t)n * p.inC * p.inH * p.inW;
+    const float* sn = s + (int64_t)n * p.inC;
+
+    for (int64_t k0 = 0; k0 < K; k0 += KC)
+    {
+        int kc = (int)std::min<int64_t>(KC, K - k0);
+        modulatedConv2DPackB(p, phase, xn, sn, k0, kc, p0, b);
+        for (int ob = 0; ob < oBlocks; ob++)
+        {
+            const float* a = &phase.a[((size_t)(o0 / MR + ob) * K + k0) * MR];
+            modulatedConv2DMicro(a, b, kc, c + ob * MR * PC, k0 == 0);
+        }
+    }
+
+    // Store result.
+    int pixels = std::min(PC, phase.gridH * phase.gridW - p0);
+    int stride = p.up;
+    for (int o = o0; o < oEnd; o++)
+    {
+        const float* cp = c + (o - o0) * PC;
+        float scale = d[(int64_t)n * p.outC + o];
+        T* yp = y + ((int64_t)n * p.outC + o) * p.convH * p.convW;
+        for (int pp = 0; pp < pixels; pp++)
+        {
+            int ga = (p0 + pp) / phase.gridW;
+            int gb = (p0 + pp) - ga * phase.gridW;
+            yp[(int64_t)(ga * stride + phase.py) * p.convW + gb * stride + phase.px] = (T)(cp[pp] * scale);
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+// TensorFlow op.
+
+template <class T>
+struct ModulatedConv2DCpuOp : public OpKernel
+{
+    ModulatedConv2DKernelParams m_attribs;
+
+    ModulatedConv2DCpuOp(OpKernelConstruction* ctx) : OpKernel(ctx)
+    {
+        bool demodulate = true;
+        memset(&m_attribs, 0, sizeof(m_attribs));
+        OP_REQUIRES_OK(ctx, ctx->GetAttr("demodulate", &demodulate));
+        OP_REQUIRES_OK(ctx, ctx->GetAttr("up", &m_attribs.up));
+        OP_REQUIRES_OK(ctx, ctx->GetAttr("pad0", &m_attribs.pad0));
+        OP_REQUIRES_OK(ctx, ctx->GetAttr("pad1", &m_attribs.pad1));
+        m_attribs.demodulate = demodulate ? 1 : 0;
+        OP_REQUIRES(ctx, m_attribs.up == 1 || m_attribs.up == 2, errors::InvalidArgument("up must be 1 or 2"));
+    }
+
+    void Compute(OpKernelContext* ctx)
+    {
+        ModulatedConv2DKernelParams p = m_attribs;
+
+        const Tensor& x = ctx->input(0); // [batch, inC, inH, inW]
+        const Tensor& w = ctx->input(1); // [kernelH, kernelW, inC, outC]
+        const Tensor& s = ctx->input(2); // [batch, inC]
+        const Tensor& k = ctx->input(3); // [firH, firW], up=2 only
+        OP_REQUIRES(ctx, x.dims() == 4, errors::InvalidArgument("input must have rank 4"));
+        OP_REQUIRES(ctx, w.dims() == 4, errors::InvalidArgument("weight must have rank 4"));
+        OP_REQUIRES(ctx, s.dims() == 2, errors::InvalidArgument("style must have rank 2"));
+        OP_REQUIRES(ctx, k.dims() == 2, errors::InvalidArgument("kernel must have rank 2"));
+        OP_REQUIRES(ctx, x.NumElements() <= kint32max, errors::InvalidArgument("input too large"));
+
+        p.batch     = (int)x.dim_size(0);
+        p.inC       = (int)x.dim_size(1);
+        p.inH       = (int)x.dim_size(2);
+        p.inW       = (int)x.dim_size(3);
+        p.kernelH   = (int)w.dim_size(0);
+        p.kernelW   = (int)w.dim_size(1);
+        p.outC      = (int)w.dim_size(3);
+        OP_REQUIRES(ctx, w.dim_size(2) == p.inC, errors::InvalidArgument("weight and input have different channels"));
+        OP_REQUIRES(ctx, s.dim_size(0) == p.batch && s.dim_size(1) == p.inC, errors::InvalidArgument("style has wrong shape"));
+        OP_REQUIRES(ctx, p.kernelH % 2 == 1 && p.kernelW % 2 == 1, errors::InvalidArgument("kernel size must be odd"));
+        OP_REQUIRES(ctx, p.up == 1 || (k.dim_size(0) >= 1 && k.dim_size(1) >= 1), errors::InvalidArgument("up=2 needs the FIR kernel"));
+
+        // Convolution, then the FIR of the upsampling.
+        UpFirDn2DKernelParams f;
+        memset(&f, 0, sizeof(f));
+        if (p.up == 1)
+        {
+            p.convH = p.inH;
+            p.convW = p.inW;
+        }
+        else
+        {
+            p.convH = (p.inH - 1) * 2 + p.kernelH;
+            p.convW = (p.inW - 1) * 2 + p.kernelW;
+            f.upx = f.upy = f.downx = f.downy = 1;
+            f.padx0 = f.pady0 = p.pad0;
+            f.padx1 = f.pady1 = p.pad1;
+            f.majorDim = p.batch * p.outC;
+            f.inH = p.convH;
+            f.inW = p.convW;
+            f.minorDim = 1;
+            f.kernelH = (int)k.dim_size(0);
+            f.kernelW = (int)k.dim_size(1);
+            f.outH = p.convH + p.pad0 + p.pad1 - f.kernelH + 1;
+            f.outW = p.convW + p.pad0 + p.pad1 - f.kernelW + 1;
+            OP_REQUIRES(ctx, f.outW >= 1 && f.outH >= 1, errors::InvalidArgument("output must be at least 1x1"));
+        }
+
+        Tensor* y = NULL; // [batch, outC, outH, outW]
+        TensorShape ys;
+        ys.AddDim(p.batch);
+        ys.AddDim(p.outC);
+        ys.AddDim((p.up == 1) ? p.convH : f.outH);
+        ys.AddDim((p.up == 1) ? p.convW : f.outW);
+        OP_REQUIRES_OK(ctx, ctx->allocate_output(0, ys, &y));
+        OP_REQUIRES(ctx, y->NumElements() <= kint32max, errors::InvalidArgument("output too large"));
+        if (y->NumElements() == 0)
+            return;
+
+        Tensor conv; // [batch, outC, convH, convW] before the FIR
+        if (p.up == 2)
+        {
+            OP_REQUIRES_OK(ctx, ctx->allocate_temp(DataTypeToEnum<T>::value, TensorShape({p.batch, p.outC, p.convH, p.convW}), &conv));
+            OP_REQUIRES(ctx, conv.NumElements() <= kint32max, errors::InvalidArgument("output too large"));
+        }
+
+        // The weight and the styles as float.
+        std::vector<float> wf(w.NumElements()), sf(s.NumElements()), kf(k.NumElements());
+        toFloat(w, wf);
+        toFloat(s, sf);
+        toFloat(k, kf);
+
+        // Demodulation: 1/|w * s| per output, from the squared weight.
+        std::vector<float> d((size_t)p.batch * p.outC, 1.0f);
+        if (p.demodulate)
+        {
+            std::vector<double> wsq((size_t)p.inC * p.outC, 0.0);
+            for (int t = 0; t < p.kernelH * p.kernelW; t++)
+                for (size_t io = 0; io < wsq.size(); io++)
+                {
+                    double v = wf[t * wsq.size() + io];
+                    wsq[io] += v * v;
+                }
+            for (int n = 0; n < p.batch; n++)
+                for (int o = 0; o < p.outC; o++)
+                {
+                    double sum = 0.0;
+                    for (int i = 0; i < p.inC; i++)
+                    {
+                        double si = sf[(size_t)n * p.inC + i];
+                        sum += si * si * wsq[(size_t)i * p.outC + o];
+                    }
+                    d[(size_t)n * p.outC + o] = (float)(1.0 / sqrt(sum + 1e-8));
+                }
+        }
+
+        std::vector<ModulatedConv2DPhase> phases = modulatedConv2DPhases(p);
+        for (auto& phase : phases)
+            modulatedConv2DPackA(p, wf.data(), phase);
+
+        const T* px = x.flat<T>().data();
+        T*       pc = (p.up == 1) ? y->flat<T>().data() : conv.flat<T>().data();
+
+        // The convolution output without a tap (up=2 with 1x1) stays zero.
+        if (p.up == 2)
+            std::fill(pc, pc + conv.NumElements(), T(0.0f));
+
+        // Work units: sample x phase x pixel panel x output chunk.
+        struct Unit { int n; int phase; int p0; int o0; };
+        std::vector<Unit> units;
+        int oChunks = (p.outC + OC - 1) / OC;
+        for (int n = 0; n < p.batch; n++)
+            for (int ph = 0; ph < (int)phases.size(); ph++)
+                for (int p0 = 0; p0 < phases[ph].gridH * phases[ph].gridW; p0 += PC)
+                    for (int oc = 0; oc < oChunks; oc++)
+                        units.push_back(Unit{ n, ph, p0, oc * OC });
+
+        auto work = [&](int64_t start, int64_t limit)
+        {
+            std::vector<float> b((size_t)KC * PC), c((size_t)OC * PC);
+            for (int64_t u = start; u < limit; u++)
+            {
+                const Unit& unit = units[u];
+                modulatedConv2DUnit(p, phases[unit.phase], px, sf.data(), d.data(), pc, unit.n, unit.p0, unit.o0, b.data(), c.data());
+            }
+        };
+        int64_t cost = (int64_t)OC * PC * p.inC * p.kernelH * p.kernelW * 2 / (p.up * p.up);
+        auto workers = ctx->device()->tensorflow_cpu_worker_threads();
+        Shard(workers->num_threads, workers->workers, (int64_t)units.size(), cost, work);
+
+        // FIR of the upsampling, the planes of the convolution output.
+        if (p.up == 2)
+        {
+            const T* pconv = conv.flat<T>().data();
+            T*       py    = y->flat<T>().data();
+            UpFirDn2DFunc<T> func = chooseUpFirDn2D<T>(f);
+            int planes = f.majorDim;
+            auto fir = [&](int64_t start, int64_t limit)
+            {
+                func(f, kf.data(), pconv, py, (int)(start * VLEN), (int)std::min<int64_t>(limit * VLEN, planes));
+            };
+            Shard(workers->num_threads, workers->workers, (planes + VLEN - 1) / VLEN, (int64_t)f.outH * f.outW * f.kernelH * f.kernelW * VLEN, fir);
+        }
+    }
+
+    static void toFloat(const Tensor& t, std::vector<float>& v)
+    {
+        const T* pt = (v.size()) ? t.flat<T>().data() : NULL;
+        for (size_t i = 0; i < v.size(); i++)
+            v[i] = (float)pt[i];
+    }
+};
+
+REGISTER_OP("ModulatedConv2D")
+    .Input      ("x: T")
+    .Input      ("w: T")
+    .Input      ("s: T")
+    .Input      ("k: T")
+    .Output     ("y: T")
+    .Attr       ("T: {float, half}")
+    .Attr       ("demodulate: bool = true")
+    .Attr       ("up: int = 1")
+    .Attr       ("pad0: int = 0")
+    .Attr       ("pad1: int = 0");
+REGISTER_KERNEL_BUILDER(Name("ModulatedConv2D").Device(DEVICE_CPU).TypeConstraint<float>("T"), ModulatedConv2DCpuOp<float>);
+REGISTER_KERNEL_BUILDER(Name("ModulatedConv2D").Device(DEVICE_CPU).TypeConstraint<Eigen::half>("T"), ModulatedConv2DCpuOp<Eigen::half>);
+
+//------------------------------------------------------------------------
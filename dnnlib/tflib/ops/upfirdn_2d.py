@@ -16,6 +16,9 @@ from .. import custom_ops, which_impl
 def _get_plugin():
     return custom_ops.get_plugin(os.path.splitext(__file__)[0] + '.cu')
 
+def _get_cpu_plugin():
+    return custom_ops.get_cpu_plugin(os.path.splitext(__file__)[0] + '_cpu.cc')
+
 #----------------------------------------------------------------------------
 
 def upfirdn_2d(x, k, upx=1, upy=1, downx=1, downy=1, padx0=0, padx1=0, pady0=0, pady1=0, impl=None):
@@ -51,7 +54,8 @@ def upfirdn_2d(x, k, upx=1, upy=1, downx=1, downy=1, padx0=0, padx1=0, pady0=0,
         padx1:  Number of pixels to pad on the right side (default: 0).
         pady0:  Number of pixels to pad on the top side (default: 0).
         pady1:  Number of pixels to pad on the bottom side (default: 0).
-        impl:   Name of the implementation to use. Can be `"ref"` or `"cuda"` (default).
+        impl:   Name of the implementation to use. Can be `"ref"`, `"cuda"` (default)
+                or `"cpu"`, the same op built for the CPU.
 
     Returns:
         Tensor of the shape `[majorDim, outH, outW, minorDim]`, and same datatype as `x`.
@@ -60,6 +64,7 @@ def upfirdn_2d(x, k, upx=1, upy=1, downx=1, downy=1, padx0=0, padx1=0, pady0=0,
     impl_dict = {
         'ref':  _upfirdn_2d_ref,
         'cuda': _upfirdn_2d_cuda,
+        'cpu':  _upfirdn_2d_cpu,
     }
     impl = which_impl(impl)
     return impl_dict[impl](x=x, k=k, upx=upx, upy=upy, downx=downx, downy=downy, padx0=padx0, padx1=padx1, pady0=pady0, pady1=pady1)
@@ -112,7 +117,13 @@ def _upfirdn_2d_ref(x, k, upx, upy, downx, downy, padx0, padx1, pady0, pady1):
 
 #----------------------------------------------------------------------------
 
-def _upfirdn_2d_cuda(x, k, upx, upy, downx, downy, padx0, padx1, pady0, pady1):
+def _upfirdn_2d_cpu(x, k, upx, upy, downx, downy, padx0, padx1, pady0, pady1):
+    """CPU implementation of `upfirdn_2d()`, the CUDA op built for the CPU."""
+    return _upfirdn_2d_cuda(x=x, k=k, upx=upx, upy=upy, downx=downx, downy=downy, padx0=padx0, padx1=padx1, pady0=pady0, pady1=pady1, get_plugin=_get_cpu_plugin)
+
+#----------------------------------------------------------------------------
+
+def _upfirdn_2d_cuda(x, k, upx, upy, downx, downy, padx0, padx1, pady0, pady1, get_plugin=_get_plugin):
     """Fast CUDA implementation of `upfirdn_2d()` using custom ops."""
 
     x = tf.convert_to_tensor(x)
@@ -130,7 +141,7 @@ def _upfirdn_2d_cuda(x, k, upx, upy, downx, downy, padx0, padx1, pady0, pady1):
     outH = (inH * upy + pady0 + pady1 - kernelH) // downy + 1
     assert outW >= 1 and outH >= 1
 
-    cuda_op = _get_plugin().up_fir_dn2d
+    cuda_op = get_plugin().up_fir_dn2d
     kc = tf.constant(k, dtype=x.dtype)
     gkc = tf.constant(k[::-1, ::-1], dtype=x.dtype)
     gpadx0 = kernelW - padx0 - 1
@@ -177,7 +188,7 @@ def filter_2d(x, k, gain=1, padding=0, data_format='NCHW', impl=None):
     assert k.w == k.h
     pad0 = k.w // 2 + padding
     pad1 = (k.w - 1) // 2 + padding
-    return _simple_upfirdn_2d(x, k, pad0=pad0, pad1=pad1, data_format=data_format, impl=whitch_impl(impl))
+    return _simple_upfirdn_2d(x, k, pad0=pad0, pad1=pad1, data_format=data_format, impl=which_impl(impl))
 
 #----------------------------------------------------------------------------
 
@@ -0,0 +1,118 @@
+// upfirdn_2d_cpu.cc
+// CPU kernel of UpFirDn2D, the counterpart of upfirdn_2d.cu.
+//
+// The op registration is the same as the CUDA one, so a graph built with
+// impl='cpu' and one built with impl='cuda' have the same nodes. Load
+// only one of the two plugins in a process: both register the op.
+//
+// The kernels are in upfirdn_2d_cpu.h.
+
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "upfirdn_2d_cpu.h"
+
+using namespace tensorflow;
+using namespace tensorflow::shape_inference;
+
+//------------------------------------------------------------------------
+// TensorFlow op.
+
+template <class T>
+struct UpFirDn2DCpuOp : public OpKernel
+{
+    UpFirDn2DKernelParams m_attribs;
+
+    UpFirDn2DCpuOp(OpKernelConstruction* ctx) : OpKernel(ctx)
+    {
+        memset(&m_attribs, 0, sizeof(m_attribs));
+        OP_REQUIRES_OK(ctx, ctx->GetAttr("upx", &m_attribs.upx));
+        OP_REQUIRES_OK(ctx, ctx->GetAttr("upy", &m_attribs.upy));
+        OP_REQUIRES_OK(ctx, ctx->GetAttr("downx", &m_attribs.downx));
+        OP_REQUIRES_OK(ctx, ctx->GetAttr("downy", &m_attribs.downy));
+        OP_REQUIRES_OK(ctx, ctx->GetAttr("padx0", &m_attribs.padx0));
+        OP_REQUIRES_OK(ctx, ctx->GetAttr("padx1", &m_attribs.padx1));
+        OP_REQUIRES_OK(ctx, ctx->GetAttr("pady0", &m_attribs.pady0));
+        OP_REQUIRES_OK(ctx, ctx->GetAttr("pady1", &m_attribs.pady1));
+        OP_REQUIRES(ctx, m_attribs.upx >= 1 && m_attribs.upy >= 1, errors::InvalidArgument("upx and upy must be at least 1x1"));
+        OP_REQUIRES(ctx, m_attribs.downx >= 1 && m_attribs.downy >= 1, errors::InvalidArgument("downx and downy must be at least 1x1"));
+    }
+
+    void Compute(OpKernelContext* ctx)
+    {
+        UpFirDn2DKernelParams p = m_attribs;
+
+        const Tensor& x = ctx->input(0); // [majorDim, inH, inW, minorDim]
+        const Tensor& k = ctx->input(1); // [kernelH, kernelW]
+        OP_REQUIRES(ctx, x.dims() == 4, errors::InvalidArgument("input must have rank 4"));
+        OP_REQUIRES(ctx, k.dims() == 2, errors::InvalidArgument("kernel must have rank 2"));
+        OP_REQUIRES(ctx, x.NumElements() <= kint32max, errors::InvalidArgument("input too large"));
+        OP_REQUIRES(ctx, k.NumElements() <= kint32max, errors::InvalidArgument("kernel too large"));
+
+        p.majorDim  = (int)x.dim_size(0);
+        p.inH       = (int)x.dim_size(1);
+        p.inW       = (int)x.dim_size(2);
+        p.minorDim  = (int)x.dim_size(3);
+        p.kernelH   = (int)k.dim_size(0);
+        p.kernelW   = (int)k.dim_size(1);
+        OP_REQUIRES(ctx, p.kernelW >= 1 && p.kernelH >= 1, errors::InvalidArgument("kernel must be at least 1x1"));
+
+        p.outW = (p.inW * p.upx + p.padx0 + p.padx1 - p.kernelW + p.downx) / p.downx;
+        p.outH = (p.inH * p.upy + p.pady0 + p.pady1 - p.kernelH + p.downy) / p.downy;
+        OP_REQUIRES(ctx, p.outW >= 1 && p.outH >= 1, errors::InvalidArgument("output must be at least 1x1"));
+
+        Tensor* y = NULL; // [majorDim, outH, outW, minorDim]
+        TensorShape ys;
+        ys.AddDim(p.majorDim);
+        ys.AddDim(p.outH);
+        ys.AddDim(p.outW);
+        ys.AddDim(p.minorDim);
+        OP_REQUIRES_OK(ctx, ctx->allocate_output(0, ys, &y));
+        OP_REQUIRES(ctx, y->NumElements() <= kint32max, errors::InvalidArgument("output too large"));
+        if (y->NumElements() == 0)
+            return;
+
+        // The filter kernel is small, take it as float once.
+        std::vector<float> kf(k.NumElements());
+        const T* pk = k.flat<T>().data();
+        for (size_t i = 0; i < kf.size(); i++)
+            kf[i] = (float)pk[i];
+
+        const T* px = x.flat<T>().data();
+        T*       py = y->flat<T>().data();
+        UpFirDn2DFunc<T> func = chooseUpFirDn2D<T>(p);
+
+        // Vectors of planes on the intra-op thread pool.
+        int planes = p.majorDim * p.minorDim;
+        auto work = [&](int64_t start, int64_t limit)
+        {
+            func(p, kf.data(), px, py, (int)(start * VLEN), (int)std::min<int64_t>(limit * VLEN, planes));
+        };
+        int64_t taps = std::max((int64_t)p.kernelW * p.kernelH / (p.upx * p.upy), (int64_t)1);
+        auto workers = ctx->device()->tensorflow_cpu_worker_threads();
+        Shard(workers->num_threads, workers->workers, (planes + VLEN - 1) / VLEN, (int64_t)p.outH * p.outW * taps * VLEN, work);
+    }
+};
+
+REGISTER_OP("UpFirDn2D")
+    .Input      ("x: T")
+    .Input      ("k: T")
+    .Output     ("y: T")
+    .Attr       ("T: {float, half}")
+    .Attr       ("upx: int = 1")
+    .Attr       ("upy: int = 1")
+    .Attr       ("downx: int = 1")
+    .Attr       ("downy: int = 1")
+    .Attr       ("padx0: int = 0")
+    .Attr       ("padx1: int = 0")
+    .Attr       ("pady0: int = 0")
+    .Attr       ("pady1: int = 0");
+REGISTER_KERNEL_BUILDER(Name("UpFirDn2D").Device(DEVICE_CPU).TypeConstraint<float>("T"), UpFirDn2DCpuOp<float>);
+REGISTER_KERNEL_BUILDER(Name("UpFirDn2D").Device(DEVICE_CPU).TypeConstraint<Eigen::half>("T"), UpFirDn2DCpuOp<Eigen::half>);
+
+//------------------------------------------------------------------------
@@ -0,0 +1,258 @@
+// upfirdn_2d_cpu.h
+// CPU kernels of UpFirDn2D, shared by the ops that resample on the CPU.
+//
+// The images are filtered a vector at a time: the lanes of a vector are
+// VLEN images (planes of [majorDim, minorDim]) at the same pixel, so the
+// polyphase inner loop of the CUDA kernel runs unchanged on vectors, for
+// any up/down factor and without shuffles. The input is loaded into the
+// lanes a tile at a time, small enough to stay in the cache.
+
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+
+#include "cpu_simd.h"
+
+//------------------------------------------------------------------------
+// Helpers.
+
+static inline int floorDiv(int a, int b)
+{
+    int t = 1 - a / b;
+    return (a + t * b) / b - t;
+}
+
+//------------------------------------------------------------------------
+// CPU kernel params.
+
+struct UpFirDn2DKernelParams
+{
+    int         upx;
+    int         upy;
+    int         downx;
+    int         downy;
+    int         padx0;
+    int         padx1;
+    int         pady0;
+    int         pady1;
+
+    int         majorDim;
+    int         inH;
+    int         inW;
+    int         minorDim;
+    int         kernelH;
+    int         kernelW;
+    int         outH;
+    int         outW;
+};
+
+// Planes [planeBegin, planeEnd) of the flattened [majorDim, minorDim].
+// k is the filter kernel as float, [kernelH, kernelW].
+template <class T>
+using UpFirDn2DFunc = void (*)(const UpFirDn2DKernelParams& p, const float* k, const T* x, T* y, int planeBegin, int planeEnd);
+
+//------------------------------------------------------------------------
+// General implementation for large filter kernels.
+
+template <class T>
+static void upFirDn2DLarge(const UpFirDn2DKernelParams& p, const float* k, const T* x, T* y, int planeBegin, int planeEnd)
+{
+    for (int plane = planeBegin; plane < planeEnd; plane++)
+    {
+        int majorIdx = plane / p.minorDim;
+        int minorIdx = plane - majorIdx * p.minorDim;
+
+        for (int outY = 0; outY < p.outH; outY++)
+        {
+            // Setup Y receptive field.
+            int midY = outY * p.downy + p.upy - 1 - p.pady0;
+            int inY = std::min(std::max(floorDiv(midY, p.upy), 0), p.inH);
+            int h = std::min(std::max(floorDiv(midY + p.kernelH, p.upy), 0), p.inH) - inY;
+            int kernelY = midY + p.kernelH - (inY + 1) * p.upy;
+
+            for (int outX = 0; outX < p.outW; outX++)
+            {
+                // Setup X receptive field.
+                int midX = outX * p.downx + p.upx - 1 - p.padx0;
+                int inX = std::min(std::max(floorDiv(midX, p.upx), 0), p.inW);
+                int w = std::min(std::max(floorDiv(midX + p.kernelW, p.upx), 0), p.inW) - inX;
+                int kernelX = midX + p.kernelW - (inX + 1) * p.upx;
+
+                // Inner loop.
+                const T* xp = &x[((int64_t)(majorIdx * p.inH + inY) * p.inW + inX) * p.minorDim + minorIdx];
+                const float* kp = &k[kernelY * p.kernelW + kernelX];
+                float v = 0.0f;
+                for (int yy = 0; yy < h; yy++)
+                    for (int xx = 0; xx < w; xx++)
+                        v += (float)xp[((int64_t)yy * p.inW + xx) * p.minorDim] * kp[-yy * p.upy * p.kernelW - xx * p.upx];
+
+                // Store result.
+                y[((int64_t)(majorIdx * p.outH + outY) * p.outW + outX) * p.minorDim + minorIdx] = (T)v;
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+// Specialized implementation for small filter kernels.
+
+template <class T, int upx, int upy, int downx, int downy, int kernelW, int kernelH, int tileOutW, int tileOutH>
+static void upFirDn2DSmall(const UpFirDn2DKernelParams& p, const float* k, const T* x, T* y, int planeBegin, int planeEnd)
+{
+    static_assert(kernelW % upx == 0 && kernelH % upy == 0, "kernel size must be a multiple of the up factor");
+    const int tileInW = ((tileOutW - 1) * downx + kernelW - 1) / upx + 1;
+    const int tileInH = ((tileOutH - 1) * downy + kernelH - 1) / upy + 1;
+    float  sk[kernelH][kernelW];
+    vfloat sx[tileInH][tileInW];
+    vfloat sy[tileOutH][tileOutW];
+    float* fx = (float*)&sx[0][0];
+    float* fy = (float*)&sy[0][0];
+
+    // Load filter kernel (flipped).
+    for (int ky = 0; ky < kernelH; ky++)
+        for (int kx = 0; kx < kernelW; kx++)
+            sk[ky][kx] = (kx < p.kernelW && ky < p.kernelH) ? k[(p.kernelH - 1 - ky) * p.kernelW + (p.kernelW - 1 - kx)] : 0.0f;
+
+    // Strides of the planes and the pixels.
+    const int64_t strideX = p.minorDim;
+    const int64_t strideInY = (int64_t)p.inW * p.minorDim;
+    const int64_t strideOutY = (int64_t)p.outW * p.minorDim;
+
+    // Loop over the plane vectors and the tiles.
+    for (int planeBase = planeBegin; planeBase < planeEnd; planeBase += VLEN)
+    for (int tileOutY = 0; tileOutY < p.outH; tileOutY += tileOutH)
+    for (int tileOutX = 0; tileOutX < p.outW; tileOutX += tileOutW)
+    {
+        int lanes = std::min(VLEN, planeEnd - planeBase);
+        int rows = std::min(tileOutH, p.outH - tileOutY);
+        int cols = std::min(tileOutW, p.outW - tileOutX);
+
+        // Load input pixels, a lane per plane.
+        int tileMidX = tileOutX * downx + upx - 1 - p.padx0;
+        int tileMidY = tileOutY * downy + upy - 1 - p.pady0;
+        int tileInX = floorDiv(tileMidX, upx);
+        int tileInY = floorDiv(tileMidY, upy);
+        for (int lane = 0; lane < VLEN; lane++)
+        {
+            if (lane >= lanes)
+            {
+                for (int i = 0; i < tileInH * tileInW; i++)
+                    fx[i * VLEN + lane] = 0.0f;
+                continue;
+            }
+            int plane = planeBase + lane;
+            int majorIdx = plane / p.minorDim;
+            int minorIdx = plane - majorIdx * p.minorDim;
+            const T* xp = x + (int64_t)majorIdx * p.inH * strideInY + minorIdx;
+            for (int relInY = 0; relInY < tileInH; relInY++)
+            {
+                int inY = relInY + tileInY;
+                bool rowValid = (inY >= 0 && inY < p.inH);
+                for (int relInX = 0; relInX < tileInW; relInX++)
+                {
+                    int inX = relInX + tileInX;
+                    float v = 0.0f;
+                    if (rowValid && inX >= 0 && inX < p.inW)
+                        v = (float)xp[inY * strideInY + inX * strideX];
+                    fx[(relInY * tileInW + relInX) * VLEN + lane] = v;
+                }
+            }
+        }
+
+        // Loop over output pixels.
+        for (int relOutY = 0; relOutY < rows; relOutY++)
+        {
+            int midY = tileMidY + relOutY * downy;
+            int inY = floorDiv(midY, upy);
+            int relInY = inY - tileInY;
+            int kernelY = (inY + 1) * upy - midY - 1; // flipped
+
+            for (int relOutX = 0; relOutX < cols; relOutX++)
+            {
+                int midX = tileMidX + relOutX * downx;
+                int inX = floorDiv(midX, upx);
+                int relInX = inX - tileInX;
+                int kernelX = (inX + 1) * upx - midX - 1; // flipped
+
+                // Inner loop.
+                vfloat v = vset1(0.0f);
+                for (int ty = 0; ty < kernelH / upy; ty++)
+                    for (int tx = 0; tx < kernelW / upx; tx++)
+                        v = vfmadd(sx[relInY + ty][relInX + tx], vset1(sk[kernelY + ty * upy][kernelX + tx * upx]), v);
+                sy[relOutY][relOutX] = v;
+            }
+        }
+
+        // Store result.
+        for (int lane = 0; lane < lanes; lane++)
+        {
+            int plane = planeBase + lane;
+            int majorIdx = plane / p.minorDim;
+            int minorIdx = plane - majorIdx * p.minorDim;
+            T* yp = y + ((int64_t)majorIdx * p.outH + tileOutY) * strideOutY + (int64_t)tileOutX * strideX + minorIdx;
+            for (int relOutY = 0; relOutY < rows; relOutY++)
+                for (int relOutX = 0; relOutX < cols; relOutX++)
+                    yp[relOutY * strideOutY + relOutX * strideX] = (T)fy[(relOutY * tileOutW + relOutX) * VLEN + lane];
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+// Choose the implementation, the same cases as the CUDA kernel. The
+// tiles are smaller: a vector tile holds VLEN planes.
+
+template <class T>
+static UpFirDn2DFunc<T> chooseUpFirDn2D(const UpFirDn2DKernelParams& p)
+{
+    UpFirDn2DFunc<T> func = upFirDn2DLarge<T>;
+
+    if (p.upx == 1 && p.upy == 1 && p.downx == 1 && p.downy == 1 && p.kernelW <= 7  && p.kernelH <= 7 ) { func = upFirDn2DSmall<T, 1,1, 1,1, 7,7,  32,8 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 1 && p.downy == 1 && p.kernelW <= 6  && p.kernelH <= 6 ) { func = upFirDn2DSmall<T, 1,1, 1,1, 6,6,  32,8 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 1 && p.downy == 1 && p.kernelW <= 5  && p.kernelH <= 5 ) { func = upFirDn2DSmall<T, 1,1, 1,1, 5,5,  32,8 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 1 && p.downy == 1 && p.kernelW <= 4  && p.kernelH <= 4 ) { func = upFirDn2DSmall<T, 1,1, 1,1, 4,4,  32,8 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 1 && p.downy == 1 && p.kernelW <= 3  && p.kernelH <= 3 ) { func = upFirDn2DSmall<T, 1,1, 1,1, 3,3,  32,8 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 1 && p.downy == 1 && p.kernelW <= 24 && p.kernelH <= 1 ) { func = upFirDn2DSmall<T, 1,1, 1,1, 24,1, 64,4 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 1 && p.downy == 1 && p.kernelW <= 20 && p.kernelH <= 1 ) { func = upFirDn2DSmall<T, 1,1, 1,1, 20,1, 64,4 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 1 && p.downy == 1 && p.kernelW <= 16 && p.kernelH <= 1 ) { func = upFirDn2DSmall<T, 1,1, 1,1, 16,1, 64,4 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 1 && p.downy == 1 && p.kernelW <= 12 && p.kernelH <= 1 ) { func = upFirDn2DSmall<T, 1,1, 1,1, 12,1, 64,4 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 1 && p.downy == 1 && p.kernelW <= 8  && p.kernelH <= 1 ) { func = upFirDn2DSmall<T, 1,1, 1,1, 8,1,  64,4 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 1 && p.downy == 1 && p.kernelW <= 1  && p.kernelH <= 24) { func = upFirDn2DSmall<T, 1,1, 1,1, 1,24, 16,16>; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 1 && p.downy == 1 && p.kernelW <= 1  && p.kernelH <= 20) { func = upFirDn2DSmall<T, 1,1, 1,1, 1,20, 16,16>; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 1 && p.downy == 1 && p.kernelW <= 1  && p.kernelH <= 16) { func = upFirDn2DSmall<T, 1,1, 1,1, 1,16, 16,16>; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 1 && p.downy == 1 && p.kernelW <= 1  && p.kernelH <= 12) { func = upFirDn2DSmall<T, 1,1, 1,1, 1,12, 16,16>; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 1 && p.downy == 1 && p.kernelW <= 1  && p.kernelH <= 8 ) { func = upFirDn2DSmall<T, 1,1, 1,1, 1,8,  16,16>; }
+
+    if (p.upx == 2 && p.upy == 2 && p.downx == 1 && p.downy == 1 && p.kernelW <= 8  && p.kernelH <= 8 ) { func = upFirDn2DSmall<T, 2,2, 1,1, 8,8,  32,8 >; }
+    if (p.upx == 2 && p.upy == 2 && p.downx == 1 && p.downy == 1 && p.kernelW <= 6  && p.kernelH <= 6 ) { func = upFirDn2DSmall<T, 2,2, 1,1, 6,6,  32,8 >; }
+    if (p.upx == 2 && p.upy == 2 && p.downx == 1 && p.downy == 1 && p.kernelW <= 4  && p.kernelH <= 4 ) { func = upFirDn2DSmall<T, 2,2, 1,1, 4,4,  32,8 >; }
+    if (p.upx == 2 && p.upy == 2 && p.downx == 1 && p.downy == 1 && p.kernelW <= 2  && p.kernelH <= 2 ) { func = upFirDn2DSmall<T, 2,2, 1,1, 2,2,  32,8 >; }
+    if (p.upx == 2 && p.upy == 1 && p.downx == 1 && p.downy == 1 && p.kernelW <= 24 && p.kernelH <= 1 ) { func = upFirDn2DSmall<T, 2,1, 1,1, 24,1, 64,4 >; }
+    if (p.upx == 2 && p.upy == 1 && p.downx == 1 && p.downy == 1 && p.kernelW <= 20 && p.kernelH <= 1 ) { func = upFirDn2DSmall<T, 2,1, 1,1, 20,1, 64,4 >; }
+    if (p.upx == 2 && p.upy == 1 && p.downx == 1 && p.downy == 1 && p.kernelW <= 16 && p.kernelH <= 1 ) { func = upFirDn2DSmall<T, 2,1, 1,1, 16,1, 64,4 >; }
+    if (p.upx == 2 && p.upy == 1 && p.downx == 1 && p.downy == 1 && p.kernelW <= 12 && p.kernelH <= 1 ) { func = upFirDn2DSmall<T, 2,1, 1,1, 12,1, 64,4 >; }
+    if (p.upx == 2 && p.upy == 1 && p.downx == 1 && p.downy == 1 && p.kernelW <= 8  && p.kernelH <= 1 ) { func = upFirDn2DSmall<T, 2,1, 1,1, 8,1,  64,4 >; }
+    if (p.upx == 1 && p.upy == 2 && p.downx == 1 && p.downy == 1 && p.kernelW <= 1  && p.kernelH <= 24) { func = upFirDn2DSmall<T, 1,2, 1,1, 1,24, 16,16>; }
+    if (p.upx == 1 && p.upy == 2 && p.downx == 1 && p.downy == 1 && p.kernelW <= 1  && p.kernelH <= 20) { func = upFirDn2DSmall<T, 1,2, 1,1, 1,20, 16,16>; }
+    if (p.upx == 1 && p.upy == 2 && p.downx == 1 && p.downy == 1 && p.kernelW <= 1  && p.kernelH <= 16) { func = upFirDn2DSmall<T, 1,2, 1,1, 1,16, 16,16>; }
+    if (p.upx == 1 && p.upy == 2 && p.downx == 1 && p.downy == 1 && p.kernelW <= 1  && p.kernelH <= 12) { func = upFirDn2DSmall<T, 1,2, 1,1, 1,12, 16,16>; }
+    if (p.upx == 1 && p.upy == 2 && p.downx == 1 && p.downy == 1 && p.kernelW <= 1  && p.kernelH <= 8 ) { func = upFirDn2DSmall<T, 1,2, 1,1, 1,8,  16,16>; }
+
+    if (p.upx == 1 && p.upy == 1 && p.downx == 2 && p.downy == 2 && p.kernelW <= 8  && p.kernelH <= 8 ) { func = upFirDn2DSmall<T, 1,1, 2,2, 8,8,  16,8 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 2 && p.downy == 2 && p.kernelW <= 6  && p.kernelH <= 6 ) { func = upFirDn2DSmall<T, 1,1, 2,2, 6,6,  16,8 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 2 && p.downy == 2 && p.kernelW <= 4  && p.kernelH <= 4 ) { func = upFirDn2DSmall<T, 1,1, 2,2, 4,4,  16,8 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 2 && p.downy == 2 && p.kernelW <= 2  && p.kernelH <= 2 ) { func = upFirDn2DSmall<T, 1,1, 2,2, 2,2,  16,8 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 2 && p.downy == 1 && p.kernelW <= 24 && p.kernelH <= 1 ) { func = upFirDn2DSmall<T, 1,1, 2,1, 24,1, 32,4 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 2 && p.downy == 1 && p.kernelW <= 20 && p.kernelH <= 1 ) { func = upFirDn2DSmall<T, 1,1, 2,1, 20,1, 32,4 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 2 && p.downy == 1 && p.kernelW <= 16 && p.kernelH <= 1 ) { func = upFirDn2DSmall<T, 1,1, 2,1, 16,1, 32,4 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 2 && p.downy == 1 && p.kernelW <= 12 && p.kernelH <= 1 ) { func = upFirDn2DSmall<T, 1,1, 2,1, 12,1, 32,4 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 2 && p.downy == 1 && p.kernelW <= 8  && p.kernelH <= 1 ) { func = upFirDn2DSmall<T, 1,1, 2,1, 8,1,  32,4 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 1 && p.downy == 2 && p.kernelW <= 1  && p.kernelH <= 24) { func = upFirDn2DSmall<T, 1,1, 1,2, 1,24, 16,8 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 1 && p.downy == 2 && p.kernelW <= 1  && p.kernelH <= 20) { func = upFirDn2DSmall<T, 1,1, 1,2, 1,20, 16,8 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 1 && p.downy == 2 && p.kernelW <= 1  && p.kernelH <= 16) { func = upFirDn2DSmall<T, 1,1, 1,2, 1,16, 16,8 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 1 && p.downy == 2 && p.kernelW <= 1  && p.kernelH <= 12) { func = upFirDn2DSmall<T, 1,1, 1,2, 1,12, 16,8 >; }
+    if (p.upx == 1 && p.upy == 1 && p.downx == 1 && p.downy == 2 && p.kernelW <= 1  && p.kernelH <= 8 ) { func = upFirDn2DSmall<T, 1,1, 1,2, 1,8,  16,8 >; }
+
+    return func;
+}
+
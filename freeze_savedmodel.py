@@ -0,0 +1,141 @@
+#!/usr/local/bin/python
+# -*- coding: utf-8 -*-
+################################################################################
+# freeze_savedmodel.py
+# Description:  freeze savedmodel to constant-folded graph for fast loading
+#
+# Author:       shozo fukuda
+# Date:         Mon Jul 10 09:32:41 2023
+# Last revised: $Date$
+# Application:  Python 3
+################################################################################
+
+#<IMPORT>
+import os
+import glob
+import argparse
+
+#<SUBROUTINE>###################################################################
+# Function:     model hash
+# Description:  FNV-1a 64 of saved_model.pb and variables/variables.index,
+#               the same as saved_model_hash() of the C++ loader
+# Dependencies:
+################################################################################
+def model_hash(model_dir):
+    h = 0xcbf29ce484222325
+    for name in ["saved_model.pb", os.path.join("variables", "variables.index")]:
+        path = os.path.join(model_dir, name)
+        if not os.path.isfile(path):
+            continue
+        with open(path, "rb") as fp:
+            for b in fp.read():
+                h = ((h ^ b) * 0x100000001b3) & 0xffffffffffffffff
+    return "%016x" % h
+
+#<SUBROUTINE>###################################################################
+# Function:     freeze savedmodel
+# Description:  variables to constants, prune to the signatures, fold constants
+# Dependencies:
+################################################################################
+def freeze(model_dir, fold=True):
+    # The graph of impl=cpu holds the custom ops
+    for path in glob.glob(os.path.join(model_dir, "ops", "*.so")) + glob.glob(os.path.join(model_dir, "ops", "*.dll")):
+        print("Loading op library: %s" %(path))
+        tf.load_op_library(path)
+
+    with tf1.Session(graph=tf1.Graph()) as sess:
+        print('Loading SavedModel from "%s"...' % model_dir)
+        meta = tf1.saved_model.loader.load(sess, ["serve"], model_dir)
+
+        # Nodes to keep: the tensors of the signatures and dlatent_avg for the truncation
+        def node(name):
+            return name.split(":")[0]
+        keep = []
+        for sig in meta.signature_def.values():
+            for info in list(sig.inputs.values()) + list(sig.outputs.values()):
+                keep.append(node(info.name))
+        ops = [op.name for op in sess.graph.get_operations()]
+        keep += [name for name in ["Gs/dlatent_avg", "Gs/dlatent_avg/Read/ReadVariableOp"] if name in ops]
+        keep = sorted(set(keep))
+
+        # Variables (with the noise of randomize_noise=False) to constants, D and training nodes pruned
+        graph_def = tf1.graph_util.convert_variables_to_constants(sess, sess.graph.as_graph_def(), keep)
+
+    if fold:
+        graph_def = fold_constants(graph_def, keep)
+
+    frozen = meta_graph_pb2.MetaGraphDef()
+    frozen.graph_def.CopyFrom(graph_def)
+    for key, sig in meta.signature_def.items():
+        frozen.signature_def[key].CopyFrom(sig)
+    return frozen
+
+#<SUBROUTINE>###################################################################
+# Function:     constant folding
+# Description:  run grappler over the frozen graph, keeping the nodes of <keep>
+# Dependencies:
+################################################################################
+def fold_constants(graph_def, keep):
+    try:
+        from tensorflow.python.grappler import tf_optimizer
+    except ImportError:
+        print("Warning: no grappler, the graph is not folded")
+        return graph_def
+
+    with tf1.Graph().as_default() as graph:
+        tf1.import_graph_def(graph_def, name="")
+        meta = tf1.train.export_meta_graph(graph=graph)
+    # grappler keeps the nodes in the collection "train_op"
+    fetch = meta.collection_def["train_op"]
+    fetch.node_list.value.extend(keep)
+
+    config = config_pb2.ConfigProto()
+    rewrite = config.graph_options.rewrite_options
+    rewrite.optimizers[:] = ["pruning", "constfold", "arithmetic", "dependency", "constfold"]
+    rewrite.meta_optimizer_iterations = rewriter_config_pb2.RewriterConfig.ONE
+    try:
+        return tf_optimizer.OptimizeGraph(config, meta)
+    except Exception as e:
+        print("Warning: constant folding failed, the graph is not folded: %s" %(e))
+        return graph_def
+
+#<TEST>#########################################################################
+# Function:     command line
+# Description:
+# Dependencies:
+################################################################################
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description="Freeze savedmodel to <model>/frozen/<hash>.pb for the C++ loader")
+    parser.add_argument('model', help="saved_model directory")
+    parser.add_argument('--no-fold', action='store_true',
+        help="skip the constant folding")
+    args = parser.parse_args()
+
+    if not os.path.isfile(os.path.join(args.model, "saved_model.pb")):
+        print("Error: no saved_model.pb in '%s'." %(args.model))
+        exit()
+
+    # Setup Tensorflow for legacy v1
+    print("Setup Tensorflow...")
+    import tensorflow as tf
+    import tensorflow.compat.v1 as tf1
+    from tensorflow.core.protobuf import meta_graph_pb2, config_pb2, rewriter_config_pb2
+    tf1.logging.set_verbosity(tf1.logging.ERROR)
+    tf1.disable_v2_behavior()
+    tf1.enable_resource_variables()
+
+    # Freeze
+    frozen = freeze(args.model, not args.no_fold)
+
+    # The stale graphs of the former model are useless
+    outdir = os.path.join(args.model, "frozen")
+    os.makedirs(outdir, exist_ok=True)
+    for path in glob.glob(os.path.join(outdir, "*.pb")):
+        os.remove(path)
+
+    outpath = os.path.join(outdir, model_hash(args.model) + ".pb")
+    print("Saving frozen graph: %s (%d nodes)" %(outpath, len(frozen.graph_def.node)))
+    with open(outpath, "wb") as fp:
+        fp.write(frozen.SerializeToString())
+
+# freeze_savedmodel.py
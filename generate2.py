@@ -128,6 +128,7 @@ def parse_args(args=None):
     parser.add_argument('--trunc', dest='truncation_psi', type=float, help='Truncation psi (default: %(default)s)', default=0.5)
     parser.add_argument('--class', dest='class_idx', type=int, help='Class label (default: unconditional)')
     parser.add_argument('--outdir', help='Where to save the output images (default: %(default)s)', metavar='DIR', default='out')
+    parser.add_argument('--impl', choices=['ref', 'cpu', 'cuda'], help='Implementation of the custom ops (default: %(default)s)', default='ref')
 
     return parser.parse_args(args)
 
@@ -137,6 +138,7 @@ def parse_args(args=None):
 def main():
     #args = parse_args(['--seeds=85,265,297,849', '--network=./pretrained/afhqdog.pkl'])
     args = parse_args()
+    tflib.set_impl(args.__dict__.pop('impl'))
     generate_images(**vars(args))
 
 #----------------------------------------------------------------------------
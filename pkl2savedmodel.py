@@ -21,7 +21,7 @@ import pickle
 # Description:  
 # Dependencies: 
 ################################################################################
-def to_savedmodel(pkl, outdir):
+def to_savedmodel(pkl, outdir, impl=None):
     # Load pretrained networks
     print('Loading networks from "%s"...' % pkl)
     with dnnlib.util.open_url(pkl) as fp:
@@ -32,6 +32,8 @@ def to_savedmodel(pkl, outdir):
     Gs_args['num_fp16_res']    = 0
     Gs_args['randomize_noise'] = False
     Gs_args['return_dlatents'] = True
+    # serving_default renders psi 0.5 as generate.py, the mapping signature outputs W before it
+    Gs_args['truncation_psi']  = 0.5
 
 #    with tf.Graph().as_default(), tflib.create_session(force_as_default=True) as sess:
     with tflib.create_session(force_as_default=True) as sess:
@@ -46,6 +48,11 @@ def to_savedmodel(pkl, outdir):
         [latents, _labels] = Gs.input_templates
         [images, dlatents] = Gs.output_templates
 
+        # W before the truncation: the first input of (W - dlatent_avg) in the Lerp of the Truncation scope,
+        # the C++ generator applies psi (--trunc) on it and feeds the synthesis past the Lerp
+        sub = [op for op in sess.graph.get_operations() if op.name.startswith("Gs/Truncation/Lerp/") and op.type == "Sub"]
+        w = sub[0].inputs[0]
+
         # Save as saved_model
         builder = tf1.saved_model.Builder(outdir)
         builder.add_meta_graph_and_variables(
@@ -57,7 +64,7 @@ def to_savedmodel(pkl, outdir):
                     outputs={"images":  images}),
                 "mapping": tf1.saved_model.predict_signature_def(
                     inputs={"latents": latents},
-                    outputs={"dlatents": dlatents}),
+                    outputs={"dlatents": w}),
                 "synthesis": tf1.saved_model.predict_signature_def(
                     inputs={"dlatents": dlatents},
                     outputs={"images": images})
@@ -66,6 +73,13 @@ def to_savedmodel(pkl, outdir):
         print("Saving as SavedModel: %s" %(outdir))
         builder.save()
 
+    # The graph holds the custom ops, the C++ loader loads their plugins from <outdir>/ops.
+    if impl == 'cpu':
+        os.makedirs(os.path.join(outdir, "ops"), exist_ok=True)
+        for path in tflib.custom_ops.get_plugin_paths():
+            name = os.path.basename(path)
+            shutil.copyfile(path, os.path.join(outdir, "ops", name[:name.rindex('_')] + os.path.splitext(name)[1]))
+
 #<TEST>#########################################################################
 # Function:     command line
 # Description:  
@@ -77,6 +91,8 @@ if __name__ == '__main__':
     parser.add_argument('outdir', help="saved_model direcotry")
     parser.add_argument('-f', '--force', action='store_true',
         help="remove outdir if existed")
+    parser.add_argument('--impl', choices=['ref', 'cpu', 'cuda'],
+        help="implementation of the custom ops in the graph (default: cuda); cpu copies the op plugins to outdir/ops")
     args = parser.parse_args()
 
     if args.force:
@@ -96,8 +112,10 @@ if __name__ == '__main__':
     import dnnlib
     import dnnlib.tflib as tflib
     tflib.init_tf()
+    if args.impl is not None:
+        tflib.set_impl(args.impl)
 
     # Convert
-    to_savedmodel(args.pkl, args.outdir)
+    to_savedmodel(args.pkl, args.outdir, args.impl)
 
 # pkl2savedmodel.py
@@ -15,6 +15,7 @@ import dnnlib
 import dnnlib.tflib as tflib
 from dnnlib.tflib.ops.upfirdn_2d import upsample_2d, downsample_2d, upsample_conv_2d, conv_downsample_2d
 from dnnlib.tflib.ops.fused_bias_act import fused_bias_act
+from dnnlib.tflib.ops.modulated_conv2d import modulated_conv2d
 
 # NOTE: Do not import any application-specific modules here!
 # Specify all network parameters as kwargs.
@@ -105,6 +106,8 @@ def modulated_conv2d_layer(x, y, fmaps, kernel, up=False, down=False, demodulate
     # Modulate.
     s = dense_layer(y, fmaps=x.shape[1].value, weight_var='mod_weight', trainable=trainable, use_spectral_norm=use_spectral_norm) # [BI] Transform incoming W to style.
     s = apply_bias_act(s, bias_var='mod_bias', trainable=trainable) + 1 # [BI] Add bias (initially 1).
+    if tflib.which_impl(None) == 'cpu' and not down:
+        return modulated_conv2d(x, w, s, demodulate=demodulate, up=up, resample_kernel=resample_kernel) # Fused CPU op.
     if x.dtype.name == 'float16' and not fused_modconv and demodulate:
         s *= 1 / tf.reduce_max(tf.abs(s)) # Pre-normalize to avoid float16 overflow.
     ww *= tf.cast(s[:, np.newaxis, np.newaxis, :, np.newaxis], w.dtype) # [BkkIO] Scale input feature maps.